@@ -163,6 +163,10 @@ std::unique_ptr<LightSrcObject>
  *  }
  *
  *
+ * All the models the objects use are loaded up front, in
+ * parallel (see RenderObjectFactory::PreloadModels), so the
+ * objects themselves find their models already loaded.
+ *
  * @param data Json object to load
  * @return collection of all the loaded game objects
  */
@@ -170,6 +174,16 @@ std::vector<std::unique_ptr<GameObject>> GameObjectLoader::LoadObjects(const jso
 {
     auto gameObjectsData = data.at("game_objects");
 
+    // Every model the level uses, so they can all load at once
+    std::vector<std::string> modelDirectories;
+    for (const json& gameObjectData : gameObjectsData)
+    {
+        const json& objectData = gameObjectData.at("data");
+        if (objectData.contains("render_data"))
+            modelDirectories.push_back(objectData.at("render_data").at("model_directory").get<std::string>());
+    }
+    mRenderObjectFactory.PreloadModels(modelDirectories);
+
     // Fill 'er up...
     std::vector<std::unique_ptr<GameObject>> gameObjects;
 
@@ -0,0 +1,269 @@
+/**
+ * @file ClusterCulling.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ClusterCulling.h"
+#include "MeshCache.h"
+
+/// Cone "sine" of clusters whose triangles face too many ways to ever be culled
+const float CLUSTER_CONE_NEVER_CULLS = 2.0f;
+
+
+/**
+ * Get the unit normal of a triangle
+ *
+ * @param vertices the mesh's vertices
+ * @param triangle the triangle's first index
+ * @return the normal, or zero if the triangle has no area
+ */
+static glm::vec3 TriangleNormal(const std::vector<Vertex>& vertices, const unsigned int* triangle)
+{
+    const glm::vec3& a = vertices[triangle[0]].position;
+    const glm::vec3& b = vertices[triangle[1]].position;
+    const glm::vec3& c = vertices[triangle[2]].position;
+
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float length = glm::length(normal);
+    return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+
+
+/**
+ * Work out the bounding sphere & normal cone of a cluster
+ *
+ * @param mesh the mesh the cluster's in
+ * @param cluster the cluster; its index range is set, the rest gets filled in
+ */
+static void FinishCluster(const MeshData& mesh, MeshCluster& cluster)
+{
+    const unsigned int* first = mesh.indices.data() + cluster.firstIndex;
+    const unsigned int* last = first + cluster.numIndices;
+
+    // Sphere around the box around the vertices
+    AABB bounds;
+    for (const unsigned int* index = first; index != last; ++index)
+        bounds.Expand(mesh.vertices[*index].position);
+
+    glm::vec3 center = bounds.Center();
+    float radius = 0.0f;
+    for (const unsigned int* index = first; index != last; ++index)
+        radius = std::max(radius, glm::length(mesh.vertices[*index].position - center));
+    cluster.sphere = glm::vec4(center, radius);
+
+    // The cone's axis is the triangles' average direction, and it's
+    // as wide as the triangle furthest off it. (Triangles with no area
+    // can't be seen from anywhere, so they don't count.)
+    glm::vec3 axis(0.0f);
+    for (const unsigned int* triangle = first; triangle != last; triangle += 3)
+        axis += TriangleNormal(mesh.vertices, triangle);
+
+    float axisLength = glm::length(axis);
+    if (axisLength <= 0.0f)
+    {
+        cluster.cone = glm::vec4(0.0f, 0.0f, 0.0f, CLUSTER_CONE_NEVER_CULLS);
+        return;
+    }
+    axis /= axisLength;
+
+    float minCos = 1.0f;
+    for (const unsigned int* triangle = first; triangle != last; triangle += 3)
+    {
+        glm::vec3 normal = TriangleNormal(mesh.vertices, triangle);
+        if (normal != glm::vec3(0.0f))
+            minCos = std::min(minCos, glm::dot(normal, axis));
+    }
+
+    // 90 degrees or wider, and there's nowhere all of them face away from
+    float sine = (minCos > 0.0f) ? std::sqrt(1.0f - minCos * minCos) : CLUSTER_CONE_NEVER_CULLS;
+    cluster.cone = glm::vec4(axis, sine);
+}
+
+
+
+/**
+ * Cut a range of a mesh's triangles into clusters, in order
+ *
+ * @param mesh the mesh; gets the clusters added
+ * @param firstIndex first index of the range
+ * @param numIndices number of indices in the range
+ * @param vertexCluster scratch space: the cluster each vertex was last counted in
+ */
+static void BuildRangeClusters(MeshData& mesh, unsigned int firstIndex, unsigned int numIndices,
+                               std::vector<unsigned int>& vertexCluster)
+{
+    MeshCluster cluster = {};
+    cluster.firstIndex = firstIndex;
+    unsigned int clusterVertices = 0;
+    glm::vec3 direction(0.0f);
+
+    auto clusterId = (unsigned int)mesh.clusters.size();
+    for (unsigned int i = firstIndex; i < firstIndex + numIndices; i += 3)
+    {
+        const unsigned int* triangle = mesh.indices.data() + i;
+        glm::vec3 normal = TriangleNormal(mesh.vertices, triangle);
+
+        // Count the vertices the cluster doesn't have yet
+        auto newVertices = [&]() {
+            unsigned int count = 0;
+            for (unsigned int corner = 0; corner < 3; ++corner)
+            {
+                unsigned int vertex = triangle[corner];
+                bool repeat = (corner > 0 && vertex == triangle[0]) || (corner > 1 && vertex == triangle[1]);
+                if (vertexCluster[vertex] != clusterId && !repeat)
+                    count++;
+            }
+            return count;
+        };
+        unsigned int added = newVertices();
+
+        // Start a new cluster if this one's full, or if the
+        // triangle would make its cone a lot wider
+        unsigned int clusterTriangles = cluster.numIndices / 3;
+        bool full = clusterTriangles >= CLUSTER_MAX_TRIANGLES ||
+                    clusterVertices + added > CLUSTER_MAX_VERTICES;
+        bool turns = clusterTriangles >= CLUSTER_MIN_TRIANGLES && direction != glm::vec3(0.0f) &&
+                     normal != glm::vec3(0.0f) &&
+                     glm::dot(normal, glm::normalize(direction)) < CLUSTER_SPLIT_NORMAL_COS;
+        if (clusterTriangles > 0 && (full || turns))
+        {
+            FinishCluster(mesh, cluster);
+            mesh.clusters.push_back(cluster);
+
+            cluster = {};
+            cluster.firstIndex = i;
+            clusterVertices = 0;
+            direction = glm::vec3(0.0f);
+            clusterId++;
+            added = newVertices();
+        }
+
+        for (unsigned int corner = 0; corner < 3; ++corner)
+            vertexCluster[triangle[corner]] = clusterId;
+        clusterVertices += added;
+        direction += normal;
+        cluster.numIndices += 3;
+    }
+
+    if (cluster.numIndices > 0)
+    {
+        FinishCluster(mesh, cluster);
+        mesh.clusters.push_back(cluster);
+    }
+}
+
+
+
+/**
+ * Cut a mesh's full detail triangles into clusters.
+ *
+ * Clusters never cross from one part of a batched mesh into the
+ * next, so each part knows which clusters are its own. Call after
+ * the MeshOptimizer, since clusters are ranges of the final index
+ * order.
+ *
+ * @param mesh the mesh; gets its clusters (and its parts' cluster ranges)
+ */
+void BuildClusters(MeshData &mesh)
+{
+    mesh.clusters.clear();
+    std::vector<unsigned int> vertexCluster(mesh.vertices.size(), std::numeric_limits<unsigned int>::max());
+
+    if (mesh.parts.empty())
+    {
+        unsigned int numIndices = mesh.lods.empty() ? (unsigned int)mesh.indices.size() : mesh.lods[0].numIndices;
+        BuildRangeClusters(mesh, 0, numIndices, vertexCluster);
+        return;
+    }
+
+    for (MeshPart& part : mesh.parts)
+    {
+        part.firstCluster = (unsigned int)mesh.clusters.size();
+        BuildRangeClusters(mesh, part.firstIndex, part.numIndices, vertexCluster);
+        part.numClusters = (unsigned int)mesh.clusters.size() - part.firstCluster;
+    }
+}
+
+
+
+/**
+ * Cull some of a mesh's clusters, and get the index ranges of the ones left.
+ *
+ * A cluster faces away when, for every point p in its sphere (center c,
+ * radius r) and every normal n in its cone (axis a, half-angle t),
+ * dot(n, p - eye) >= 0, i.e. when every p - eye is within 90 - t degrees
+ * of a. Every such p is at most r further from the eye than c, and at
+ * most r less far along a, so it's enough that
+ *
+ *     dot(c - eye, a) >= sin(t) * (|c - eye| + r) + r
+ *
+ * The frustum & camera position have to be in the mesh's model space.
+ * Ranges of clusters that are next to each other in the index buffer
+ * get joined into one.
+ *
+ * @param clusters the mesh's clusters
+ * @param firstCluster first cluster to test
+ * @param numClusters how many clusters to test
+ * @param frustum view frustum, in model space
+ * @param viewPos camera position, in model space
+ * @param cullBackfacing should clusters that face away be culled too?
+ * @param visible the index ranges of the clusters in view get added to this
+ * @return how many clusters got culled, and why
+ */
+ClusterCullStats CullClusters(const std::vector<MeshCluster> &clusters,
+                              unsigned int firstCluster, unsigned int numClusters,
+                              const Frustum &frustum, const glm::vec3 &viewPos, bool cullBackfacing,
+                              std::vector<MeshLOD> &visible)
+{
+    ClusterCullStats stats;
+
+    // Normalized, so the plane tests give real distances
+    glm::vec4 planes[6];
+    for (int p = 0; p < 6; ++p)
+        planes[p] = frustum.planes[p] / glm::length(glm::vec3(frustum.planes[p]));
+
+    for (unsigned int i = firstCluster; i < firstCluster + numClusters; ++i)
+    {
+        const MeshCluster& cluster = clusters[i];
+        glm::vec3 center(cluster.sphere);
+        float radius = cluster.sphere.w;
+
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            {
+                inside = false;
+                break;
+            }
+        }
+        if (!inside)
+        {
+            stats.outside++;
+            continue;
+        }
+
+        if (cullBackfacing)
+        {
+            glm::vec3 toCluster = center - viewPos;
+            float distance = glm::length(toCluster);
+            if (glm::dot(toCluster, glm::vec3(cluster.cone)) >= cluster.cone.w * (distance + radius) + radius)
+            {
+                stats.backfacing++;
+                continue;
+            }
+        }
+
+        if (!visible.empty() && visible.back().firstIndex + visible.back().numIndices == cluster.firstIndex)
+            visible.back().numIndices += cluster.numIndices;
+        else
+            visible.push_back({cluster.firstIndex, cluster.numIndices});
+    }
+
+    return stats;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file ClusterCulling.h
+ * @author Elijah Gleckler
+ *
+ * Culls a mesh a few dozen triangles at a time.
+ *
+ * At import time, each mesh's full detail triangles get cut into
+ * clusters of up to CLUSTER_MAX_TRIANGLES triangles (see MeshCluster),
+ * following the index order the MeshOptimizer left them in, which
+ * keeps triangles that are close together next to each other. Each
+ * cluster gets a bounding sphere and a normal cone: the direction
+ * its triangles face around, and how far off it the worst one is.
+ *
+ * Every frame, the clusters of meshes drawn at full detail are
+ * tested against the view frustum, and against their normal cone:
+ * if the camera is behind every triangle in a cluster, the whole
+ * cluster faces away and back-face culling would throw it all out
+ * anyway. (See "Optimizing the Graphics Pipeline with Compute",
+ * Wihlidal, GDC 2016.) The ones that are left become a few index
+ * ranges, with neighbouring clusters joined up, which a RenderQueue
+ * draws with one multi-draw call.
+ *
+ * Big flat things like walls and floors make tight cones, so a
+ * good share of a building's clusters can go this way, on top of
+ * whatever's off screen. It only happens with back-face culling
+ * on, though, which scenes have to ask for (see
+ * Scene::SetBackfaceCulling).
+ *
+ * Everything's tested in the object's model space, so each object
+ * only needs its frustum & camera position moved there once.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_CLUSTERCULLING_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_CLUSTERCULLING_H
+
+#include <vector>
+#include <glm.hpp>
+
+#include "Mesh.h"
+#include "FrustumCuller.h"
+
+struct MeshData;
+
+/// Most triangles in a cluster
+const unsigned int CLUSTER_MAX_TRIANGLES = 124;
+
+/// Most different vertices a cluster's triangles can use
+/// (keeps clusters from getting long and stringy)
+const unsigned int CLUSTER_MAX_VERTICES = 64;
+
+/// Clusters with at least this many triangles get cut early
+/// when the next one faces off in a different direction...
+const unsigned int CLUSTER_MIN_TRIANGLES = 32;
+
+/// ... which is when it's further than this off the cluster's
+/// direction so far (cosine of the angle), so cones stay tight
+const float CLUSTER_SPLIT_NORMAL_COS = 0.5f;
+
+/**
+ * How many clusters a CullClusters call threw out
+ */
+struct ClusterCullStats
+{
+    /// Clusters entirely off screen
+    unsigned int outside = 0;
+
+    /// Clusters that face away from the camera
+    unsigned int backfacing = 0;
+};
+
+void BuildClusters(MeshData& mesh);
+
+ClusterCullStats CullClusters(const std::vector<MeshCluster>& clusters,
+                              unsigned int firstCluster, unsigned int numClusters,
+                              const Frustum& frustum, const glm::vec3& viewPos, bool cullBackfacing,
+                              std::vector<MeshLOD>& visible);
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_CLUSTERCULLING_H
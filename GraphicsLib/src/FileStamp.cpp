@@ -0,0 +1,97 @@
+/**
+ * @file FileStamp.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <filesystem>
+
+#include "FileStamp.h"
+#include "MappedFile.h"
+
+/// FNV-1a 64-bit offset basis
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+/// FNV-1a 64-bit prime
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+
+/**
+ * Get the size & modification time of a file
+ *
+ * @param filepath path to the file
+ * @param size set to the size of the file in bytes
+ * @param time set to the last write time of the file
+ * @return false if the file isn't there
+ */
+static bool StatFile(const std::string& filepath, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(filepath, error);
+    if (error)
+        return false;
+
+    auto writeTime = std::filesystem::last_write_time(filepath, error);
+    if (error)
+        return false;
+
+    time = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+
+
+/**
+ * Make the stamp of a file as it is right now
+ *
+ * @param filepath path to the file
+ * @param stamp set to the file's stamp
+ * @return false if the file isn't there
+ */
+bool FileStamp::Read(const std::string &filepath, FileStamp &stamp)
+{
+    if (!StatFile(filepath, stamp.size, stamp.time))
+        return false;
+
+    stamp.hash = Hash(filepath);
+    return true;
+}
+
+
+
+/**
+ * Hash the contents of a file with 64-bit FNV-1a
+ * @param filepath path to the file
+ * @return the hash, or 0 if the file couldn't be read
+ */
+uint64_t FileStamp::Hash(const std::string &filepath)
+{
+    MappedFile file;
+    if (!file.Open(filepath))
+        return 0;
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    const unsigned char* bytes = file.GetData();
+    for (size_t i = 0; i < file.GetSize(); ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+
+
+/**
+ * Is a file still the version this stamp was made from?
+ * @param filepath path to the file
+ * @return true if the file matches the stamp
+ */
+bool FileStamp::Matches(const std::string &filepath) const
+{
+    uint64_t fileSize;
+    int64_t fileTime;
+    if (!StatFile(filepath, fileSize, fileTime) || fileSize != size)
+        return false;
+
+    return fileTime == time || Hash(filepath) == hash;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file FileStamp.h
+ * @author Elijah Gleckler
+ *
+ * Identifies a version of a source file, so a cache made
+ * from it can tell whether it's still up to date.
+ *
+ * A stamp is the file's size, modification time, and a hash
+ * of its contents. A file matches a stamp if it's the same size
+ * and either the same modification time or (if it was just
+ * touched, e.g. by a checkout) the same contents. The hash is
+ * only computed when the times differ, so checking is cheap.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_FILESTAMP_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_FILESTAMP_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Identifies a version of a source file
+ */
+struct FileStamp
+{
+    /// Size of the file in bytes
+    uint64_t size = 0;
+
+    /// Last write time of the file, in the filesystem clock's ticks
+    int64_t time = 0;
+
+    /// 64-bit FNV-1a hash of the file's contents
+    uint64_t hash = 0;
+
+    static bool Read(const std::string& filepath, FileStamp& stamp);
+    static uint64_t Hash(const std::string& filepath);
+
+    bool Matches(const std::string& filepath) const;
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_FILESTAMP_H
@@ -0,0 +1,68 @@
+/**
+ * @file FrameConstants.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <glad/glad.h>
+
+#include "FrameConstants.h"
+
+
+/**
+ * Constructor
+ *
+ * Makes space for the block and binds the buffer to
+ * FRAME_CONSTANTS_BINDING for good. Nothing else should
+ * ever bind a buffer there!
+ */
+FrameConstantsBuffer::FrameConstantsBuffer()
+{
+    glGenBuffers(1, &mUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), &mConstants, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, mUBO);
+}
+
+
+
+/**
+ * Destructor
+ */
+FrameConstantsBuffer::~FrameConstantsBuffer()
+{
+    Release();
+}
+
+
+
+/**
+ * Delete the uniform buffer, while there's still a context to
+ * delete it in. The last constants can still be read after.
+ */
+void FrameConstantsBuffer::Release()
+{
+    if (mUBO == 0)
+        return;
+
+    glDeleteBuffers(1, &mUBO);
+    mUBO = 0;
+}
+
+
+
+/**
+ * Upload this frame's constants. Call it once per frame,
+ * before anything draws.
+ *
+ * @param constants the new contents of the block
+ */
+void FrameConstantsBuffer::Update(const FrameConstants &constants)
+{
+    mConstants = constants;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &mConstants);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
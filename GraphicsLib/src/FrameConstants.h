@@ -0,0 +1,102 @@
+/**
+ * @file FrameConstants.h
+ * @author Elijah Gleckler
+ *
+ * Camera data that every shader program needs, once
+ * per frame: the view & projection matrices, the camera
+ * position, and the time.
+ *
+ * Instead of each program getting its own copies as
+ * uniforms, all this lives in one std140 uniform buffer
+ * bound to a fixed binding point. Every ShaderProgram
+ * hooks its "FrameConstants" block up to that binding
+ * point when it links, so shaders just have to declare
+ * the block (exactly as below!) to use it:
+ *
+ *  layout (std140) uniform FrameConstants
+ *  {
+ *      mat4 viewMat;
+ *      mat4 projMat;
+ *      mat4 viewProjMat;
+ *      vec4 viewPos;
+ *      float time;
+ *  };
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_FRAMECONSTANTS_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_FRAMECONSTANTS_H
+
+#include <string>
+#include <glm.hpp>
+
+/// Name of the uniform block in the shaders
+const std::string FRAME_CONSTANTS_BLOCK_NAME = "FrameConstants";
+
+/// Uniform buffer binding point the block is always bound to
+const unsigned int FRAME_CONSTANTS_BINDING = 0;
+
+/**
+ * CPU-side mirror of the FrameConstants uniform block.
+ * Member order & padding follow std140, so it can
+ * be copied into the buffer as-is.
+ */
+struct FrameConstants
+{
+    /// World space -> view space
+    glm::mat4 viewMat = glm::mat4(1.0f);
+
+    /// View space -> clip space
+    glm::mat4 projMat = glm::mat4(1.0f);
+
+    /// projMat * viewMat, so vertex shaders save a multiply
+    glm::mat4 viewProjMat = glm::mat4(1.0f);
+
+    /// Camera position in world space (w is unused)
+    glm::vec4 viewPos = glm::vec4(0.0f);
+
+    /// Seconds since the window opened
+    float time = 0.0f;
+
+    /// std140 rounds the block up to a multiple of a vec4
+    float padding[3] = {0.0f, 0.0f, 0.0f};
+};
+
+/**
+ * The uniform buffer holding the FrameConstants block
+ */
+class FrameConstantsBuffer
+{
+private:
+
+    /// GL id of the uniform buffer
+    unsigned int mUBO;
+
+    /// What we last put in the buffer
+    FrameConstants mConstants;
+
+public:
+
+    FrameConstantsBuffer();
+
+    /// Copy constructor (disabled)
+    FrameConstantsBuffer(const FrameConstantsBuffer &) = delete;
+
+    /// Assignment operator
+    void operator=(const FrameConstantsBuffer &) = delete;
+
+    ~FrameConstantsBuffer();
+
+    // ****************************************************************
+
+    void Update(const FrameConstants& constants);
+    void Release();
+
+    /**
+     * Get the constants currently in the buffer
+     * @return the constants currently in the buffer
+     */
+    const FrameConstants& GetConstants() const { return mConstants; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_FRAMECONSTANTS_H
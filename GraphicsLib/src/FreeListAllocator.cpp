@@ -0,0 +1,98 @@
+/**
+ * @file FreeListAllocator.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <iterator>
+
+#include "FreeListAllocator.h"
+
+
+/**
+ * Hand out a range of space
+ *
+ * @param size how much space
+ * @param alignment the range has to start on a multiple of this
+ * @param offset set to where the range starts
+ * @return false if there's no free range big enough (try Grow)
+ */
+bool FreeListAllocator::Allocate(unsigned int size, unsigned int alignment, unsigned int &offset)
+{
+    for (auto range = mFreeRanges.begin(); range != mFreeRanges.end(); ++range)
+    {
+        unsigned int start = range->first;
+        unsigned int end = range->first + range->second;
+        unsigned int aligned = (start + alignment - 1) / alignment * alignment;
+        if (aligned + size > end)
+            continue;
+
+        // Split the range into (padding) + allocation + (leftover)
+        mFreeRanges.erase(range);
+        if (aligned > start)
+            mFreeRanges.emplace(start, aligned - start);
+        if (aligned + size < end)
+            mFreeRanges.emplace(aligned + size, end - (aligned + size));
+
+        offset = aligned;
+        mUsed += size;
+        return true;
+    }
+
+    return false;
+}
+
+
+
+/**
+ * Take back a range of space, merging it with its free neighbors
+ *
+ * @param offset where the range starts
+ * @param size how big the range is (same as it was allocated with)
+ */
+void FreeListAllocator::Free(unsigned int offset, unsigned int size)
+{
+    if (size == 0)
+        return;
+    mUsed -= size;
+
+    auto next = mFreeRanges.lower_bound(offset);
+
+    // Merge with the free range right after...
+    if (next != mFreeRanges.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = mFreeRanges.erase(next);
+    }
+
+    // ... and the one right before
+    if (next != mFreeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+
+    mFreeRanges.emplace(offset, size);
+}
+
+
+
+/**
+ * Make the whole block bigger. The new space is free.
+ * @param capacity the new size of the block
+ */
+void FreeListAllocator::Grow(unsigned int capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    unsigned int oldCapacity = mCapacity;
+    mCapacity = capacity;
+
+    // Free() does the merging with a free range at the old end
+    mUsed += capacity - oldCapacity;
+    Free(oldCapacity, capacity - oldCapacity);
+}
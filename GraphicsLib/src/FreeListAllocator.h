@@ -0,0 +1,61 @@
+/**
+ * @file FreeListAllocator.h
+ * @author Elijah Gleckler
+ *
+ * Hands out ranges of a big block of space (like a GPU buffer),
+ * and takes them back. Only keeps track of the numbers--what the
+ * space actually is, is up to whoever owns it.
+ *
+ * The free space is a list of free ranges, sorted by where they
+ * start. Allocating takes the first range big enough (first fit),
+ * and freeing merges the range with any free neighbors, so the
+ * space doesn't crumble into little unusable bits.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_FREELISTALLOCATOR_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_FREELISTALLOCATOR_H
+
+#include <map>
+
+/**
+ * Hands out ranges of a big block of space
+ */
+class FreeListAllocator
+{
+private:
+
+    /// Size of each free range, by where it starts
+    std::map<unsigned int, unsigned int> mFreeRanges;
+
+    /// Size of the whole block
+    unsigned int mCapacity = 0;
+
+    /// Space handed out and not given back yet
+    unsigned int mUsed = 0;
+
+public:
+
+    /// Default constructor
+    FreeListAllocator() = default;
+
+    // ****************************************************************
+
+    bool Allocate(unsigned int size, unsigned int alignment, unsigned int& offset);
+    void Free(unsigned int offset, unsigned int size);
+    void Grow(unsigned int capacity);
+
+    /**
+     * Get the size of the whole block
+     * @return size of the space being handed out
+     */
+    unsigned int GetCapacity() const { return mCapacity; }
+
+    /**
+     * Get how much space is handed out right now
+     * @return total size of all the ranges handed out
+     */
+    unsigned int GetUsed() const { return mUsed; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_FREELISTALLOCATOR_H
@@ -0,0 +1,183 @@
+/**
+ * @file FrustumCuller.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_CULLER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "FrustumCuller.h"
+
+
+/**
+ * Pull the frustum planes out of a view-projection matrix
+ * (Gribb & Hartmann). Each plane is a sum/difference of the
+ * last row of the matrix with one of the others.
+ *
+ * The planes aren't normalized, which is fine for inside/outside
+ * tests, since the box radius gets scaled right along with them.
+ *
+ * @param viewProjMat projection matrix * view matrix
+ * @return the frustum of that camera, in world space
+ */
+Frustum Frustum::FromMatrix(const glm::mat4 &viewProjMat)
+{
+    // glm is column-major, so row i is m[0][i], m[1][i], ...
+    auto row = [&](int i) {
+        return glm::vec4(viewProjMat[0][i], viewProjMat[1][i], viewProjMat[2][i], viewProjMat[3][i]);
+    };
+
+    glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+    Frustum frustum;
+    frustum.planes[0] = r3 + r0; // left
+    frustum.planes[1] = r3 - r0; // right
+    frustum.planes[2] = r3 + r1; // bottom
+    frustum.planes[3] = r3 - r1; // top
+    frustum.planes[4] = r3 + r2; // near
+    frustum.planes[5] = r3 - r2; // far
+    return frustum;
+}
+
+
+
+/**
+ * Forget all the boxes, to start a new batch
+ */
+void FrustumCuller::Clear()
+{
+    mCenterX.clear();
+    mCenterY.clear();
+    mCenterZ.clear();
+    mExtentX.clear();
+    mExtentY.clear();
+    mExtentZ.clear();
+}
+
+
+
+/**
+ * Add a box to the batch
+ * @param box bounding box, in the same space as the frustum (world)
+ * @return index of the box, for IsVisible()
+ */
+unsigned int FrustumCuller::Add(const AABB &box)
+{
+    glm::vec3 center = box.Center();
+    glm::vec3 extents = box.Extents();
+
+    mCenterX.push_back(center.x);
+    mCenterY.push_back(center.y);
+    mCenterZ.push_back(center.z);
+    mExtentX.push_back(extents.x);
+    mExtentY.push_back(extents.y);
+    mExtentZ.push_back(extents.z);
+
+    return (unsigned int)mCenterX.size() - 1;
+}
+
+
+
+/**
+ * Test every box in the batch against the frustum.
+ *
+ * A box is outside when it's entirely on the outer side of
+ * any one plane: the distance from its center to the plane
+ * is more negative than its "radius" toward that plane,
+ * dot(|plane.xyz|, extents). Conservative--big boxes near
+ * a frustum corner may pass when they're actually outside.
+ *
+ * @param frustum this frame's view frustum
+ * @return number of boxes that are visible
+ */
+unsigned int FrustumCuller::Cull(const Frustum &frustum)
+{
+    unsigned int count = Size();
+    mVisible.assign(count, 1);
+
+    unsigned int i = 0;
+
+#ifdef FRUSTUM_CULLER_USE_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    // Four boxes at a time, one plane at a time
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&mCenterX[i]);
+        __m128 cy = _mm_loadu_ps(&mCenterY[i]);
+        __m128 cz = _mm_loadu_ps(&mCenterZ[i]);
+        __m128 ex = _mm_loadu_ps(&mExtentX[i]);
+        __m128 ey = _mm_loadu_ps(&mExtentY[i]);
+        __m128 ez = _mm_loadu_ps(&mExtentZ[i]);
+
+        // Lanes that end up set are outside some plane
+        __m128 outside = _mm_setzero_ps();
+
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            __m128 nw = _mm_set1_ps(plane.w);
+
+            // Signed distance of each center
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                     _mm_add_ps(_mm_mul_ps(nz, cz), nw));
+
+            // Radius of each box toward the plane
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                                                  _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                       _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        }
+
+        int outsideBits = _mm_movemask_ps(outside);
+        mVisible[i] = (outsideBits & 1) == 0;
+        mVisible[i + 1] = (outsideBits & 2) == 0;
+        mVisible[i + 2] = (outsideBits & 4) == 0;
+        mVisible[i + 3] = (outsideBits & 8) == 0;
+    }
+#endif
+
+    // Whatever's left over (or everything, without SSE)
+    CullScalar(frustum, i, count);
+
+    unsigned int numVisible = 0;
+    for (unsigned char visible : mVisible)
+        numVisible += visible;
+    return numVisible;
+}
+
+
+
+/**
+ * Test a range of boxes against the frustum, one at a time
+ *
+ * @param frustum this frame's view frustum
+ * @param begin first box to test
+ * @param end one past the last box to test
+ */
+void FrustumCuller::CullScalar(const Frustum &frustum, unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            float dist = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+            float radius = std::abs(plane.x) * mExtentX[i] +
+                           std::abs(plane.y) * mExtentY[i] +
+                           std::abs(plane.z) * mExtentZ[i];
+
+            if (dist + radius < 0.0f)
+            {
+                mVisible[i] = 0;
+                break;
+            }
+        }
+    }
+}
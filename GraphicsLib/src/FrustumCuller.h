@@ -0,0 +1,103 @@
+/**
+ * @file FrustumCuller.h
+ * @author Elijah Gleckler
+ *
+ * Tests a whole batch of bounding boxes against
+ * the camera's view frustum at once.
+ *
+ * Boxes are stored structure-of-arrays style (all the
+ * center x's together, all the center y's together, etc.),
+ * so the test can run on four boxes at a time with SSE.
+ * Without SSE it falls back to the same test, one box
+ * at a time.
+ *
+ * Usage, every frame:
+ *  1. Clear()
+ *  2. Add() each box (world space), remembering its index
+ *  3. Cull() with this frame's frustum
+ *  4. IsVisible(index)
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_FRUSTUMCULLER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_FRUSTUMCULLER_H
+
+#include <vector>
+#include <glm.hpp>
+
+#include "bounds.h"
+
+/**
+ * The six planes of a view frustum, pointing inward.
+ * A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+ */
+struct Frustum
+{
+    /// Left, right, bottom, top, near, far
+    glm::vec4 planes[6];
+
+    static Frustum FromMatrix(const glm::mat4& viewProjMat);
+};
+
+/**
+ * Tests a batch of bounding boxes against a view frustum
+ */
+class FrustumCuller
+{
+private:
+
+    /// Box centers, x components
+    std::vector<float> mCenterX;
+
+    /// Box centers, y components
+    std::vector<float> mCenterY;
+
+    /// Box centers, z components
+    std::vector<float> mCenterZ;
+
+    /// Box half-sizes, x components
+    std::vector<float> mExtentX;
+
+    /// Box half-sizes, y components
+    std::vector<float> mExtentY;
+
+    /// Box half-sizes, z components
+    std::vector<float> mExtentZ;
+
+    /// Result of the last Cull() for each box (1 = visible)
+    std::vector<unsigned char> mVisible;
+
+    void CullScalar(const Frustum& frustum, unsigned int begin, unsigned int end);
+
+public:
+
+    /// Default constructor
+    FrustumCuller() = default;
+
+    /// Copy constructor (disabled)
+    FrustumCuller(const FrustumCuller &) = delete;
+
+    /// Assignment operator
+    void operator=(const FrustumCuller &) = delete;
+
+    // ****************************************************************
+
+    void Clear();
+    unsigned int Add(const AABB& box);
+    unsigned int Cull(const Frustum& frustum);
+
+    /**
+     * Was a box inside the frustum in the last Cull()?
+     * @param index index Add() gave back for the box
+     * @return true if any part of the box might be visible
+     */
+    bool IsVisible(unsigned int index) const { return mVisible[index] != 0; }
+
+    /**
+     * Get the number of boxes added since the last Clear()
+     * @return the number of boxes
+     */
+    unsigned int Size() const { return (unsigned int)mCenterX.size(); }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_FRUSTUMCULLER_H
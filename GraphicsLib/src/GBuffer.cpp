@@ -13,6 +13,7 @@
 #include "Scene.h"
 #include "PointLight.h"
 #include "DirectionalLight.h"
+#include "FrameConstants.h"
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -23,20 +24,29 @@ const std::string GBUF_GEO_VERT_SHADER_FILEPATH = "../resources/shaders/gbuf-geo
 /// Hard-coded filepath to the g-buffer geometry fragment shader.
 const std::string GBUF_GEO_FRAG_SHADER_FILEPATH = "../resources/shaders/gbuf-geo.frag";
 
+/// Hard-coded filepath to the depth pre-pass vertex shader.
+const std::string DEPTH_PREPASS_VERT_SHADER_FILEPATH = "../resources/shaders/depth-prepass.vert";
+
+/// Hard-coded filepath to the depth pre-pass fragment shader.
+const std::string DEPTH_PREPASS_FRAG_SHADER_FILEPATH = "../resources/shaders/depth-prepass.frag";
+
+/// Hard-coded filepath to the g-buffer geometry vertex shader for GPU-driven draws.
+const std::string GBUF_GEO_INDIRECT_VERT_SHADER_FILEPATH = "../resources/shaders/gbuf-geo-indirect.vert";
+
 /// Hard-coded filepath to the g-buffer lighting pass vertex shader.
 const std::string GBUF_LIGHT_VERT_SHADER_FILEPATH = "../resources/shaders/gbuf-light.vert";
 
 /// Hard-coded filepath to the g-buffer lighting pass fragment shader.
 const std::string GBUF_LIGHT_FRAG_SHADER_FILEPATH = "../resources/shaders/gbuf-light.frag";
 
-/// Naming convention for view matrix in shaders
-const std::string VIEW_MAT_UNIFORM_NAME = "viewMat";
+/// Hard-coded filepath to the point light volume vertex shader.
+const std::string GBUF_VOLUME_VERT_SHADER_FILEPATH = "../resources/shaders/gbuf-volume.vert";
 
-/// Naming convention for projection matrix in shaders
-const std::string PROJ_MAT_UNIFORM_NAME = "projMat";
+/// Hard-coded filepath to the point light volume fragment shader.
+const std::string GBUF_VOLUME_FRAG_SHADER_FILEPATH = "../resources/shaders/gbuf-volume.frag";
 
-/// Uniform name for the view position in the lighting pass shaders
-const std::string VIEW_POS_UNIFORM_NAME = "viewPos";
+/// Hard-coded filepath to the point light volume stencil pass fragment shader.
+const std::string GBUF_VOLUME_STENCIL_FRAG_SHADER_FILEPATH = "../resources/shaders/gbuf-volume-stencil.frag";
 
 /// Uniform name for the position texture in the lighting pass frag shader
 const std::string POSITION_TEX_UNIFORM_NAME = "gPosition";
@@ -56,6 +66,32 @@ const unsigned int NORMAL_TEX_UNIT = 1;
 /// Texture unit that the albedo texture will always be bound to
 const unsigned int ALBEDOSPEC_TEX_UNIT = 2;
 
+// (Texture unit 3 is the Scene's point light buffer)
+
+/// Uniform name for the light cluster grid in the lighting pass frag shader
+const std::string CLUSTER_GRID_UNIFORM_NAME = "clusterGrid";
+
+/// Uniform name for the clusters' light index lists in the lighting pass frag shader
+const std::string CLUSTER_LIGHT_INDICES_UNIFORM_NAME = "clusterLightIndices";
+
+/// Texture unit that the light cluster grid will always be bound to
+const unsigned int CLUSTER_GRID_TEX_UNIT = 4;
+
+/// Texture unit that the clusters' light index lists will always be bound to
+const unsigned int CLUSTER_LIGHT_INDICES_TEX_UNIT = 5;
+
+/// Uniform name for the bool that turns the cluster loop in the lighting pass on/off
+const std::string SHADE_CLUSTERED_LIGHTS_UNIFORM_NAME = "shadeClusteredLights";
+
+/// Uniform name for the point light buffer in the light volume shaders
+const std::string VOLUME_POINT_LIGHT_DATA_UNIFORM_NAME = "pointLightData";
+
+/// Texture unit the Scene binds its point light buffer to
+const unsigned int VOLUME_POINT_LIGHT_DATA_TEX_UNIT = 3;
+
+/// Uniform name for the index of the light a volume is drawn for
+const std::string VOLUME_LIGHT_INDEX_UNIFORM_NAME = "lightIndex";
+
 
 
 /**
@@ -70,12 +106,31 @@ GBuffer::GBuffer(WindowManager& window)
     mGeometryShaders("g-buffer geometry shaders",
                      GBUF_GEO_VERT_SHADER_FILEPATH.c_str(),
                      GBUF_GEO_FRAG_SHADER_FILEPATH.c_str()),
+    mDepthShaders("g-buffer depth pre-pass shaders",
+                  DEPTH_PREPASS_VERT_SHADER_FILEPATH.c_str(),
+                  DEPTH_PREPASS_FRAG_SHADER_FILEPATH.c_str()),
     mLightingShaders("g-buffer lighting shaders",
                      GBUF_LIGHT_VERT_SHADER_FILEPATH.c_str(),
-                     GBUF_LIGHT_FRAG_SHADER_FILEPATH.c_str())
+                     GBUF_LIGHT_FRAG_SHADER_FILEPATH.c_str()),
+    mLightClusters(),
+    mLightVolume(),
+    mVolumeShaders("g-buffer light volume shaders",
+                   GBUF_VOLUME_VERT_SHADER_FILEPATH.c_str(),
+                   GBUF_VOLUME_FRAG_SHADER_FILEPATH.c_str()),
+    mVolumeStencilShaders("g-buffer light volume stencil shaders",
+                          GBUF_VOLUME_VERT_SHADER_FILEPATH.c_str(),
+                          GBUF_VOLUME_STENCIL_FRAG_SHADER_FILEPATH.c_str())
 
 {
 
+    // GPU-driven draws need their own vertex shader
+    if (window.IsGPUDriven())
+    {
+        mIndirectGeometryShaders = std::make_unique<ShaderProgram>("g-buffer indirect geometry shaders",
+                                                                   GBUF_GEO_INDIRECT_VERT_SHADER_FILEPATH.c_str(),
+                                                                   GBUF_GEO_FRAG_SHADER_FILEPATH.c_str());
+    }
+
     // Grab the scrWidth and scrHeight of the window real quick
     auto size = window.GetWindowSize();
     auto scrWidth = size.first;
@@ -143,15 +198,13 @@ GBuffer::GBuffer(WindowManager& window)
     // yeah
     glDepthFunc(GL_LESS);
 
-    // Out of "courtesy," we'll initialize some uniforms in the shaders,
-    // so we don't have to repeatedly & redundantly do it at runtime
+    // Queries to count the geometry pass's fragments with
+    glGenQueries(GBUFFER_OVERDRAW_QUERIES, mOverdrawQueries);
 
-    // Geometry shaders:
-    mGeometryShaders.use();
-
-    // Projection matrix will likely never change, so we can set it here
-    auto projMat = mWindow.GetProjectionMatrix();
-    mGeometryShaders.SetMat4Uniform(PROJ_MAT_UNIFORM_NAME, projMat);
+    // Out of "courtesy," we'll initialize some uniforms in the shaders,
+    // so we don't have to repeatedly & redundantly do it at runtime.
+    // The camera matrices & position come from the FrameConstants
+    // uniform buffer, which the WindowManager fills once per frame.
 
     // Lighting shaders:
     mLightingShaders.use();
@@ -163,6 +216,20 @@ GBuffer::GBuffer(WindowManager& window)
     mLightingShaders.SetIntUniform(POSITION_TEX_UNIFORM_NAME, POSITION_TEX_UNIT);
     mLightingShaders.SetIntUniform(NORMAL_TEX_UNIFORM_NAME, NORMAL_TEX_UNIT);
     mLightingShaders.SetIntUniform(ALBEDOSPEC_TEX_UNIFORM_NAME, ALBEDOSPEC_TEX_UNIT);
+    mLightingShaders.SetIntUniform(CLUSTER_GRID_UNIFORM_NAME, CLUSTER_GRID_TEX_UNIT);
+    mLightingShaders.SetIntUniform(CLUSTER_LIGHT_INDICES_UNIFORM_NAME, CLUSTER_LIGHT_INDICES_TEX_UNIT);
+
+    // Light volume shaders read the same g-buffer textures & light buffer
+    mVolumeShaders.use();
+    mVolumeShaders.SetIntUniform(POSITION_TEX_UNIFORM_NAME, POSITION_TEX_UNIT);
+    mVolumeShaders.SetIntUniform(NORMAL_TEX_UNIFORM_NAME, NORMAL_TEX_UNIT);
+    mVolumeShaders.SetIntUniform(ALBEDOSPEC_TEX_UNIFORM_NAME, ALBEDOSPEC_TEX_UNIT);
+    mVolumeShaders.SetIntUniform(VOLUME_POINT_LIGHT_DATA_UNIFORM_NAME, VOLUME_POINT_LIGHT_DATA_TEX_UNIT);
+    mVolumeLightIndex = mVolumeShaders.GetUniformHandle<int>(VOLUME_LIGHT_INDEX_UNIFORM_NAME);
+
+    mVolumeStencilShaders.use();
+    mVolumeStencilShaders.SetIntUniform(VOLUME_POINT_LIGHT_DATA_UNIFORM_NAME, VOLUME_POINT_LIGHT_DATA_TEX_UNIT);
+    mStencilLightIndex = mVolumeStencilShaders.GetUniformHandle<int>(VOLUME_LIGHT_INDEX_UNIFORM_NAME);
 
 }
 
@@ -170,10 +237,19 @@ GBuffer::GBuffer(WindowManager& window)
 
 /**
  * Render a scene full of RenderObjects and lights to the g-buffer
+ *
+ * Resets the per-frame uniform upload counters first, so
+ * ShaderProgram::GetFrameUploadStats() tells how many uploads
+ * this frame issued and how many it skipped as redundant.
+ *
  * @param scene Scene (filled with objects and lights) to render
  */
 void GBuffer::RenderScene(Scene &scene)
 {
+    // Count the uniform uploads of this frame, only.
+    // Read them back with ShaderProgram::GetFrameUploadStats()
+    ShaderProgram::ResetFrameUploadStats();
+
     GeometryPass(scene);
     LightingPass(scene);
     //SkyboxPass(scene);
@@ -181,10 +257,51 @@ void GBuffer::RenderScene(Scene &scene)
 
 
 
+/**
+ * Start counting the fragments that get past the depth test, with the
+ * next of the overdraw queries. End it with glEndQuery(GL_SAMPLES_PASSED).
+ *
+ * That query was last used a few frames ago, so its count is most
+ * likely in by now: it goes to the scene (see Scene::RecordOverdraw),
+ * if it counted the same scene. If it isn't in yet, it just gets lost,
+ * rather than waiting on the GPU for it.
+ *
+ * @param scene the scene about to be drawn
+ */
+void GBuffer::BeginOverdrawQuery(Scene &scene)
+{
+    unsigned int slot = mOverdrawFrame++ % GBUFFER_OVERDRAW_QUERIES;
+    unsigned int query = mOverdrawQueries[slot];
+
+    if (mOverdrawScenes[slot] == &scene)
+    {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_TRUE)
+        {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+
+            auto size = mWindow.GetWindowSize();
+            scene.RecordOverdraw((float)samples / (float)(size.first * size.second));
+        }
+    }
+
+    mOverdrawScenes[slot] = &scene;
+    glBeginQuery(GL_SAMPLES_PASSED, query);
+}
+
+
+
 /**
  * BindTextures the geometry pass
  * BindTextures all geo/color data to the g-buffer
  *
+ * With the scene's depth pre-pass on, draws the depth of everything
+ * first, then everything again, keeping just the fragments at that
+ * depth (see GBuffer.h). Either way, the fragments that get past
+ * GL_LESS get counted, for the scene's overdraw.
+ *
  * @param scene List of objects whose color/geometry data we want
  */
 void GBuffer::GeometryPass(Scene &scene)
@@ -195,14 +312,50 @@ void GBuffer::GeometryPass(Scene &scene)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
 
-    // Get the transformation matrices from the window & set uniforms
-    auto viewMat = mWindow.GetCamera()->GetViewMatrix();
-
-    // Render all objects
-    mGeometryShaders.use();
-    mGeometryShaders.SetMat4Uniform(VIEW_MAT_UNIFORM_NAME, viewMat);
-    scene.RenderObjects(mGeometryShaders);
-
+    // Scenes that ask for it skip back faces (and the Scene skips
+    // whole clusters of them--see ClusterCulling.h)
+    if (scene.GetBackfaceCulling())
+        glEnable(GL_CULL_FACE);
+
+    // Render all objects in view
+    // (view & projection matrices are in the FrameConstants block)
+    auto size = mWindow.GetWindowSize();
+    if (mIndirectGeometryShaders != nullptr)
+    {
+        // The GPU culls & builds the draws itself
+        BeginOverdrawQuery(scene);
+        scene.RenderObjectsIndirect(*mIndirectGeometryShaders, mWindow.GetFrameConstants(), size.second);
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+    else if (scene.UsesDepthPrepass())
+    {
+        scene.QueueObjects(mGeometryShaders, mWindow.GetFrameConstants(), size.second);
+
+        // Depth only, first. What gets past the depth test here is
+        // what the g-buffer pass would've shaded without this pass
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        BeginOverdrawQuery(scene);
+        scene.SubmitObjectsDepth(mDepthShaders);
+        glEndQuery(GL_SAMPLES_PASSED);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // Then shade just the fragment nearest the camera of each pixel.
+        // (The depth's already there, no need to write it again)
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+        scene.SubmitObjects();
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+    else
+    {
+        mGeometryShaders.use();
+        BeginOverdrawQuery(scene);
+        scene.RenderObjects(mGeometryShaders, mWindow.GetFrameConstants(), size.second);
+        glEndQuery(GL_SAMPLES_PASSED);
+    }
+
+    glDisable(GL_CULL_FACE);
 }
 
 
@@ -215,15 +368,12 @@ void GBuffer::LightingPass(Scene& scene)
 {
     // Re-bind default framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     // Activate lighting shaders
+    // (view position is in the FrameConstants block)
     mLightingShaders.use();
 
-    // Set view position to the camera position
-    auto camPos = mWindow.GetCamera()->GetPosition();
-    mLightingShaders.SetVec3Uniform(VIEW_POS_UNIFORM_NAME, camPos);
-
     // bind all g-buffer textures
     glActiveTexture(GL_TEXTURE0 + POSITION_TEX_UNIT);
     glBindTexture(GL_TEXTURE_2D, mGPosition);
@@ -238,9 +388,114 @@ void GBuffer::LightingPass(Scene& scene)
     // Tell the scene to "render lighting" (set lighting unis)
     scene.RenderLighting(mLightingShaders);
 
+    // Point lights either get shaded right in the fullscreen
+    // pass, or drawn as light volumes on top of it afterward
+    bool clustered = (mLightingMode == LightingMode::Clustered);
+    mLightingShaders.SetBoolUniform(SHADE_CLUSTERED_LIGHTS_UNIFORM_NAME, clustered);
+
+    if (clustered)
+    {
+        // Sort the point lights into clusters, so each pixel only
+        // shades the handful of lights that can actually reach it
+        const FrameConstants& frame = mWindow.GetFrameConstants();
+        mLightClusters.Build(scene.GetPointLightBuffer().GetLights(), frame.viewMat, frame.projMat);
+        mLightClusters.Bind(CLUSTER_GRID_TEX_UNIT, CLUSTER_LIGHT_INDICES_TEX_UNIT);
+
+        auto size = mWindow.GetWindowSize();
+        mLightClusters.SetUniforms(mLightingShaders, size.first, size.second);
+    }
+
     // With textures bound and lighting shaders active,
     // draw the fullscreen quad to the default framebuffer!
     mFullscreenQuad.Draw();
+
+    if (!clustered)
+    {
+        LightVolumePass(scene);
+    }
+}
+
+
+
+/**
+ * Add each point light on top of the lighting pass by
+ * drawing a sphere the size of its range, so only the
+ * pixels the light can reach get shaded.
+ *
+ * Uses the stencil two-pass trick, per light:
+ *  1. Draw the sphere into the stencil buffer only, with the
+ *     scene's depth. Back faces behind the scene count up,
+ *     front faces behind the scene count down, so pixels whose
+ *     geometry is inside the sphere end up non-zero.
+ *     (Works with the camera inside the sphere, too.)
+ *  2. Draw the sphere's back faces with the lighting shader,
+ *     only where the stencil is non-zero, adding the light on.
+ *     This also zeroes the stencil again for the next light.
+ *
+ * Expects the g-buffer textures & point light buffer to be bound
+ * already, like they are at the end of the lighting pass.
+ *
+ * @param scene Scene with the point lights to draw
+ */
+void GBuffer::LightVolumePass(Scene &scene)
+{
+    // The volumes need the scene's depth to test against
+    auto size = mWindow.GetWindowSize();
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mGBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, size.first, size.second, 0, 0, size.first, size.second,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glEnable(GL_STENCIL_TEST);
+    glDepthMask(GL_FALSE);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    // Skip lights entirely behind the camera
+    const glm::mat4& viewMat = mWindow.GetFrameConstants().viewMat;
+    const auto& lights = scene.GetPointLightBuffer().GetLights();
+
+    for (unsigned int i = 0; i < lights.size(); ++i)
+    {
+        float range = lights[i].specularRange.w;
+        float depth = -(viewMat * glm::vec4(glm::vec3(lights[i].positionConstant), 1.0f)).z;
+        if (range <= 0.0f || depth + range < 0.0f)
+            continue;
+
+        // Stencil pass
+        mVolumeStencilShaders.use();
+        mVolumeStencilShaders.SetUniform(mStencilLightIndex, (int)i);
+
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glStencilFunc(GL_ALWAYS, 0, 0);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        mLightVolume.Draw();
+
+        // Lighting pass
+        mVolumeShaders.use();
+        mVolumeShaders.SetUniform(mVolumeLightIndex, (int)i);
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glEnable(GL_BLEND);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        mLightVolume.Draw();
+    }
+
+    // Put everything back how the other passes expect it
+    glCullFace(GL_BACK);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_BLEND);
+    glDisable(GL_STENCIL_TEST);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
 }
 
 
@@ -260,8 +515,7 @@ void GBuffer::SkyboxPass(Scene &scene)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // Render skybox;
-    // TODO figure out a cleaner way to give the projmat to skybox??
-    scene.RenderSkybox(mWindow.GetProjectionMatrix(), mWindow.GetCamera()->GetViewMatrix());
+    scene.RenderSkybox();
     // TODO... i think this just won't work in a deferred system now,
     // just like how blending won't work. gotta look into this.
 
@@ -8,13 +8,33 @@
  * and has functions for rendering a scene
  * to the g-buffer & drawing it to the
  * default framebuffer/screen
+ *
+ * The geometry pass writes three color targets (two of them RGBA16F)
+ * for every fragment that gets past the depth test, so in a dense
+ * interior, where the same pixel gets covered a few times over, most
+ * of those writes get thrown away. With a depth pre-pass (see
+ * Scene::SetDepthPrepassMode), the scene's depth gets drawn first,
+ * with a shader that does nothing else, and then the real geometry
+ * pass only keeps fragments exactly at that depth (GL_EQUAL, depth
+ * writes off): every pixel gets shaded & written once.
+ *
+ * Drawing everything twice only pays off with enough overdraw, so
+ * every geometry pass counts the fragments that get past GL_LESS
+ * with an occlusion query, and hands the scene the count per pixel
+ * (see Scene::GetOverdraw) a few frames later, when it's in
+ * without waiting on the GPU. In Auto mode, that turns the pre-pass
+ * on and off. (GPU-driven geometry passes never do a pre-pass.)
  */
 
 #ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_GBUFFER_H
 #define LEARNING_OPENGL_GRAPHICSLIB_SRC_GBUFFER_H
 
+#include <memory>
+
 #include "ShaderProgram.h"
 #include "FullscreenQuad.h"
+#include "LightClusterGrid.h"
+#include "LightVolumeSphere.h"
 
 
 class WindowManager;
@@ -22,6 +42,26 @@ class RenderObject;
 class PointLight;
 class DirectionalLight;
 class Scene;
+
+/// How many overdraw queries the g-buffer takes turns with, so
+/// it reads each one's result a few frames after it was made
+const unsigned int GBUFFER_OVERDRAW_QUERIES = 3;
+
+/**
+ * How the lighting pass shades the point lights
+ */
+enum class LightingMode
+{
+    /// One fullscreen pass, where each pixel loops over
+    /// the lights in its cluster. Best for lots of small lights.
+    Clustered,
+
+    /// Each light gets drawn as a stencil-masked sphere of its range,
+    /// on top of a fullscreen pass for the directional light.
+    /// Best for a few big lights.
+    LightVolumes
+};
+
 /**
  * A g-buffer for deferred shading.
  */
@@ -50,15 +90,54 @@ private:
     /// Shader program for geometry pass
     ShaderProgram mGeometryShaders;
 
+    /// Shader program for the depth pre-pass of the geometry pass
+    ShaderProgram mDepthShaders;
+
+    /// Shader program for the geometry pass when the GPU builds the
+    /// draws (only made in GPU-driven contexts, see IndirectRenderer)
+    std::unique_ptr<ShaderProgram> mIndirectGeometryShaders;
+
     /// Shader program for lighting pass
     ShaderProgram mLightingShaders;
 
+    /// Per-cluster point light lists for the lighting pass
+    LightClusterGrid mLightClusters;
+
+    /// How the lighting pass shades the point lights
+    LightingMode mLightingMode = LightingMode::Clustered;
+
+    /// Sphere drawn for each point light in LightVolumes mode
+    LightVolumeSphere mLightVolume;
+
+    /// Shader program that shades the pixels inside a light volume
+    ShaderProgram mVolumeShaders;
+
+    /// Shader program that only marks a light volume in the stencil buffer
+    ShaderProgram mVolumeStencilShaders;
+
+    /// Handle to the light index uniform of the volume shaders
+    UniformHandle<int> mVolumeLightIndex;
+
+    /// Handle to the light index uniform of the volume stencil shaders
+    UniformHandle<int> mStencilLightIndex;
+
+    /// GL ids of the occlusion queries that count the geometry pass's fragments
+    unsigned int mOverdrawQueries[GBUFFER_OVERDRAW_QUERIES];
+
+    /// Scene each overdraw query counted (nullptr if it hasn't been used yet)
+    const Scene* mOverdrawScenes[GBUFFER_OVERDRAW_QUERIES] = {};
+
+    /// Geometry passes so far, to take turns with the queries
+    unsigned int mOverdrawFrame = 0;
+
     /// The window we'll render to
     WindowManager& mWindow;
 
+    void BeginOverdrawQuery(Scene& scene);
     void GeometryPass(Scene &scene);
     void LightingPass(Scene& scene);
     void SkyboxPass(Scene& scene);
+    void LightVolumePass(Scene& scene);
 
 public:
 
@@ -77,6 +156,19 @@ public:
 
     void RenderScene(Scene& scene);
 
+    /**
+     * Choose how the lighting pass shades the point lights.
+     * Takes effect on the next frame.
+     * @param mode the new lighting mode
+     */
+    void SetLightingMode(LightingMode mode) { mLightingMode = mode; }
+
+    /**
+     * Get how the lighting pass shades the point lights
+     * @return the current lighting mode
+     */
+    LightingMode GetLightingMode() const { return mLightingMode; }
+
 
 
 };
@@ -0,0 +1,453 @@
+/**
+ * @file IndirectRenderer.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <glad/glad.h>
+
+#include "IndirectRenderer.h"
+#include "RenderObject.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "MeshBuffer.h"
+#include "FrameConstants.h"
+#include "FrustumCuller.h"
+
+/// Hard-coded filepath to the culling compute shader
+const std::string GPU_CULL_COMP_SHADER_FILEPATH = "../resources/shaders/gpu-cull.comp";
+
+// glad has to be generated for GL 4.3+ for any of this to exist.
+// With a 3.3 glad, WindowManager::IsGPUDriven() is never true, so
+// nothing makes an IndirectRenderer, and the stubs at the bottom
+// are all there is
+#ifdef GL_VERSION_4_3
+
+/// Invocations per work group of the cull shader (its local_size_x)
+const unsigned int GPU_CULL_GROUP_SIZE = 64;
+
+/// Shader storage binding of the draw records (in both shaders)
+const unsigned int DRAW_RECORDS_BINDING = 0;
+
+/// Shader storage binding of the object transforms (in both shaders)
+const unsigned int OBJECT_TRANSFORMS_BINDING = 1;
+
+/// Shader storage binding of the commands, in the cull shader
+const unsigned int DRAW_COMMANDS_BINDING = 2;
+
+/// Shader storage binding of the bucket command counts, in the cull shader
+const unsigned int DRAW_COUNTS_BINDING = 3;
+
+/**
+ * One indirect draw, laid out like GL wants it
+ */
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+
+/**
+ * Constructor. Needs a current GL 4.3+ context!
+ */
+IndirectRenderer::IndirectRenderer()
+    :
+    mCullShaders("gpu cull shader", GPU_CULL_COMP_SHADER_FILEPATH.c_str())
+{
+    mNumRecordsUniform = mCullShaders.GetUniformHandle<int>("numRecords");
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        mFrustumPlaneUniforms[i] =
+            mCullShaders.GetUniformHandle<glm::vec4>("frustumPlanes[" + std::to_string(i) + "]");
+    }
+    mPixelsPerUnitUniform = mCullShaders.GetUniformHandle<float>("pixelsPerUnit");
+    mLODBiasUniform = mCullShaders.GetUniformHandle<float>("lodBias");
+
+    // These never change
+    mCullShaders.use();
+    mCullShaders.set1FUniform("lodCullPixels", LOD_CULL_PIXELS);
+    mCullShaders.set1FUniform("lodFullDetailPixels", LOD_FULL_DETAIL_PIXELS);
+
+    glGenBuffers(1, &mRecordBuffer);
+    glGenBuffers(1, &mTransformBuffer);
+    glGenBuffers(1, &mCommandBuffer);
+    glGenBuffers(1, &mCountBuffer);
+    glGenBuffers(1, &mDrawIdBuffer);
+
+    // (Draw counts need glad generated for 4.6, too)
+#ifdef GL_VERSION_4_6
+    mHasDrawCount = GLAD_GL_VERSION_4_6 != 0;
+#else
+    mHasDrawCount = false;
+#endif
+}
+
+
+
+/**
+ * Destructor
+ */
+IndirectRenderer::~IndirectRenderer()
+{
+    for (MeshBuffer* buffer : mMeshBuffers)
+        buffer->SetDrawIdBuffer(0);
+
+    glDeleteBuffers(1, &mRecordBuffer);
+    glDeleteBuffers(1, &mTransformBuffer);
+    glDeleteBuffers(1, &mCommandBuffer);
+    glDeleteBuffers(1, &mCountBuffer);
+    glDeleteBuffers(1, &mDrawIdBuffer);
+}
+
+
+
+/**
+ * Cull & draw a scene's objects to the bound framebuffer.
+ * Call RenderObject::UpdateTransforms() first, the same frame,
+ * so the transforms that moved can be uploaded.
+ *
+ * @param objects every object in the scene
+ * @param shaders shaders to draw with (like gbuf-geo-indirect.vert)
+ * @param frame this frame's camera matrices
+ * @param screenHeight height of the framebuffer, in pixels
+ * @param lodBias quality bias for picking levels of detail (see Scene::SetLODBias)
+ */
+void IndirectRenderer::Render(const std::vector<RenderObject*> &objects, ShaderProgram &shaders,
+                              const FrameConstants &frame, int screenHeight, float lodBias)
+{
+    mStats = IndirectRendererStats();
+
+    // Only a change to the object list costs anything per object
+    if (objects != mObjects)
+    {
+        Rebuild(objects);
+        mStats.rebuilt = true;
+    }
+    UploadTransforms();
+
+    mStats.records = mNumRecords;
+    if (mNumRecords == 0)
+        return;
+
+    Cull(frame, screenHeight, lodBias);
+    Draw(shaders);
+}
+
+
+
+/**
+ * Make the draw records & buckets for a new list of objects,
+ * and size the buffers to match.
+ *
+ * @param objects every object in the scene
+ */
+void IndirectRenderer::Rebuild(const std::vector<RenderObject*> &objects)
+{
+    mObjects = objects;
+
+    // Group the meshes into buckets: same textures, then same
+    // vertex array & index type (so sorting the keys sorts by material)
+    auto bucketKey = [](const Mesh* mesh) {
+        std::vector<unsigned int> key;
+        for (const TextureData& texture : mesh->GetTextures())
+        {
+            key.push_back(texture.id);
+            key.push_back((unsigned int)texture.type);
+        }
+        key.push_back(mesh->GetVertexArray());
+        key.push_back(mesh->GetDrawRange(0).indexType);
+        return key;
+    };
+
+    std::map<std::vector<unsigned int>, Bucket> buckets;
+    unsigned int maxTransformId = 0;
+    for (RenderObject* object : objects)
+    {
+        maxTransformId = std::max(maxTransformId, object->GetTransformId());
+        for (const auto& mesh : object->GetModel()->GetMeshes())
+        {
+            auto bucket = buckets.emplace(bucketKey(mesh.get()), Bucket{mesh.get(), 0, 0, 0, 0}).first;
+            bucket->second.numCommands++;
+        }
+    }
+
+    // Lay the buckets' command ranges out in key order
+    std::map<std::vector<unsigned int>, unsigned int> bucketIndices;
+    mBuckets.clear();
+    mNumRecords = 0;
+    const std::vector<unsigned int>* lastKey = nullptr;
+    for (auto& entry : buckets)
+    {
+        Bucket& bucket = entry.second;
+        const std::vector<unsigned int>& key = entry.first;
+
+        // Same textures as the last bucket? (Everything but the last two entries)
+        bool sameMaterial = lastKey != nullptr && lastKey->size() == key.size() &&
+                            std::equal(key.begin(), key.end() - 2, lastKey->begin());
+        bucket.materialId = mBuckets.empty() ? 0 : mBuckets.back().materialId + (sameMaterial ? 0 : 1);
+        bucket.indexType = key.back();
+        bucket.firstCommand = mNumRecords;
+        mNumRecords += bucket.numCommands;
+
+        bucketIndices[key] = (unsigned int)mBuckets.size();
+        mBuckets.push_back(bucket);
+        lastKey = &key;
+    }
+
+    // Now the records themselves
+    std::vector<DrawRecord> records;
+    records.reserve(mNumRecords);
+    mMeshBuffers.clear();
+    for (RenderObject* object : objects)
+    {
+        for (const auto& mesh : object->GetModel()->GetMeshes())
+        {
+            unsigned int bucket = bucketIndices[bucketKey(mesh.get())];
+
+            const AABB& bounds = mesh->GetBounds();
+            const glm::mat4& positionTransform = mesh->GetPositionTransform();
+
+            DrawRecord record = {};
+            record.sphere = glm::vec4(bounds.Center(), glm::length(bounds.Extents()));
+            record.positionScale = glm::vec4(positionTransform[0][0], positionTransform[1][1],
+                                             positionTransform[2][2], 0.0f);
+            record.positionOffset = glm::vec4(glm::vec3(positionTransform[3]), 0.0f);
+            record.transformId = object->GetTransformId();
+            record.numLODs = mesh->GetNumLODs();
+            record.bucket = bucket;
+            record.firstCommand = mBuckets[bucket].firstCommand;
+
+            for (unsigned int lod = 0; lod < MAX_MESH_LODS; ++lod)
+            {
+                // Meshes with fewer LODs repeat their last one
+                MeshDrawRange range = mesh->GetDrawRange(lod);
+                size_t indexSize = (range.indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+                record.lodCounts[lod] = (uint32_t)range.count;
+                record.lodFirstIndices[lod] = (uint32_t)((size_t)range.indices / indexSize);
+                record.baseVertex = range.baseVertex;
+            }
+            records.push_back(record);
+
+            MeshBuffer* meshBuffer = &mesh->GetMeshBuffer();
+            if (std::find(mMeshBuffers.begin(), mMeshBuffers.end(), meshBuffer) == mMeshBuffers.end())
+                mMeshBuffers.push_back(meshBuffer);
+        }
+    }
+
+    // Size the buffers...
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mRecordBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(DrawRecord), records.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mNumRecords * sizeof(DrawElementsIndirectCommand), nullptr,
+                 GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mBuckets.size() * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::vector<uint32_t> drawIds(mNumRecords);
+    std::iota(drawIds.begin(), drawIds.end(), 0u);
+    glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(uint32_t), drawIds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (MeshBuffer* meshBuffer : mMeshBuffers)
+        meshBuffer->SetDrawIdBuffer(mDrawIdBuffer);
+
+    // ... and start the transforms over, all of them
+    mTransforms.assign(objects.empty() ? 0 : maxTransformId + 1, ObjectTransform());
+    mTransformObjects.assign(mTransforms.size(), nullptr);
+    for (RenderObject* object : objects)
+    {
+        mTransformObjects[object->GetTransformId()] = object;
+        ObjectTransform& transform = mTransforms[object->GetTransformId()];
+        transform.modelMat = object->GetModelMatrix();
+        transform.normalMat = glm::mat4(object->GetNormalMatrix());
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mTransforms.size() * sizeof(ObjectTransform), mTransforms.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    mStats.transformsUploaded = (unsigned int)objects.size();
+}
+
+
+
+/**
+ * Upload the transforms the last RenderObject::UpdateTransforms()
+ * rebuilt. Just the range between the lowest & highest id that
+ * moved goes up, so a scene where nothing moves uploads nothing.
+ */
+void IndirectRenderer::UploadTransforms()
+{
+    auto numTransforms = (unsigned int)mTransforms.size();
+
+    unsigned int lowest = numTransforms;
+    unsigned int highest = 0;
+    for (unsigned int id : RenderObject::GetUpdatedTransformIds())
+    {
+        // (Objects that moved, but aren't in the scene, don't matter)
+        RenderObject* object = id < numTransforms ? mTransformObjects[id] : nullptr;
+        if (object == nullptr)
+            continue;
+
+        mTransforms[id].modelMat = object->GetModelMatrix();
+        mTransforms[id].normalMat = glm::mat4(object->GetNormalMatrix());
+        lowest = std::min(lowest, id);
+        highest = std::max(highest, id);
+        mStats.transformsUploaded++;
+    }
+
+    if (lowest > highest)
+        return;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTransformBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, lowest * sizeof(ObjectTransform),
+                    (highest - lowest + 1) * sizeof(ObjectTransform), &mTransforms[lowest]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+
+/**
+ * Run the cull shader: every record in view gets a command in
+ * its bucket, at the level of detail its size on screen calls for
+ *
+ * @param frame this frame's camera matrices
+ * @param screenHeight height of the framebuffer, in pixels
+ * @param lodBias quality bias for picking levels of detail
+ */
+void IndirectRenderer::Cull(const FrameConstants &frame, int screenHeight, float lodBias)
+{
+    // Start every bucket's count at zero. Without draw counts,
+    // the commands themselves too, so unused slots draw nothing
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mCountBuffer);
+    glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    if (!mHasDrawCount)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, mCommandBuffer);
+        glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // The shader tests spheres, so the planes have to be unit length
+    Frustum frustum = Frustum::FromMatrix(frame.viewProjMat);
+
+    mCullShaders.use();
+    mCullShaders.SetUniform(mNumRecordsUniform, (int)mNumRecords);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glm::vec4 plane = frustum.planes[i] / glm::length(glm::vec3(frustum.planes[i]));
+        mCullShaders.SetUniform(mFrustumPlaneUniforms[i], plane);
+    }
+    mCullShaders.SetUniform(mPixelsPerUnitUniform, frame.projMat[1][1] * (float)screenHeight);
+    mCullShaders.SetUniform(mLODBiasUniform, lodBias);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_RECORDS_BINDING, mRecordBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_TRANSFORMS_BINDING, mTransformBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COMMANDS_BINDING, mCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COUNTS_BINDING, mCountBuffer);
+
+    glDispatchCompute((mNumRecords + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+
+    // The draws read the commands & counts as indirect arguments
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+
+
+/**
+ * Draw every bucket with one multi-draw-indirect call, binding
+ * textures & vertex arrays only when they change
+ *
+ * @param shaders shaders to draw with
+ */
+void IndirectRenderer::Draw(ShaderProgram &shaders)
+{
+    shaders.use();
+    mStats.drawCalls = (unsigned int)mBuckets.size();
+
+    // (The records & transforms are still bound from culling)
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+#ifdef GL_VERSION_4_6
+    if (mHasDrawCount)
+        glBindBuffer(GL_PARAMETER_BUFFER, mCountBuffer);
+#endif
+
+    unsigned int boundVertexArray = 0;
+    const Bucket* bound = nullptr;
+    for (unsigned int i = 0; i < mBuckets.size(); ++i)
+    {
+        const Bucket& bucket = mBuckets[i];
+
+        if (bound == nullptr || bound->materialId != bucket.materialId)
+            bucket.mesh->BindTextures(shaders);
+        if (boundVertexArray != bucket.mesh->GetVertexArray())
+        {
+            bucket.mesh->BindVertexArray();
+            boundVertexArray = bucket.mesh->GetVertexArray();
+        }
+        bound = &bucket;
+
+        auto commands = (const void*)((size_t)bucket.firstCommand * sizeof(DrawElementsIndirectCommand));
+#ifdef GL_VERSION_4_6
+        if (mHasDrawCount)
+        {
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, bucket.indexType, commands,
+                                             (GLintptr)(i * sizeof(uint32_t)), (GLsizei)bucket.numCommands, 0);
+            continue;
+        }
+#endif
+        glMultiDrawElementsIndirect(GL_TRIANGLES, bucket.indexType, commands, (GLsizei)bucket.numCommands, 0);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+#ifdef GL_VERSION_4_6
+    if (mHasDrawCount)
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+#endif
+}
+
+#else
+
+
+
+/**
+ * Constructor. This build's glad is older than GL 4.3, so there
+ * are no GPU-driven draws to make (see WindowManager::IsGPUDriven())
+ */
+IndirectRenderer::IndirectRenderer()
+    :
+    mCullShaders("gpu cull shader", GPU_CULL_COMP_SHADER_FILEPATH.c_str())
+{
+    throw std::runtime_error("IndirectRenderer needs glad generated for GL 4.3+");
+}
+
+
+
+/**
+ * Destructor
+ */
+IndirectRenderer::~IndirectRenderer() = default;
+
+
+
+/**
+ * Never called: there's no IndirectRenderer without GL 4.3
+ */
+void IndirectRenderer::Render(const std::vector<RenderObject*> &objects, ShaderProgram &shaders,
+                              const FrameConstants &frame, int screenHeight, float lodBias)
+{
+}
+
+#endif
@@ -0,0 +1,227 @@
+/**
+ * @file IndirectRenderer.h
+ * @author Elijah Gleckler
+ *
+ * GPU-driven drawing of a scene's objects, for GL 4.3+
+ * contexts (see GLContextMode::GPUDriven).
+ *
+ * Every (object, mesh) pair in the scene gets a draw record on
+ * the GPU: its bounding sphere, the index ranges of its levels of
+ * detail, and which object transform it uses. Each frame a compute
+ * shader (gpu-cull.comp) tests every record against the frustum,
+ * picks its LOD from its size on screen, and appends a
+ * DrawElementsIndirectCommand for the survivors. The geometry pass
+ * is then one multi-draw-indirect per bucket--meshes with the same
+ * textures, vertex array & index type--and the vertex shader
+ * (gbuf-geo-indirect.vert) looks its record & transform up in
+ * shader storage buffers.
+ *
+ * So the CPU does nothing per object on a normal frame: the
+ * records only get rebuilt when the scene's object list changes,
+ * and only the transforms that moved get uploaded.
+ *
+ * Draws find their record through their base instance: each
+ * command's base instance is its record's index, and the MeshBuffer
+ * VAOs read a per-instance draw id (see MeshBuffer.h) that starts
+ * there. That works back to GL 4.3, where there's no gl_DrawID
+ * or gl_BaseInstance in shaders.
+ *
+ * GL 4.6 draws just the commands the compute shader wrote, with
+ * glMultiDrawElementsIndirectCount. Before that, the command buffer
+ * gets zeroed every frame, and culled slots draw zero instances.
+ *
+ * GL 4.x core has no bindless textures, so textures are still bound
+ * by the CPU, once per bucket. That's per material, not per object.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_INDIRECTRENDERER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_INDIRECTRENDERER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+#include "ShaderProgram.h"
+
+class RenderObject;
+class Mesh;
+class MeshBuffer;
+struct FrameConstants;
+
+/**
+ * What the indirect renderer did on the last frame. How many draws
+ * survived culling is only known on the GPU, so it isn't here.
+ */
+struct IndirectRendererStats
+{
+    /// Draw records the GPU culled & picked LODs for
+    unsigned int records = 0;
+
+    /// Multi-draw-indirect calls they went out in (one per bucket)
+    unsigned int drawCalls = 0;
+
+    /// Object transforms uploaded to the GPU
+    unsigned int transformsUploaded = 0;
+
+    /// Did the draw records have to be rebuilt (because the objects changed)?
+    bool rebuilt = false;
+};
+
+/**
+ * Culls and draws a scene's objects on the GPU
+ */
+class IndirectRenderer
+{
+private:
+
+    /// One (object, mesh) pair, exactly as the shaders see it (std430)
+    struct DrawRecord
+    {
+        /// Bounding sphere of the mesh in model space: center, radius
+        glm::vec4 sphere;
+
+        /// Vertex buffer position -> model space: scale...
+        glm::vec4 positionScale;
+
+        /// ... and offset (see Mesh::GetPositionTransform())
+        glm::vec4 positionOffset;
+
+        /// Index count of each LOD
+        uint32_t lodCounts[4];
+
+        /// First index of each LOD, in indices from the start of the element buffer
+        uint32_t lodFirstIndices[4];
+
+        /// Which transform (RenderObject::GetTransformId())
+        uint32_t transformId;
+
+        /// Gets added to every index
+        int32_t baseVertex;
+
+        /// Number of LODs the mesh has
+        uint32_t numLODs;
+
+        /// Which bucket the record draws in
+        uint32_t bucket;
+
+        /// Where the bucket's commands start in the command buffer
+        uint32_t firstCommand;
+
+        /// std430 rounds the struct up to a multiple of a vec4
+        uint32_t padding[3];
+    };
+
+    /// One object's transform, as the shaders see it (std430)
+    struct ObjectTransform
+    {
+        /// Model matrix
+        glm::mat4 modelMat;
+
+        /// Normal matrix, padded out to a mat4
+        glm::mat4 normalMat;
+    };
+
+    /// Draws that go out in one multi-draw-indirect call
+    struct Bucket
+    {
+        /// A mesh of the bucket, to bind the textures & VAO of
+        Mesh* mesh;
+
+        /// GL type of the indices
+        unsigned int indexType;
+
+        /// Buckets with the same textures share a material id
+        unsigned int materialId;
+
+        /// Where the bucket's commands start in the command buffer
+        unsigned int firstCommand;
+
+        /// Room for commands the bucket has (one per record)
+        unsigned int numCommands;
+    };
+
+    /// The compute shader that culls the records & writes the commands
+    ShaderProgram mCullShaders;
+
+    /// Handle to the record count uniform of the cull shader
+    UniformHandle<int> mNumRecordsUniform;
+
+    /// Handles to the frustum plane uniforms of the cull shader
+    UniformHandle<glm::vec4> mFrustumPlaneUniforms[6];
+
+    /// Handle to the pixels-per-unit uniform of the cull shader
+    UniformHandle<float> mPixelsPerUnitUniform;
+
+    /// Handle to the LOD bias uniform of the cull shader
+    UniformHandle<float> mLODBiasUniform;
+
+    /// GL id of the shader storage buffer of DrawRecords
+    unsigned int mRecordBuffer;
+
+    /// GL id of the shader storage buffer of ObjectTransforms
+    unsigned int mTransformBuffer;
+
+    /// GL id of the indirect command buffer
+    unsigned int mCommandBuffer;
+
+    /// GL id of the buffer of each bucket's command count
+    unsigned int mCountBuffer;
+
+    /// GL id of the vertex buffer of draw ids (0, 1, 2, ...)
+    unsigned int mDrawIdBuffer;
+
+    /// Can we use glMultiDrawElementsIndirectCount? (GL 4.6)
+    bool mHasDrawCount;
+
+    /// The objects the records were built from
+    std::vector<RenderObject*> mObjects;
+
+    /// Every bucket, sorted by material
+    std::vector<Bucket> mBuckets;
+
+    /// Mesh buffers whose VAOs got the draw id attribute
+    std::vector<MeshBuffer*> mMeshBuffers;
+
+    /// Number of draw records (and slots in the command buffer)
+    unsigned int mNumRecords = 0;
+
+    /// CPU copy of the transform buffer, indexed by transform id
+    std::vector<ObjectTransform> mTransforms;
+
+    /// Object with each transform id (nullptr for ids not in the scene)
+    std::vector<RenderObject*> mTransformObjects;
+
+    /// What the last frame took
+    IndirectRendererStats mStats;
+
+    void Rebuild(const std::vector<RenderObject*>& objects);
+    void UploadTransforms();
+    void Cull(const FrameConstants& frame, int screenHeight, float lodBias);
+    void Draw(ShaderProgram& shaders);
+
+public:
+
+    IndirectRenderer();
+
+    /// Copy constructor (disabled)
+    IndirectRenderer(const IndirectRenderer &) = delete;
+
+    /// Assignment operator
+    void operator=(const IndirectRenderer &) = delete;
+
+    ~IndirectRenderer();
+
+    // ****************************************************************
+
+    void Render(const std::vector<RenderObject*>& objects, ShaderProgram& shaders,
+                const FrameConstants& frame, int screenHeight, float lodBias);
+
+    /**
+     * Get what the last Render call took
+     * @return the stats of the last frame
+     */
+    const IndirectRendererStats& GetStats() const { return mStats; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_INDIRECTRENDERER_H
@@ -0,0 +1,100 @@
+/**
+ * @file InstanceBuffer.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cstddef>
+#include <glad/glad.h>
+
+#include "InstanceBuffer.h"
+
+/// Instances the buffer has room for before it first has to grow
+const unsigned int INITIAL_INSTANCE_CAPACITY = 256;
+
+
+/**
+ * Constructor. Needs a current GL context!
+ */
+InstanceBuffer::InstanceBuffer()
+{
+    mCapacity = INITIAL_INSTANCE_CAPACITY;
+
+    glGenBuffers(1, &mVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+/**
+ * Destructor
+ */
+InstanceBuffer::~InstanceBuffer()
+{
+    glDeleteBuffers(1, &mVBO);
+}
+
+
+
+/**
+ * Replace the contents of the buffer with this frame's instances.
+ *
+ * The old storage is orphaned first, so the driver can hand us
+ * fresh memory instead of waiting for last frame's draws to
+ * finish reading it.
+ *
+ * @param instances every instance to draw this frame
+ */
+void InstanceBuffer::Upload(const std::vector<InstanceData> &instances)
+{
+    auto numInstances = (unsigned int)instances.size();
+    while (mCapacity < numInstances)
+        mCapacity *= 2;
+
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    if (numInstances > 0)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, numInstances * sizeof(InstanceData), instances.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+/**
+ * Point the per-instance attributes of the currently bound
+ * VAO at this buffer, starting from one instance.
+ *
+ * @param firstInstance index of the first instance the next draw should use
+ */
+void InstanceBuffer::BindAttributes(unsigned int firstInstance) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+
+    const GLsizei stride = sizeof(InstanceData);
+    const size_t base = firstInstance * sizeof(InstanceData);
+
+    // Model matrix, one column per attribute
+    for (unsigned int col = 0; col < 4; ++col)
+    {
+        unsigned int location = INSTANCE_ATTRIB_LOCATION + col;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, modelMat) + col * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+
+    // Normal matrix, same deal
+    for (unsigned int col = 0; col < 3; ++col)
+    {
+        unsigned int location = INSTANCE_ATTRIB_LOCATION + 4 + col;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, normalMat) + col * sizeof(glm::vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
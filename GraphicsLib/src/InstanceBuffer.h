@@ -0,0 +1,75 @@
+/**
+ * @file InstanceBuffer.h
+ * @author Elijah Gleckler
+ *
+ * A vertex buffer of per-instance transforms, so lots of
+ * copies of the same mesh can go out in one instanced draw.
+ *
+ * Every frame, the Scene writes the model & normal matrices
+ * of every visible object into one of these, grouped by mesh,
+ * and each mesh draws its group with glDrawElementsInstanced.
+ *
+ * The matrices show up in the vertex shader as attributes:
+ *
+ *  layout (location = 3) in mat4 aModelMat;  // takes 3, 4, 5, 6
+ *  layout (location = 7) in mat3 aNormalMat; // takes 7, 8, 9
+ *
+ * GL 3.3 has no base instance for draws, so instead of
+ * telling the draw where its group starts, BindAttributes
+ * points the attributes at the group's first instance.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_INSTANCEBUFFER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_INSTANCEBUFFER_H
+
+#include <vector>
+#include <glm.hpp>
+
+/// First attribute location of the per-instance data
+const unsigned int INSTANCE_ATTRIB_LOCATION = 3;
+
+/**
+ * Per-instance data, exactly as it's laid out in the buffer
+ */
+struct InstanceData
+{
+    /// Model matrix of the instance
+    glm::mat4 modelMat;
+
+    /// Normal matrix of the instance
+    glm::mat3 normalMat;
+};
+
+/**
+ * A vertex buffer of per-instance transforms
+ */
+class InstanceBuffer
+{
+private:
+
+    /// GL id of the vertex buffer
+    unsigned int mVBO;
+
+    /// How many instances the buffer has room for right now
+    unsigned int mCapacity = 0;
+
+public:
+
+    InstanceBuffer();
+
+    /// Copy constructor (disabled)
+    InstanceBuffer(const InstanceBuffer &) = delete;
+
+    /// Assignment operator
+    void operator=(const InstanceBuffer &) = delete;
+
+    ~InstanceBuffer();
+
+    // ****************************************************************
+
+    void Upload(const std::vector<InstanceData>& instances);
+    void BindAttributes(unsigned int firstInstance) const;
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_INSTANCEBUFFER_H
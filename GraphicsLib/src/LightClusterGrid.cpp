@@ -0,0 +1,325 @@
+/**
+ * @file LightClusterGrid.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <glad/glad.h>
+
+#include "LightClusterGrid.h"
+#include "ShaderProgram.h"
+
+/// Total number of clusters in the grid
+const unsigned int NUM_LIGHT_CLUSTERS = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+
+/// Light indices the GPU index buffer has room for before it first has to grow
+const unsigned int INITIAL_LIGHT_INDEX_CAPACITY = 4096;
+
+/// Uniform name of the (tiles per pixel x, y, depth slice scale, bias)
+/// vec4 the lighting shaders use to find a pixel's cluster
+const std::string CLUSTER_PARAMS_UNIFORM_NAME = "clusterParams";
+
+
+/**
+ * Constructor
+ *
+ * Makes the buffers & buffer textures for the cluster
+ * grid and the light index lists. Needs a current GL context!
+ */
+LightClusterGrid::LightClusterGrid()
+{
+    mClusterRanges.resize(NUM_LIGHT_CLUSTERS * 2, 0);
+
+    // The grid is always the same size
+    glGenBuffers(1, &mGridBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, mGridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, mClusterRanges.size() * sizeof(unsigned int),
+                 mClusterRanges.data(), GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &mGridTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, mGridTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, mGridBuffer);
+
+    // The index lists grow & shrink with how much the lights overlap
+    mIndexCapacity = INITIAL_LIGHT_INDEX_CAPACITY;
+    glGenBuffers(1, &mIndexBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, mIndexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, mIndexCapacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &mIndexTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, mIndexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, mIndexBuffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+
+/**
+ * Destructor
+ */
+LightClusterGrid::~LightClusterGrid()
+{
+    glDeleteTextures(1, &mGridTexture);
+    glDeleteTextures(1, &mIndexTexture);
+    glDeleteBuffers(1, &mGridBuffer);
+    glDeleteBuffers(1, &mIndexBuffer);
+}
+
+
+
+/**
+ * Work out the view space bounding box of every cluster.
+ *
+ * Only depends on the projection matrix, which rarely
+ * changes, so this is only redone when it does.
+ *
+ * Assumes a symmetric perspective projection like
+ * glm::perspective makes.
+ *
+ * @param projMat the projection matrix the scene is rendered with
+ */
+void LightClusterGrid::UpdateClusterBounds(const glm::mat4 &projMat)
+{
+    mBoundsProjMat = projMat;
+
+    // Pull the clip planes back out of the matrix
+    mNear = projMat[3][2] / (projMat[2][2] - 1.0f);
+    mFar = projMat[3][2] / (projMat[2][2] + 1.0f);
+
+    mClusterBounds.resize(NUM_LIGHT_CLUSTERS);
+
+    for (unsigned int z = 0; z < LIGHT_CLUSTERS_Z; ++z)
+    {
+        // Exponential slices, so clusters stay about as deep as they are wide
+        float d0 = mNear * std::pow(mFar / mNear, (float)z / LIGHT_CLUSTERS_Z);
+        float d1 = mNear * std::pow(mFar / mNear, (float)(z + 1) / LIGHT_CLUSTERS_Z);
+
+        for (unsigned int y = 0; y < LIGHT_CLUSTERS_Y; ++y)
+        {
+            float ndcY0 = -1.0f + 2.0f * y / LIGHT_CLUSTERS_Y;
+            float ndcY1 = -1.0f + 2.0f * (y + 1) / LIGHT_CLUSTERS_Y;
+
+            for (unsigned int x = 0; x < LIGHT_CLUSTERS_X; ++x)
+            {
+                float ndcX0 = -1.0f + 2.0f * x / LIGHT_CLUSTERS_X;
+                float ndcX1 = -1.0f + 2.0f * (x + 1) / LIGHT_CLUSTERS_X;
+
+                // The cluster is a little frustum; box in its 8 corners
+                ClusterBounds bounds;
+                bounds.min = glm::vec3(std::numeric_limits<float>::max());
+                bounds.max = glm::vec3(-std::numeric_limits<float>::max());
+                for (float d : {d0, d1})
+                {
+                    for (float ndcX : {ndcX0, ndcX1})
+                    {
+                        for (float ndcY : {ndcY0, ndcY1})
+                        {
+                            glm::vec3 corner(ndcX * d / projMat[0][0], ndcY * d / projMat[1][1], -d);
+                            bounds.min = glm::min(bounds.min, corner);
+                            bounds.max = glm::max(bounds.max, corner);
+                        }
+                    }
+                }
+
+                mClusterBounds[x + LIGHT_CLUSTERS_X * (y + LIGHT_CLUSTERS_Y * z)] = bounds;
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Sort the point lights into the clusters they reach and
+ * send the resulting lists to the GPU.
+ *
+ * Each light is first bounded conservatively--the depth slices
+ * its range spans and the screen rectangle its bounding box
+ * projects to--and then tested against the bounding box of each
+ * cluster in there, so the lists stay tight even for big lights.
+ *
+ * @param lights all the point lights, as packed in the scene's light buffer
+ * @param viewMat this frame's view matrix
+ * @param projMat this frame's projection matrix
+ */
+void LightClusterGrid::Build(const std::vector<PackedPointLight> &lights,
+                             const glm::mat4 &viewMat, const glm::mat4 &projMat)
+{
+    if (projMat != mBoundsProjMat)
+        UpdateClusterBounds(projMat);
+
+    // Depth -> slice is log(depth) * scale + bias
+    float sliceScale = LIGHT_CLUSTERS_Z / std::log(mFar / mNear);
+    float sliceBias = -sliceScale * std::log(mNear);
+    auto sliceOf = [&](float depth) {
+        int slice = (int)std::floor(std::log(depth) * sliceScale + sliceBias);
+        return std::clamp(slice, 0, (int)LIGHT_CLUSTERS_Z - 1);
+    };
+
+    // NDC -> tile index, clamped to the screen
+    auto tileOf = [](float ndc, unsigned int numTiles) {
+        ndc = std::clamp(ndc, -1.0f, 1.0f);
+        int tile = (int)std::floor((ndc + 1.0f) * 0.5f * numTiles);
+        return std::clamp(tile, 0, (int)numTiles - 1);
+    };
+
+    mPairs.clear();
+    std::fill(mClusterRanges.begin(), mClusterRanges.end(), 0);
+
+    for (unsigned int i = 0; i < lights.size(); ++i)
+    {
+        const PackedPointLight& light = lights[i];
+        float range = light.specularRange.w;
+        if (range <= 0.0f)
+            continue;
+
+        glm::vec3 center = glm::vec3(viewMat * glm::vec4(glm::vec3(light.positionConstant), 1.0f));
+        float depth = -center.z;
+
+        // Entirely in front of the near plane or past the far plane?
+        float minDepth = depth - range;
+        float maxDepth = depth + range;
+        if (maxDepth < mNear || minDepth > mFar)
+            continue;
+        minDepth = std::max(minDepth, mNear);
+        maxDepth = std::min(maxDepth, mFar);
+
+        // Screen rectangle of the light's bounding box. The extremes
+        // of x/depth over the box are always at its corners.
+        float minNdcX = std::numeric_limits<float>::max(), maxNdcX = -minNdcX;
+        float minNdcY = minNdcX, maxNdcY = maxNdcX;
+        for (float d : {minDepth, maxDepth})
+        {
+            for (float sign : {-1.0f, 1.0f})
+            {
+                float ndcX = projMat[0][0] * (center.x + sign * range) / d;
+                float ndcY = projMat[1][1] * (center.y + sign * range) / d;
+                minNdcX = std::min(minNdcX, ndcX);
+                maxNdcX = std::max(maxNdcX, ndcX);
+                minNdcY = std::min(minNdcY, ndcY);
+                maxNdcY = std::max(maxNdcY, ndcY);
+            }
+        }
+        if (maxNdcX < -1.0f || minNdcX > 1.0f || maxNdcY < -1.0f || minNdcY > 1.0f)
+            continue;
+
+        int x0 = tileOf(minNdcX, LIGHT_CLUSTERS_X), x1 = tileOf(maxNdcX, LIGHT_CLUSTERS_X);
+        int y0 = tileOf(minNdcY, LIGHT_CLUSTERS_Y), y1 = tileOf(maxNdcY, LIGHT_CLUSTERS_Y);
+        int z0 = sliceOf(minDepth), z1 = sliceOf(maxDepth);
+        float rangeSq = range * range;
+
+        for (int z = z0; z <= z1; ++z)
+        {
+            for (int y = y0; y <= y1; ++y)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    unsigned int cluster = x + LIGHT_CLUSTERS_X * (y + LIGHT_CLUSTERS_Y * z);
+
+                    // Sphere vs. the cluster's box
+                    const ClusterBounds& bounds = mClusterBounds[cluster];
+                    glm::vec3 closest = glm::clamp(center, bounds.min, bounds.max);
+                    glm::vec3 offset = closest - center;
+                    if (glm::dot(offset, offset) > rangeSq)
+                        continue;
+
+                    mPairs.push_back(cluster);
+                    mPairs.push_back(i);
+                    ++mClusterRanges[cluster * 2 + 1];
+                }
+            }
+        }
+    }
+
+    // Counting sort the pairs by cluster: counts -> offsets...
+    unsigned int offset = 0;
+    for (unsigned int c = 0; c < NUM_LIGHT_CLUSTERS; ++c)
+    {
+        mClusterRanges[c * 2] = offset;
+        offset += mClusterRanges[c * 2 + 1];
+        mClusterRanges[c * 2 + 1] = 0;
+    }
+
+    // ... then drop each light in its cluster's list
+    mLightIndices.resize(offset);
+    for (size_t p = 0; p < mPairs.size(); p += 2)
+    {
+        unsigned int cluster = mPairs[p];
+        unsigned int& count = mClusterRanges[cluster * 2 + 1];
+        mLightIndices[mClusterRanges[cluster * 2] + count] = mPairs[p + 1];
+        ++count;
+    }
+
+    Upload();
+}
+
+
+
+/**
+ * Send the cluster grid & light lists to the GPU
+ */
+void LightClusterGrid::Upload()
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, mGridBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, mClusterRanges.size() * sizeof(unsigned int),
+                    mClusterRanges.data());
+
+    glBindBuffer(GL_TEXTURE_BUFFER, mIndexBuffer);
+    auto numIndices = (unsigned int)mLightIndices.size();
+    if (numIndices > mIndexCapacity)
+    {
+        while (mIndexCapacity < numIndices)
+            mIndexCapacity *= 2;
+
+        glBufferData(GL_TEXTURE_BUFFER, mIndexCapacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (numIndices > 0)
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, numIndices * sizeof(unsigned int), mLightIndices.data());
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+
+/**
+ * Bind the cluster grid & light index buffer textures
+ *
+ * @param gridTexUnit texture unit for the cluster grid (0 for GL_TEXTURE0, etc.)
+ * @param indexTexUnit texture unit for the light index lists
+ */
+void LightClusterGrid::Bind(unsigned int gridTexUnit, unsigned int indexTexUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + gridTexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, mGridTexture);
+    glActiveTexture(GL_TEXTURE0 + indexTexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, mIndexTexture);
+}
+
+
+
+/**
+ * Tell the lighting shaders how to find the cluster of a pixel.
+ * Shadowed uniforms, so this costs nothing while the screen size
+ * and projection stay the same.
+ *
+ * @param shaders the (bound) lighting shaders
+ * @param screenWidth width of the screen in pixels
+ * @param screenHeight height of the screen in pixels
+ */
+void LightClusterGrid::SetUniforms(ShaderProgram &shaders, int screenWidth, int screenHeight) const
+{
+    float sliceScale = LIGHT_CLUSTERS_Z / std::log(mFar / mNear);
+    float params[4] = {
+        (float)LIGHT_CLUSTERS_X / screenWidth,
+        (float)LIGHT_CLUSTERS_Y / screenHeight,
+        sliceScale,
+        -sliceScale * std::log(mNear)
+    };
+    shaders.set4FUniform(CLUSTER_PARAMS_UNIFORM_NAME, params);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file LightClusterGrid.h
+ * @author Elijah Gleckler
+ *
+ * Clustered light culling for the deferred lighting pass.
+ *
+ * The view frustum is sliced into a 3D grid of "clusters":
+ * screen-space tiles in x & y, and slices in depth that get
+ * exponentially thicker further from the camera (so each
+ * cluster is roughly cube-shaped). Every frame, each point
+ * light is tested against the clusters its range could touch,
+ * and every cluster gets a list of the lights that reach it.
+ *
+ * The lighting pass then figures out which cluster a pixel is
+ * in and only shades the lights in that cluster's list, so the
+ * cost per pixel stays flat no matter how many lights are in
+ * the scene--only how many overlap.
+ *
+ * The lists go to the GPU as two texture buffers:
+ *  - the grid: one (offset, count) pair per cluster (RG32UI)
+ *  - the light indices, all clusters' lists end to end (R32UI)
+ *
+ * The grid size is baked into gbuf-light.frag as well, so
+ * the constants below must match the ones defined there!
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_LIGHTCLUSTERGRID_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_LIGHTCLUSTERGRID_H
+
+#include <vector>
+#include <glm.hpp>
+
+#include "lighting_structs.h"
+
+/// Number of cluster tiles across the screen (CLUSTER_GRID_X in the shader)
+const unsigned int LIGHT_CLUSTERS_X = 16;
+
+/// Number of cluster tiles down the screen (CLUSTER_GRID_Y in the shader)
+const unsigned int LIGHT_CLUSTERS_Y = 9;
+
+/// Number of depth slices (CLUSTER_GRID_Z in the shader)
+const unsigned int LIGHT_CLUSTERS_Z = 24;
+
+class ShaderProgram;
+/**
+ * Clustered light culling for the deferred lighting pass
+ */
+class LightClusterGrid
+{
+private:
+
+    /// View space bounding box of one cluster
+    struct ClusterBounds
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    /// Bounds of every cluster. Only depend on the projection
+    std::vector<ClusterBounds> mClusterBounds;
+
+    /// Projection matrix the cluster bounds were made for
+    glm::mat4 mBoundsProjMat = glm::mat4(0.0f);
+
+    /// Near plane distance, pulled out of the projection matrix
+    float mNear = 0.1f;
+
+    /// Far plane distance, pulled out of the projection matrix
+    float mFar = 100.0f;
+
+    /// (offset, count) into mLightIndices for each cluster
+    std::vector<unsigned int> mClusterRanges;
+
+    /// Every cluster's light list, end to end
+    std::vector<unsigned int> mLightIndices;
+
+    /// (cluster, light) pairs found while culling, before sorting
+    std::vector<unsigned int> mPairs;
+
+    /// GL id of the buffer with the cluster ranges
+    unsigned int mGridBuffer;
+
+    /// GL id of the buffer texture over the cluster ranges
+    unsigned int mGridTexture;
+
+    /// GL id of the buffer with the light indices
+    unsigned int mIndexBuffer;
+
+    /// GL id of the buffer texture over the light indices
+    unsigned int mIndexTexture;
+
+    /// How many indices the GPU index buffer has room for
+    unsigned int mIndexCapacity = 0;
+
+    void UpdateClusterBounds(const glm::mat4& projMat);
+    void Upload();
+
+public:
+
+    LightClusterGrid();
+
+    /// Copy constructor (disabled)
+    LightClusterGrid(const LightClusterGrid &) = delete;
+
+    /// Assignment operator
+    void operator=(const LightClusterGrid &) = delete;
+
+    ~LightClusterGrid();
+
+    // ****************************************************************
+
+    void Build(const std::vector<PackedPointLight>& lights,
+               const glm::mat4& viewMat, const glm::mat4& projMat);
+    void Bind(unsigned int gridTexUnit, unsigned int indexTexUnit) const;
+    void SetUniforms(ShaderProgram& shaders, int screenWidth, int screenHeight) const;
+
+    /**
+     * Get the total number of light entries over all clusters
+     * after the last Build. Handy to see how much lights overlap.
+     * @return number of light indices in all the cluster lists
+     */
+    unsigned int GetNumLightIndices() const { return (unsigned int)mLightIndices.size(); }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_LIGHTCLUSTERGRID_H
@@ -36,6 +36,15 @@ private:
      */
     PhongColors mPhongColors;
 
+    /// Has the light changed since whoever packs it last looked?
+    /// Starts out set, so a new light always gets packed once.
+    bool mDirty = true;
+
+protected:
+
+    /// Note that something about this light changed
+    void MarkDirty() { mDirty = true; }
+
 public:
 
     /**
@@ -70,7 +79,7 @@ public:
      * Get the Phong lighting colors for this light source
      * @return the Phong lighting colors for this light source
      */
-    PhongColors& GetPhongColors() { return mPhongColors; }
+    const PhongColors& GetPhongColors() const { return mPhongColors; }
 
     /**
      * Set the ambient color of this light source
@@ -79,6 +88,7 @@ public:
     void SetAmbientColor(const glm::vec3 &ambientColor)
     {
         mPhongColors.ambient = ambientColor;
+        mDirty = true;
     }
 
     /**
@@ -88,6 +98,7 @@ public:
     void SetDiffuseColor(const glm::vec3 &diffuseColor)
     {
         mPhongColors.diffuse = diffuseColor;
+        mDirty = true;
     }
 
     /**
@@ -97,8 +108,20 @@ public:
     void SetSpecularColor(const glm::vec3 &specularColor)
     {
         mPhongColors.specular = specularColor;
+        mDirty = true;
     }
 
+    /**
+     * Has this light changed since the last ClearDirty?
+     * Colors only change through the setters above, so
+     * this is how the scene knows which lights to re-pack.
+     * @return true if the light changed
+     */
+    bool IsDirty() const { return mDirty; }
+
+    /// Note that the light's current state has been packed
+    void ClearDirty() { mDirty = false; }
+
 };
 
 #endif //LEARNING_OPENGL__LIGHTSOURCE_H
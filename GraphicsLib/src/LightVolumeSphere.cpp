@@ -0,0 +1,116 @@
+/**
+ * @file LightVolumeSphere.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cmath>
+#include <vector>
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include "LightVolumeSphere.h"
+
+/// Number of rings of latitude, pole to pole
+const unsigned int LIGHT_VOLUME_STACKS = 8;
+
+/// Number of slices of longitude around the sphere
+const unsigned int LIGHT_VOLUME_SLICES = 12;
+
+
+/**
+ * Constructor.
+ * Builds the sphere and sets up the VAO, VBO, and EBO
+ */
+LightVolumeSphere::LightVolumeSphere()
+{
+    const float pi = 3.14159265358979f;
+
+    // Faces between vertices on the unit sphere dip inside it,
+    // by at most cos(half a step) in each direction. Scale the
+    // vertices out by that much, so the faces enclose it instead.
+    float enclose = 1.0f / (std::cos(pi / LIGHT_VOLUME_SLICES) *
+                            std::cos(pi / (2.0f * LIGHT_VOLUME_STACKS)));
+
+    std::vector<glm::vec3> vertices;
+    for (unsigned int stack = 0; stack <= LIGHT_VOLUME_STACKS; ++stack)
+    {
+        float phi = pi * stack / LIGHT_VOLUME_STACKS;
+        for (unsigned int slice = 0; slice <= LIGHT_VOLUME_SLICES; ++slice)
+        {
+            float theta = 2.0f * pi * slice / LIGHT_VOLUME_SLICES;
+            glm::vec3 pos(std::sin(phi) * std::cos(theta),
+                          std::cos(phi),
+                          std::sin(phi) * std::sin(theta));
+            vertices.push_back(pos * enclose);
+        }
+    }
+
+    // Two triangles per quad, wound counter-clockwise seen from outside
+    std::vector<unsigned int> indices;
+    const unsigned int ringSize = LIGHT_VOLUME_SLICES + 1;
+    for (unsigned int stack = 0; stack < LIGHT_VOLUME_STACKS; ++stack)
+    {
+        for (unsigned int slice = 0; slice < LIGHT_VOLUME_SLICES; ++slice)
+        {
+            unsigned int a = stack * ringSize + slice;
+            unsigned int b = a + ringSize;
+
+            indices.push_back(a);
+            indices.push_back(a + 1);
+            indices.push_back(b);
+
+            indices.push_back(a + 1);
+            indices.push_back(b + 1);
+            indices.push_back(b);
+        }
+    }
+    mNumIndices = (unsigned int)indices.size();
+
+    glGenVertexArrays(1, &mVAO);
+    glGenBuffers(1, &mVBO);
+    glGenBuffers(1, &mEBO);
+
+    glBindVertexArray(mVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+    // Unbind
+    glBindVertexArray(0);
+}
+
+
+
+/**
+ * Destructor
+ */
+LightVolumeSphere::~LightVolumeSphere()
+{
+    glDeleteVertexArrays(1, &mVAO);
+    glDeleteBuffers(1, &mVBO);
+    glDeleteBuffers(1, &mEBO);
+}
+
+
+
+/**
+ * Draw the sphere with whatever state & shaders are bound.
+ *
+ * The vertex shader should expect:
+ *
+ * layout (location = 0) in vec3 aPos;
+ *
+ */
+void LightVolumeSphere::Draw()
+{
+    glBindVertexArray(mVAO);
+    glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,56 @@
+/**
+ * @file LightVolumeSphere.h
+ * @author Elijah Gleckler
+ *
+ * A low-poly unit sphere to draw point light volumes with.
+ *
+ * Like FullscreenQuad, this is its own tiny class instead of
+ * a Mesh, since all it needs is positions and one draw call.
+ * The vertex shader scales it up to each light's range.
+ *
+ * The sphere is pushed out a little so that its flat faces
+ * enclose the true unit sphere--otherwise the edges of a
+ * light's range could get clipped between the vertices.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_LIGHTVOLUMESPHERE_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_LIGHTVOLUMESPHERE_H
+
+/**
+ * A low-poly unit sphere to draw point light volumes with
+ */
+class LightVolumeSphere
+{
+private:
+
+    /// OpenGL ID of the vertex attribute object for this mesh
+    unsigned int mVAO;
+
+    /// OpenGL ID of the vertex buffer object for this mesh
+    unsigned int mVBO;
+
+    /// OpenGL ID of the element buffer object for this mesh
+    unsigned int mEBO;
+
+    /// Number of indices to draw
+    unsigned int mNumIndices;
+
+public:
+
+    LightVolumeSphere();
+
+    /// Copy constructor (disabled)
+    LightVolumeSphere(const LightVolumeSphere &) = delete;
+
+    /// Assignment operator
+    void operator=(const LightVolumeSphere &) = delete;
+
+    ~LightVolumeSphere();
+
+    // ****************************************************************
+
+    void Draw();
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_LIGHTVOLUMESPHERE_H
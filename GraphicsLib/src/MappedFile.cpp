@@ -0,0 +1,104 @@
+/**
+ * @file MappedFile.cpp
+ * @author Elijah Gleckler
+ */
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+#include "MappedFile.h"
+
+
+/**
+ * Destructor. Unmaps the file, if one is open.
+ */
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+
+
+/**
+ * Open a file and get its bytes into memory.
+ * Closes whatever file was open before.
+ *
+ * @param filepath path to the file
+ * @return true if the file could be opened, false otherwise
+ */
+bool MappedFile::Open(const std::string &filepath)
+{
+    Close();
+
+#ifndef _WIN32
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    mData = static_cast<const unsigned char*>(data);
+    mSize = info.st_size;
+    mMapped = true;
+#else
+    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    std::streamsize size = file.tellg();
+    if (size <= 0)
+        return false;
+
+    mBuffer.resize(size);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(mBuffer.data()), size))
+    {
+        mBuffer.clear();
+        return false;
+    }
+
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+#endif
+
+    return true;
+}
+
+
+
+/**
+ * Let go of the file's bytes. Any pointers
+ * into the file are no good after this!
+ */
+void MappedFile::Close()
+{
+#ifndef _WIN32
+    if (mMapped)
+        munmap(const_cast<unsigned char*>(mData), mSize);
+#endif
+
+    mBuffer.clear();
+    mBuffer.shrink_to_fit();
+    mData = nullptr;
+    mSize = 0;
+    mMapped = false;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file MappedFile.h
+ * @author Elijah Gleckler
+ *
+ * A whole file, read-only, in memory.
+ *
+ * On POSIX systems the file is memory-mapped, so opening it
+ * is basically free and pages only get read in as they're
+ * touched. Elsewhere (Windows) it just gets read into a
+ * buffer in one go, which is still one big read instead of
+ * lots of little ones.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_MAPPEDFILE_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * A whole file, read-only, in memory
+ */
+class MappedFile
+{
+private:
+
+    /// Start of the file's bytes (nullptr if nothing's open)
+    const unsigned char* mData = nullptr;
+
+    /// Size of the file in bytes
+    size_t mSize = 0;
+
+    /// Did mData come from mmap (as opposed to mBuffer)?
+    bool mMapped = false;
+
+    /// The file's bytes, where there's no mmap
+    std::vector<unsigned char> mBuffer;
+
+public:
+
+    /// Default constructor
+    MappedFile() = default;
+
+    /// Copy constructor (disabled)
+    MappedFile(const MappedFile &) = delete;
+
+    /// Assignment operator
+    void operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    // ****************************************************************
+
+    bool Open(const std::string& filepath);
+    void Close();
+
+    /**
+     * Get the bytes of the file
+     * @return pointer to the start of the file, or nullptr if not open
+     */
+    const unsigned char* GetData() const { return mData; }
+
+    /**
+     * Get the size of the file
+     * @return size of the file in bytes
+     */
+    size_t GetSize() const { return mSize; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_MAPPEDFILE_H
@@ -3,61 +3,375 @@
  * @author Elijah Gleckler
  */
 
+#include <cmath>
+#include <map>
+#include <set>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/packing.hpp>
 #include "glad/glad.h"
 
 #include "Mesh.h"
 #include "Texture2D.h"
 #include "ShaderProgram.h"
+#include "InstanceBuffer.h"
+#include "TextureRegistry.h"
+#include "MeshBuffer.h"
+
+
+/**
+ * Pack vertices down for the GPU.
+ *
+ * Positions are stored relative to a bounding box (usually the
+ * model's), so the full 16 bits of each axis cover just that box
+ * (a 10m model gets ~0.15mm steps). Normals get 10 bits an axis, and texture
+ * coordinates become half floats.
+ *
+ * @param vertices the vertices to pack
+ * @param numVertices number of vertices
+ * @param bounds box to store the positions relative to (has to hold them all)
+ * @param positionTransform set to the matrix taking packed positions back to model space
+ * @return the packed vertices
+ */
+static std::vector<PackedVertex> PackVertices(const Vertex* vertices, unsigned int numVertices,
+                                              const AABB& bounds, glm::mat4& positionTransform)
+{
+    // Flat meshes (like a floor) have no extent along some axis;
+    // don't divide by zero there
+    glm::vec3 center = bounds.Center();
+    glm::vec3 extents = bounds.Extents();
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extents[axis] <= 0.0f)
+            extents[axis] = 1.0f;
+    }
+
+    positionTransform = glm::scale(glm::translate(glm::mat4(1.0f), center), extents);
+
+    std::vector<PackedVertex> packed(numVertices);
+    for (unsigned int i = 0; i < numVertices; ++i)
+    {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& out = packed[i];
+
+        glm::vec3 position = glm::clamp((vertex.position - center) / extents, -1.0f, 1.0f);
+        for (int axis = 0; axis < 3; ++axis)
+            out.position[axis] = (int16_t)std::lround(position[axis] * 32767.0f);
+        out.position[3] = 0;
+
+        out.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.0f));
+
+        out.texCoords[0] = glm::packHalf1x16(vertex.texCoords.x);
+        out.texCoords[1] = glm::packHalf1x16(vertex.texCoords.y);
+    }
+
+    return packed;
+}
+
+
+
+/**
+ * Small ids handed out & given back, so the ones in use stay
+ * small enough for their field of a sort key (see RenderQueue)
+ */
+struct IdPool
+{
+    /// Ids given back, ready to hand out again
+    std::set<unsigned int> freeIds;
+
+    /// First id never handed out
+    unsigned int nextId = 0;
+
+    /**
+     * Hand out the smallest id nobody has
+     * @return the id
+     */
+    unsigned int Take()
+    {
+        if (freeIds.empty())
+            return nextId++;
+
+        unsigned int id = *freeIds.begin();
+        freeIds.erase(freeIds.begin());
+        return id;
+    }
+
+    /**
+     * Give an id back
+     * @param id the id
+     */
+    void Give(unsigned int id) { freeIds.insert(id); }
+};
+
+/**
+ * Material ids (see Mesh::mMaterialId) of the sets of textures
+ * living meshes use
+ */
+struct MaterialIdPool
+{
+    /// One set of textures some living mesh uses
+    struct Material
+    {
+        unsigned int id;
+
+        /// Living meshes using it
+        unsigned int refCount;
+    };
+
+    /// Each set of textures in use: (GL id, type) pairs, in binding order
+    std::map<std::vector<unsigned int>, Material> materials;
+
+    /// Ids of the sets in use
+    IdPool ids;
+};
+
+
+
+/**
+ * Get the pool every mesh takes its sort id from
+ * @return the pool
+ */
+static IdPool& GetSortIdPool()
+{
+    static IdPool pool;
+    return pool;
+}
+
+
+
+/**
+ * Get the pool every mesh takes its material id from
+ * @return the pool
+ */
+static MaterialIdPool& GetMaterialIdPool()
+{
+    static MaterialIdPool pool;
+    return pool;
+}
+
+
+
+/**
+ * Get the key a set of textures is kept under
+ * @param textures the textures, in binding order
+ * @return their (GL id, type) pairs
+ */
+static std::vector<unsigned int> MaterialKey(const std::vector<TextureData>& textures)
+{
+    std::vector<unsigned int> key;
+    for (const TextureData& texture : textures)
+    {
+        key.push_back(texture.id);
+        key.push_back((unsigned int)texture.type);
+    }
+    return key;
+}
+
+
+
+/**
+ * Look up (or hand out) the id of a set of textures. Two sets get
+ * the same id when they bind the exact same textures to the exact
+ * same samplers. Every call needs a ReleaseMaterialId.
+ *
+ * @param textures the textures, in binding order
+ * @return the material id
+ */
+static unsigned int TakeMaterialId(const std::vector<TextureData>& textures)
+{
+    MaterialIdPool& pool = GetMaterialIdPool();
+    auto found = pool.materials.emplace(MaterialKey(textures), MaterialIdPool::Material{0, 0});
+    if (found.second)
+        found.first->second.id = pool.ids.Take();
+
+    found.first->second.refCount++;
+    return found.first->second.id;
+}
+
+
+
+/**
+ * Let go of a set of textures' material id. Once no living mesh
+ * uses the set, its id gets handed out again, and the set's
+ * forgotten--so a texture whose GL id gets reused later can't
+ * pick up a stale material id.
+ *
+ * @param textures the textures, in binding order
+ */
+static void ReleaseMaterialId(const std::vector<TextureData>& textures)
+{
+    MaterialIdPool& pool = GetMaterialIdPool();
+    auto found = pool.materials.find(MaterialKey(textures));
+    if (found == pool.materials.end() || --found->second.refCount > 0)
+        return;
+
+    pool.ids.Give(found->second.id);
+    pool.materials.erase(found);
+}
 
 /**
  * Constructor
  * @param vertices vector of vertices for this mesh
  * @param indices vector of vertex drawing order indices for this mesh
  * @param textures vector of textures for this mesh
+ * @param bounds bounding box of the vertices, in model space
+ * @param lods index ranges of the levels of detail (empty if it's just the one)
+ * @param parts index ranges & bounds of the meshes this one was batched from (if any)
+ * @param clusters small pieces of full detail, for culling (see ClusterCulling.h)
+ * @param packBounds box to pack positions relative to; meshes packed to the same
+ *                   box can share draws (empty to use the mesh's own bounds)
+ * @param layout how to lay the vertices out on the GPU
+ */
+Mesh::Mesh( const std::vector<Vertex>& vertices,
+            const std::vector<unsigned int>& indices,
+            std::vector<TextureData> textures,
+            const AABB& bounds,
+            std::vector<MeshLOD> lods,
+            std::vector<MeshPart> parts,
+            std::vector<MeshCluster> clusters,
+            const AABB& packBounds,
+            VertexLayout layout)
+            :
+            Mesh(vertices.data(), (unsigned int)vertices.size(),
+                 indices.data(), (unsigned int)indices.size(),
+                 std::move(textures), bounds, std::move(lods), std::move(parts),
+                 std::move(clusters), packBounds, layout)
+{
+}
+
+
+
+/**
+ * Constructor, straight from raw vertex & index data--like
+ * a mapped MeshCache. The data is uploaded to the GPU and
+ * not kept around, so it only has to live through this call.
+ *
+ * @param vertices pointer to the vertices for this mesh
+ * @param numVertices number of vertices
+ * @param indices pointer to the vertex drawing order indices for this mesh
+ * @param numIndices number of indices
+ * @param textures vector of textures for this mesh
+ * @param bounds bounding box of the vertices, in model space
+ * @param lods index ranges of the levels of detail (empty if it's just the one)
+ * @param parts index ranges & bounds of the meshes this one was batched from (if any)
+ * @param clusters small pieces of full detail, for culling (see ClusterCulling.h)
+ * @param packBounds box to pack positions relative to; meshes packed to the same
+ *                   box can share draws (empty to use the mesh's own bounds)
+ * @param layout how to lay the vertices out on the GPU
  */
-Mesh::Mesh( std::vector<Vertex> vertices,
-            std::vector<unsigned int> indices,
-            std::vector<TextureData> textures)
+Mesh::Mesh( const Vertex* vertices, unsigned int numVertices,
+            const unsigned int* indices, unsigned int numIndices,
+            std::vector<TextureData> textures,
+            const AABB& bounds,
+            std::vector<MeshLOD> lods,
+            std::vector<MeshPart> parts,
+            std::vector<MeshCluster> clusters,
+            const AABB& packBounds,
+            VertexLayout layout)
             :
-            mVertices(vertices),
-            mIndices(indices),
-            mTextures(textures)
+            mLODs(std::move(lods)),
+            mParts(std::move(parts)),
+            mClusters(std::move(clusters)),
+            mBuffer(&MeshBuffer::For(layout)),
+            mTextures(std::move(textures)),
+            mBounds(bounds),
+            mSortId(GetSortIdPool().Take()),
+            mMaterialId(TakeMaterialId(mTextures))
 {
+    if (mLODs.empty())
+        mLODs.push_back({0, numIndices});
+
+    // Work out which sampler uniform each texture goes to, now,
+    // instead of building the strings on every draw.
+    // LearnOpenGL's naming conventions... pg. 163
+    unsigned int diffuseNum = 1;
+    unsigned int specularNum = 1;
+    unsigned int roughnessNum = 1;
+    unsigned int normalNum = 1;
+
+    for (const TextureData& texture : mTextures)
+    {
+        // assuming we're going to the gbuf...
+        // check shaders/gbuf-geo.frag to see
+        std::string uniformName = "texture_";
+
+        // retrieve texture number (the N in diffuse_textureN)
+        if (texture.type == TextureType::Diffuse)
+            uniformName += "diffuse_" + std::to_string(diffuseNum++);
+        else if (texture.type == TextureType::Specular)
+            uniformName += "specular_" + std::to_string(specularNum++);
+        else if (texture.type == TextureType::Roughness)
+            uniformName += "roughness_" + std::to_string(roughnessNum++);
+        else if (texture.type == TextureType::Normal)
+            uniformName += "normal_" + std::to_string(normalNum++);
+
+        mSamplerNames.push_back(uniformName);
+    }
 
-    // Create buffers for our members
-    glGenVertexArrays(1, &mVAO);
-    glGenBuffers(1, &mVBO);
-    glGenBuffers(1, &mEBO);
+    // Lay the vertices out, plus the copies of them
+    // depth-only passes draw from (see MeshBuffer.h)...
+    std::vector<PackedVertex> packed;
+    std::vector<int16_t> packedPositions;
+    std::vector<glm::vec3> positions;
+    const void* vertexData = vertices;
+    const void* positionData;
+    if (layout == VertexLayout::Packed)
+    {
+        packed = PackVertices(vertices, numVertices, packBounds.IsEmpty() ? mBounds : packBounds,
+                              mPositionTransform);
+        vertexData = packed.data();
 
-    // Bind the VAO and then VBO, so we can set up the structure
-    glBindVertexArray(mVAO);
+        packedPositions.reserve(numVertices * 4);
+        for (const PackedVertex& vertex : packed)
+            packedPositions.insert(packedPositions.end(), vertex.position, vertex.position + 4);
+        positionData = packedPositions.data();
 
-    // Make space for the vertices
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STATIC_DRAW);
+        mGPUBytes += numVertices * (sizeof(PackedVertex) + sizeof(PackedVertex::position));
+    }
+    else
+    {
+        positions.reserve(numVertices);
+        for (unsigned int i = 0; i < numVertices; ++i)
+            positions.push_back(vertices[i].position);
+        positionData = positions.data();
 
-    // Make space for the drawing indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(unsigned int), &mIndices[0], GL_STATIC_DRAW);
+        mGPUBytes += numVertices * (sizeof(Vertex) + sizeof(glm::vec3));
+    }
 
-    //
-    // Vertex attribute pointers:
-    //
+    // ... make the indices 16 bits if they fit...
+    std::vector<uint16_t> shortIndices;
+    const void* indexData = indices;
+    unsigned int indexBytes = numIndices * sizeof(unsigned int);
+    mIndexType = GL_UNSIGNED_INT;
+    if (numVertices <= MAX_SHORT_INDEXED_VERTICES)
+    {
+        shortIndices.assign(indices, indices + numIndices);
+        indexData = shortIndices.data();
+        indexBytes = numIndices * sizeof(uint16_t);
+        mIndexType = GL_UNSIGNED_SHORT;
+    }
+    mGPUBytes += indexBytes;
 
-    // Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // ... and put them in with everyone else's
+    mAllocation = mBuffer->Allocate(vertexData, positionData, numVertices, indexData, indexBytes);
+}
 
-    // Normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
 
-    // Texture coordinates
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
 
-    // Unbind
-    glBindVertexArray(0);
+/**
+ * Destructor. Gives the mesh's space in its MeshBuffer back,
+ * lets go of the textures (see TextureRegistry), and gives
+ * back its sort & material ids.
+ */
+Mesh::~Mesh()
+{
+    // (Before the textures go, so their ids can't be reused yet)
+    ReleaseMaterialId(mTextures);
+    for (const TextureData& texture : mTextures)
+        TextureRegistry::Get().Release(texture.id);
+
+    GetSortIdPool().Give(mSortId);
+
+    mBuffer->Free(mAllocation);
 }
 
 
@@ -72,49 +386,20 @@ void Mesh::BindTextures(ShaderProgram &shaders)
 {
     // Set the texture uniforms in the shader
     // textures associated with materials?
-
-    // LearnOpenGL's naming conventions... pg. 163
-    unsigned int diffuseNum = 1;
-    unsigned int specularNum = 1;
-    unsigned int roughnessNum = 1;
-
     for (unsigned int i = 0; i < mTextures.size(); ++i)
     {
         // activate the texture unit
         glActiveTexture(GL_TEXTURE0 + i);
 
-        // We're going to get the data needed to set the shader uniform
-        // with the naming convention that LearnOpenGL came up with
-        TextureType type = mTextures[i].type;
-        std::string number;
-        std::string uniformName = "texture_"; // assuming we're going to the gbuf...
-                                              // check shaders/gbuf-geo.frag to see
-
-        // retrieve texture number (the N in diffuse_textureN)
-        if (type == TextureType::Diffuse)
-        {
-            number = std::to_string(diffuseNum++);
-            uniformName += "diffuse_" + number;
-        }
-        else if (type == TextureType::Specular)
-        {
-            number = std::to_string(specularNum++);
-            uniformName += "specular_" + number;
-        }
-        else if (type == TextureType::Roughness)
-        {
-            number = std::to_string(roughnessNum++);
-            uniformName += "roughness_" + number;
-        }
-
         // The value of the 2D sampler uniform should be the number
         // of the texture unit to which the texture was bound
-        shaders.set1FUniform(uniformName.c_str(), i);
+        // (samplers are ints--glUniform1f on them is a GL error!)
+        shaders.SetIntUniform(mSamplerNames[i], i);
 
         glBindTexture(GL_TEXTURE_2D, mTextures[i].id);
 
     }
-    glActiveTexture(0);
+    glActiveTexture(GL_TEXTURE0);
 
 
 
@@ -123,7 +408,9 @@ void Mesh::BindTextures(ShaderProgram &shaders)
 /**
  * Draw the mesh to the active framebuffer
  *
- * Binds the textures then calls glDrawElements
+ * Binds the textures then calls glDrawElements. With packed
+ * vertices, the model matrix uniform should already have
+ * GetPositionTransform() multiplied on.
  *
  * @param shaders Shader program to which to bind textures
  */
@@ -133,8 +420,118 @@ void Mesh::Draw(ShaderProgram &shaders)
     BindTextures(shaders);
 
     // draw the mesh!
-    glBindVertexArray(mVAO);
-    glDrawElements(GL_TRIANGLES, mIndices.size(), GL_UNSIGNED_INT, 0);
+    MeshDrawRange range = GetDrawRange(0);
+    glBindVertexArray(mBuffer->GetVertexArray());
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.count, range.indexType, range.indices, range.baseVertex);
     glBindVertexArray(0);
 }
 
+
+
+/**
+ * Bind this mesh's vertex array, so DrawInstanced can draw it.
+ * (Every mesh of the same vertex layout has the same one.)
+ */
+void Mesh::BindVertexArray()
+{
+    glBindVertexArray(mBuffer->GetVertexArray());
+}
+
+
+
+/**
+ * Get the vertex array this mesh draws with. Meshes with the
+ * same vertex array can be drawn without binding anything new.
+ * @return GL id of the VAO
+ */
+unsigned int Mesh::GetVertexArray() const
+{
+    return mBuffer->GetVertexArray();
+}
+
+
+
+/**
+ * Bind the vertex array depth-only passes draw this mesh with.
+ * Draw ranges are the same as with the full vertex array.
+ */
+void Mesh::BindDepthVertexArray()
+{
+    glBindVertexArray(GetDepthVertexArray());
+}
+
+
+
+/**
+ * Get the vertex array depth-only passes draw this mesh with:
+ * just positions (see MeshBuffer.h)
+ * @return GL id of the VAO
+ */
+unsigned int Mesh::GetDepthVertexArray() const
+{
+    return mBuffer->GetDepthVertexArray();
+}
+
+
+
+/**
+ * Get where a level of detail of this mesh is in its MeshBuffer
+ *
+ * @param lod level of detail (past the last one gets the last one)
+ * @return the arguments to draw the LOD with
+ */
+MeshDrawRange Mesh::GetDrawRange(unsigned int lod) const
+{
+    const MeshLOD& range = mLODs[lod < mLODs.size() ? lod : mLODs.size() - 1];
+    return GetIndexRange(range.firstIndex, range.numIndices);
+}
+
+
+
+/**
+ * Get the draw arguments for any range of this mesh's indices,
+ * like a part or a few clusters of full detail
+ *
+ * @param firstIndex first index of the range, from the start of the mesh's indices
+ * @param numIndices number of indices in the range
+ * @return the arguments to draw the range with
+ */
+MeshDrawRange Mesh::GetIndexRange(unsigned int firstIndex, unsigned int numIndices) const
+{
+    size_t indexSize = (mIndexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(unsigned int);
+
+    MeshDrawRange draw;
+    draw.count = (int)numIndices;
+    draw.indexType = mIndexType;
+    draw.indices = (const void*)(mAllocation.indexOffset + firstIndex * indexSize);
+    draw.baseVertex = (int)mAllocation.baseVertex;
+    return draw;
+}
+
+
+
+/**
+ * Draw many copies of the mesh at once, each with its
+ * own transform out of an instance buffer.
+ *
+ * Doesn't bind anything but the instance attributes: call
+ * BindTextures and BindVertexArray first (or let a RenderQueue
+ * do it, only when they actually change).
+ *
+ * The bound shaders should read the per-instance attributes
+ * described in InstanceBuffer.h instead of transform uniforms.
+ *
+ * @param instances buffer holding the instances' transforms
+ * @param firstInstance index of the first instance in the buffer to draw
+ * @param numInstances how many instances to draw
+ * @param range which of the mesh's indices to draw
+ *              (see GetDrawRange and GetIndexRange)
+ */
+void Mesh::DrawInstanced(const InstanceBuffer &instances,
+                         unsigned int firstInstance, unsigned int numInstances,
+                         const MeshDrawRange &range)
+{
+    instances.BindAttributes(firstInstance);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.count, range.indexType, range.indices,
+                                      numInstances, range.baseVertex);
+}
@@ -14,15 +14,36 @@
  *
  * https://www.reddit.com/r/opengl/comments/4jwj9n/single_mesh_multiple_materials/
  *
+ * On the GPU, vertices can be packed down to half their size
+ * (see VertexLayout), and meshes with few enough vertices
+ * use 16-bit indices.
+ *
+ * A mesh can have a few levels of detail (see MeshSimplifier.h),
+ * all drawing from the same vertices: each is its own range of
+ * the index buffer.
+ *
+ * A mesh batched together out of several (see MeshBatcher.h) also
+ * keeps the index range & bounds of each of its parts, so a part
+ * that's out of view can be left out of the full detail draw.
+ * Full detail is also cut into small clusters of triangles, which
+ * get culled one by one too (see ClusterCulling.h).
+ *
+ * Meshes don't have buffers of their own: their vertices & indices
+ * live in the MeshBuffer of their vertex layout, with everyone else's.
+ * That includes a position-only copy of the vertices, which depth-only
+ * passes can draw with instead (see GetDepthVertexArray).
  */
 
 #ifndef LEARNING_OPENGL__MESH_H
 #define LEARNING_OPENGL__MESH_H
 
+#include <cstdint>
 #include <glm.hpp>
 #include <vector>
 
 #include "Texture2D.h"
+#include "bounds.h"
+#include "MeshBuffer.h"
 
 
 struct Vertex
@@ -32,8 +53,127 @@ struct Vertex
     glm::vec2 texCoords;
 };
 
+/**
+ * A Vertex squeezed into 16 bytes, for the GPU
+ */
+struct PackedVertex
+{
+    /// Position within a bounding box (the mesh's, or its model's),
+    /// as normalized shorts in [-1, 1] (w is padding).
+    /// See Mesh::GetPositionTransform
+    int16_t position[4];
+
+    /// Normal, as GL_INT_2_10_10_10_REV (x in the low bits)
+    uint32_t normal;
+
+    /// Texture coordinates, as half floats
+    uint16_t texCoords[2];
+};
+
+/**
+ * How a Mesh lays its vertices out on the GPU
+ */
+enum class VertexLayout
+{
+    /// Vertex, as-is: 32 bytes of floats
+    Full,
+
+    /// PackedVertex: 16 bytes
+    Packed
+};
+
+/// Layout meshes get unless they ask for another
+const VertexLayout DEFAULT_VERTEX_LAYOUT = VertexLayout::Packed;
+
+/// Meshes with at most this many vertices get 16-bit indices
+const unsigned int MAX_SHORT_INDEXED_VERTICES = 65536;
+
+/// Most levels of detail a mesh can have, full detail included
+const unsigned int MAX_MESH_LODS = 4;
+
+/// Things smaller than this on screen (pixels across) don't get drawn at all
+const float LOD_CULL_PIXELS = 2.0f;
+
+/// Things at least this big on screen (pixels across) get full
+/// detail. Every time they shrink by half, they drop a level
+const float LOD_FULL_DETAIL_PIXELS = 512.0f;
+
+/**
+ * One level of detail of a mesh: a range of its indices
+ */
+struct MeshLOD
+{
+    /// First index of the LOD's triangles
+    unsigned int firstIndex;
+
+    /// Number of indices in the LOD
+    unsigned int numIndices;
+};
+
+/**
+ * One of the meshes a batched mesh was made from: a range of
+ * its full detail indices, and the box around their triangles
+ */
+struct MeshPart
+{
+    /// First index of the part's triangles
+    unsigned int firstIndex;
+
+    /// Number of indices in the part
+    unsigned int numIndices;
+
+    /// Bounding box of the part, in model space
+    AABB bounds;
+
+    /// First of the mesh's clusters that's in the part
+    unsigned int firstCluster;
+
+    /// Number of clusters in the part
+    unsigned int numClusters;
+};
+
+/**
+ * A few dozen of a mesh's full detail triangles, with what
+ * it takes to cull them on their own (see ClusterCulling.h)
+ */
+struct MeshCluster
+{
+    /// First index of the cluster's triangles
+    unsigned int firstIndex;
+
+    /// Number of indices in the cluster
+    unsigned int numIndices;
+
+    /// Bounding sphere, in model space: center, radius
+    glm::vec4 sphere;
+
+    /// Normal cone: the direction the triangles face around, and
+    /// the sine of the cone's half-angle (> 1 if it can't be culled)
+    glm::vec4 cone;
+};
+
+/**
+ * What it takes to draw one level of detail of a mesh out of
+ * its MeshBuffer: the arguments of a glDraw*BaseVertex call
+ */
+struct MeshDrawRange
+{
+    /// Number of indices to draw
+    int count;
+
+    /// GL type of the indices
+    unsigned int indexType;
+
+    /// Byte offset of the first index in the element buffer
+    const void* indices;
+
+    /// Gets added to every index
+    int baseVertex;
+};
+
 
 class ShaderProgram;
+class InstanceBuffer;
 /**
  * A mesh of vertices. Only one material!
  */
@@ -41,32 +181,74 @@ class Mesh
 {
 private:
 
-    /// Vertices of this mesh
-    std::vector<Vertex> mVertices;
+    /// Range of the mesh's indices each level of detail draws;
+    /// LOD 0 is full detail. The vertices & indices themselves
+    /// only live on the GPU, once they're uploaded
+    std::vector<MeshLOD> mLODs;
+
+    /// Index ranges & bounds of the meshes this one was batched
+    /// from (see MeshBatcher.h); empty if it wasn't
+    std::vector<MeshPart> mParts;
+
+    /// Clusters full detail is cut into, in index order
+    std::vector<MeshCluster> mClusters;
+
+    /// Shared buffers the mesh's vertices & indices are in
+    MeshBuffer* mBuffer;
 
-    /// Indices of the vertices so we can draw with EBO
-    std::vector<unsigned int> mIndices;
+    /// Where in mBuffer they are
+    MeshAllocation mAllocation;
+
+    /// GL type of the indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+    unsigned int mIndexType;
+
+    /// Takes the positions in the vertex buffer to model space
+    glm::mat4 mPositionTransform = glm::mat4(1.0f);
+
+    /// Bytes of vertices & indices the mesh takes on the GPU
+    unsigned int mGPUBytes = 0;
 
     /// Textures of this mesh
     std::vector<TextureData> mTextures;
 
-    /// OpenGL ID of the vertex attribute object for this mesh
-    unsigned int mVAO;
+    /// Name of the sampler uniform each texture binds to,
+    /// e.g. "texture_diffuse_1". Built once at construction.
+    std::vector<std::string> mSamplerNames;
 
-    /// OpenGL ID of the vertex buffer object for this mesh
-    unsigned int mVBO;
+    /// Bounding box of the vertices, in model space
+    AABB mBounds;
 
-    /// OpenGL ID of the element buffer object for this mesh
-    unsigned int mEBO;
+    /// Small id, unique among the meshes that are alive right now
+    /// (a destroyed mesh's id goes to the next one made)
+    unsigned int mSortId;
 
-    void BindTextures(ShaderProgram &shaders);
+    /// Id of the mesh's textures: meshes with the same one bind the
+    /// exact same textures to the exact same samplers. (Small, like
+    /// mSortId: the id goes back once no living mesh uses those textures)
+    unsigned int mMaterialId;
 
 public:
 
-    // Constructor
-    Mesh(   std::vector<Vertex> vertices,
-            std::vector<unsigned int> indices,
-            std::vector<TextureData> textures);
+    // Constructors
+    Mesh(   const std::vector<Vertex>& vertices,
+            const std::vector<unsigned int>& indices,
+            std::vector<TextureData> textures,
+            const AABB& bounds,
+            std::vector<MeshLOD> lods = {},
+            std::vector<MeshPart> parts = {},
+            std::vector<MeshCluster> clusters = {},
+            const AABB& packBounds = AABB(),
+            VertexLayout layout = DEFAULT_VERTEX_LAYOUT);
+
+    Mesh(   const Vertex* vertices, unsigned int numVertices,
+            const unsigned int* indices, unsigned int numIndices,
+            std::vector<TextureData> textures,
+            const AABB& bounds,
+            std::vector<MeshLOD> lods = {},
+            std::vector<MeshPart> parts = {},
+            std::vector<MeshCluster> clusters = {},
+            const AABB& packBounds = AABB(),
+            VertexLayout layout = DEFAULT_VERTEX_LAYOUT);
 
     /// Default constructor (disabled)
     Mesh() = delete;
@@ -77,8 +259,85 @@ public:
     /// Assignment operator
     void operator=(const Mesh &) = delete;
 
+    ~Mesh();
+
     void Draw(ShaderProgram &shaders);
 
+    // Pieces of Draw, for callers that bind state themselves (see RenderQueue)
+    void BindTextures(ShaderProgram &shaders);
+    void BindVertexArray();
+    unsigned int GetVertexArray() const;
+    void BindDepthVertexArray();
+    unsigned int GetDepthVertexArray() const;
+    MeshDrawRange GetDrawRange(unsigned int lod) const;
+    MeshDrawRange GetIndexRange(unsigned int firstIndex, unsigned int numIndices) const;
+    void DrawInstanced(const InstanceBuffer& instances,
+                       unsigned int firstInstance, unsigned int numInstances,
+                       const MeshDrawRange& range);
+
+    /**
+     * Get the textures of this mesh (its "material")
+     * @return the textures of this mesh
+     */
+    const std::vector<TextureData>& GetTextures() const { return mTextures; }
+
+    /**
+     * Get the bounding box of this mesh, in model space
+     * @return the bounding box of this mesh
+     */
+    const AABB& GetBounds() const { return mBounds; }
+
+    /**
+     * Get how many levels of detail this mesh has
+     * @return number of LODs, full detail included
+     */
+    unsigned int GetNumLODs() const { return (unsigned int)mLODs.size(); }
+
+    /**
+     * Get the parts this mesh was batched from (see MeshBatcher.h)
+     * @return the parts of this mesh; empty if it wasn't batched
+     */
+    const std::vector<MeshPart>& GetParts() const { return mParts; }
+
+    /**
+     * Get the clusters full detail is cut into (see ClusterCulling.h)
+     * @return the clusters of this mesh, in index order
+     */
+    const std::vector<MeshCluster>& GetClusters() const { return mClusters; }
+
+    /**
+     * Get the matrix taking the positions in the vertex buffer
+     * to model space. Packed positions are stored relative to a
+     * bounding box, so whoever makes the model matrix for a draw
+     * has to tack this on the right. (Identity for full vertices.)
+     * @return the matrix from vertex buffer positions to model space
+     */
+    const glm::mat4& GetPositionTransform() const { return mPositionTransform; }
+
+    /**
+     * Get the shared buffers the mesh's vertices & indices are in
+     * @return the mesh's MeshBuffer
+     */
+    MeshBuffer& GetMeshBuffer() const { return *mBuffer; }
+
+    /**
+     * Get how much GPU memory the vertices & indices take up
+     * @return bytes in the vertex & element buffers
+     */
+    unsigned int GetGPUBytes() const { return mGPUBytes; }
+
+    /**
+     * Get the mesh's small id (see mSortId), for sort keys
+     * @return the id, at most the number of meshes alive
+     */
+    unsigned int GetSortId() const { return mSortId; }
+
+    /**
+     * Get the id of the mesh's textures (see mMaterialId), for sort keys
+     * @return the material id
+     */
+    unsigned int GetMaterialId() const { return mMaterialId; }
+
 };
 
 #endif //LEARNING_OPENGL__MESH_H
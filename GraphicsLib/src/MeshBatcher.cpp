@@ -0,0 +1,100 @@
+/**
+ * @file MeshBatcher.cpp
+ * @author Elijah Gleckler
+ */
+
+#include "MeshBatcher.h"
+#include "MeshCache.h"
+
+
+/**
+ * Do two meshes use exactly the same textures, in the same order?
+ * (The order decides which sampler each one binds to.)
+ *
+ * @param a one mesh's textures
+ * @param b the other mesh's textures
+ * @return true if they're the same material
+ */
+static bool SameTextures(const std::vector<MaterialTexture>& a, const std::vector<MaterialTexture>& b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].type != b[i].type || a[i].filepath != b[i].filepath)
+            return false;
+    }
+    return true;
+}
+
+
+
+/**
+ * Stick a mesh on the end of a batch, as a new part
+ *
+ * @param batch the batch
+ * @param mesh the mesh to add to it
+ */
+static void AppendToBatch(MeshData& batch, const MeshData& mesh)
+{
+    auto baseVertex = (unsigned int)batch.vertices.size();
+
+    MeshPart part = {};
+    part.firstIndex = (unsigned int)batch.indices.size();
+    part.numIndices = (unsigned int)mesh.indices.size();
+    part.bounds = mesh.bounds;
+    batch.parts.push_back(part);
+
+    batch.vertices.insert(batch.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    for (unsigned int index : mesh.indices)
+        batch.indices.push_back(baseVertex + index);
+    batch.bounds.Expand(mesh.bounds);
+}
+
+
+
+/**
+ * Merge a model's meshes with the same textures into batches.
+ *
+ * Each mesh goes into the first batch of its material with room
+ * left for its vertices (see MeshBatcher.h), so batches come out
+ * in the order their materials first show up. Call before making
+ * LODs or optimizing: those work on the batches.
+ *
+ * @param meshes a model's meshes; replaced with the batches
+ */
+void BatchMeshesByMaterial(std::vector<MeshData> &meshes)
+{
+    std::vector<MeshData> batches;
+    for (const MeshData& mesh : meshes)
+    {
+        MeshData* batch = nullptr;
+        for (MeshData& candidate : batches)
+        {
+            if (SameTextures(candidate.textures, mesh.textures) &&
+                candidate.vertices.size() + mesh.vertices.size() <= MAX_SHORT_INDEXED_VERTICES)
+            {
+                batch = &candidate;
+                break;
+            }
+        }
+
+        if (batch == nullptr)
+        {
+            batches.emplace_back();
+            batch = &batches.back();
+            batch->textures = mesh.textures;
+        }
+        AppendToBatch(*batch, mesh);
+    }
+
+    // A batch of one is just the mesh
+    for (MeshData& batch : batches)
+    {
+        if (batch.parts.size() == 1)
+            batch.parts.clear();
+    }
+
+    meshes.swap(batches);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file MeshBatcher.h
+ * @author Elijah Gleckler
+ *
+ * Static batching at import time: merges a model's meshes that
+ * use the exact same textures into one mesh per material.
+ *
+ * Assimp hands back one mesh per (node, material) pair, so a level
+ * like Sponza comes in as hundreds of little meshes, most of them
+ * sharing a handful of materials. Their vertices & indices just get
+ * stuck end to end (node transforms are already baked into the
+ * vertices by Model::ProcessNode), so the whole material draws with
+ * one call.
+ *
+ * Each mesh that went into a batch is kept as a MeshPart: its range
+ * of the batch's indices and its bounding box. The Scene culls the
+ * parts of a batch in view on their own, and leaves the ones out of
+ * view out of the draw, so batching doesn't undo frustum culling.
+ *
+ * A batch stops growing at MAX_SHORT_INDEXED_VERTICES vertices, so
+ * it keeps its 16-bit indices. A material with more vertices than
+ * that gets a few batches, which a RenderQueue still merges into
+ * one multi-draw (they share an object, textures and vertex array).
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHBATCHER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHBATCHER_H
+
+#include <vector>
+
+struct MeshData;
+
+void BatchMeshesByMaterial(std::vector<MeshData>& meshes);
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHBATCHER_H
@@ -0,0 +1,330 @@
+/**
+ * @file MeshBuffer.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <memory>
+#include <glad/glad.h>
+
+#include "MeshBuffer.h"
+#include "Mesh.h"
+
+/// Vertices a mesh buffer has room for to start with
+const unsigned int MESH_BUFFER_INITIAL_VERTICES = 1 << 16;
+
+/// Bytes of indices a mesh buffer has room for to start with
+const unsigned int MESH_BUFFER_INITIAL_INDEX_BYTES = 1 << 20;
+
+/// Index ranges start on a multiple of this, so 32-bit indices are aligned
+const unsigned int MESH_BUFFER_INDEX_ALIGNMENT = 4;
+
+
+/**
+ * Make a buffer bigger, keeping what's in it.
+ * The copy happens on the GPU.
+ *
+ * @param buffer GL id of the buffer; set to the id of the new, bigger one
+ * @param oldSize bytes in the buffer now
+ * @param newSize bytes the buffer should have
+ */
+static void GrowBuffer(unsigned int& buffer, size_t oldSize, size_t newSize)
+{
+    unsigned int bigger;
+    glGenBuffers(1, &bigger);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newSize, nullptr, GL_STATIC_DRAW);
+
+    if (oldSize > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &buffer);
+    buffer = bigger;
+}
+
+
+
+/**
+ * Constructor. Needs a current GL context!
+ * @param layout how the buffer's vertices are laid out
+ */
+MeshBuffer::MeshBuffer(VertexLayout layout) : mLayout(layout)
+{
+    bool packed = (layout == VertexLayout::Packed);
+    mVertexSize = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    mPositionSize = packed ? sizeof(PackedVertex::position) : sizeof(glm::vec3);
+
+    glGenVertexArrays(1, &mVAO);
+    glGenVertexArrays(1, &mDepthVAO);
+    glGenBuffers(1, &mVBO);
+    glGenBuffers(1, &mPositionVBO);
+    glGenBuffers(1, &mEBO);
+
+    GrowBuffer(mVBO, 0, (size_t)MESH_BUFFER_INITIAL_VERTICES * mVertexSize);
+    GrowBuffer(mPositionVBO, 0, (size_t)MESH_BUFFER_INITIAL_VERTICES * mPositionSize);
+    GrowBuffer(mEBO, 0, MESH_BUFFER_INITIAL_INDEX_BYTES);
+    mVertices.Grow(MESH_BUFFER_INITIAL_VERTICES);
+    mIndices.Grow(MESH_BUFFER_INITIAL_INDEX_BYTES);
+
+    SetUpVertexArray();
+}
+
+
+
+/**
+ * Destructor
+ */
+MeshBuffer::~MeshBuffer()
+{
+    Release();
+}
+
+
+
+/**
+ * Delete the buffer's GL objects (if they're still there). The
+ * ranges stay, so meshes can still give theirs back afterwards.
+ */
+void MeshBuffer::Release()
+{
+    if (mVAO == 0)
+        return;
+
+    glDeleteVertexArrays(1, &mVAO);
+    glDeleteVertexArrays(1, &mDepthVAO);
+    glDeleteBuffers(1, &mVBO);
+    glDeleteBuffers(1, &mPositionVBO);
+    glDeleteBuffers(1, &mEBO);
+    mVAO = mDepthVAO = mVBO = mPositionVBO = mEBO = 0;
+}
+
+
+
+/**
+ * Get the mesh buffer of each vertex layout (null until it's made)
+ * @param layout the vertex layout
+ * @return where the layout's buffer is kept
+ */
+static std::unique_ptr<MeshBuffer>& BufferSlot(VertexLayout layout)
+{
+    static std::unique_ptr<MeshBuffer> full;
+    static std::unique_ptr<MeshBuffer> packed;
+    return layout == VertexLayout::Packed ? packed : full;
+}
+
+
+
+/**
+ * Get the buffer shared by all the meshes of a vertex layout.
+ * Made the first time it's asked for, so the first call for
+ * each layout has to be on the GL thread, with a context.
+ *
+ * @param layout the vertex layout
+ * @return the layout's mesh buffer
+ */
+MeshBuffer &MeshBuffer::For(VertexLayout layout)
+{
+    std::unique_ptr<MeshBuffer>& buffer = BufferSlot(layout);
+    if (buffer == nullptr)
+        buffer = std::make_unique<MeshBuffer>(layout);
+    return *buffer;
+}
+
+
+
+/**
+ * Delete the GL objects of every mesh buffer that got made,
+ * while the context is still around to delete them in.
+ * (The WindowManager does this, before it ends the context.)
+ */
+void MeshBuffer::ReleaseAll()
+{
+    for (VertexLayout layout : {VertexLayout::Full, VertexLayout::Packed})
+    {
+        std::unique_ptr<MeshBuffer>& buffer = BufferSlot(layout);
+        if (buffer != nullptr)
+            buffer->Release();
+    }
+}
+
+
+
+/**
+ * Point the VAOs at the buffers. Has to happen again whenever
+ * a buffer grows, since growing makes a new buffer object.
+ *
+ * Either layout, the shaders see the same vec3 position,
+ * vec3 normal & vec2 texture coordinates. The depth-only VAO
+ * just has the position, at the same location.
+ */
+void MeshBuffer::SetUpVertexArray()
+{
+    glBindVertexArray(mVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    if (mLayout == VertexLayout::Packed)
+    {
+        SetUpPositionAttribute(sizeof(PackedVertex));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, texCoords));
+    }
+    else
+    {
+        SetUpPositionAttribute(sizeof(Vertex));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+    }
+    SetUpDrawIdAttribute();
+
+    // (The element buffer binding is part of the VAO)
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+
+    // Depth-only: just the positions
+    glBindVertexArray(mDepthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mPositionVBO);
+    SetUpPositionAttribute(mPositionSize);
+    SetUpDrawIdAttribute();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+/**
+ * Point the bound VAO's position attribute at the start
+ * of each vertex in the bound vertex buffer
+ *
+ * @param stride bytes from one vertex to the next
+ */
+void MeshBuffer::SetUpPositionAttribute(unsigned int stride)
+{
+    glEnableVertexAttribArray(0);
+    if (mLayout == VertexLayout::Packed)
+    {
+        // Packed types have to be read as 4 components; the shader ignores the 4th
+        glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, (GLsizei)stride, (void*)0);
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)stride, (void*)0);
+    }
+}
+
+
+
+/**
+ * Give the bound VAO the draw id attribute, if there's a draw id
+ * buffer. (Leaves the draw id buffer bound to GL_ARRAY_BUFFER.)
+ */
+void MeshBuffer::SetUpDrawIdAttribute()
+{
+    if (mDrawIdBuffer == 0)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+    glEnableVertexAttribArray(DRAW_ID_ATTRIB_LOCATION);
+    glVertexAttribIPointer(DRAW_ID_ATTRIB_LOCATION, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glVertexAttribDivisor(DRAW_ID_ATTRIB_LOCATION, 1);
+}
+
+
+
+/**
+ * Put a mesh's vertices & indices in the buffers,
+ * growing them if there isn't room.
+ *
+ * @param vertices the vertices, already in the buffer's layout
+ * @param positions just their positions, in the position stream's layout
+ * @param numVertices number of vertices
+ * @param indices the indices (relative to the mesh's first vertex)
+ * @param indexBytes size of the indices, in bytes
+ * @return where the mesh ended up
+ */
+MeshAllocation MeshBuffer::Allocate(const void *vertices, const void *positions, unsigned int numVertices,
+                                    const void *indices, unsigned int indexBytes)
+{
+    MeshAllocation allocation;
+    allocation.numVertices = numVertices;
+    allocation.indexBytes = indexBytes;
+
+    // Out of room? Double until there is
+    bool grew = false;
+    while (!mVertices.Allocate(numVertices, 1, allocation.baseVertex))
+    {
+        unsigned int capacity = mVertices.GetCapacity();
+        GrowBuffer(mVBO, (size_t)capacity * mVertexSize, (size_t)capacity * 2 * mVertexSize);
+        GrowBuffer(mPositionVBO, (size_t)capacity * mPositionSize, (size_t)capacity * 2 * mPositionSize);
+        mVertices.Grow(capacity * 2);
+        grew = true;
+    }
+    while (!mIndices.Allocate(indexBytes, MESH_BUFFER_INDEX_ALIGNMENT, allocation.indexOffset))
+    {
+        unsigned int capacity = mIndices.GetCapacity();
+        GrowBuffer(mEBO, capacity, (size_t)capacity * 2);
+        mIndices.Grow(capacity * 2);
+        grew = true;
+    }
+    if (grew)
+        SetUpVertexArray();
+
+    // Upload through the copy target, so no VAO's
+    // element buffer binding gets changed by accident
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mVBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.baseVertex * mVertexSize,
+                    (GLsizeiptr)numVertices * mVertexSize, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mPositionVBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.baseVertex * mPositionSize,
+                    (GLsizeiptr)numVertices * mPositionSize, positions);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mEBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.indexOffset, indexBytes, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return allocation;
+}
+
+
+
+/**
+ * Give a mesh's ranges back, for other meshes to use
+ * @param allocation where the mesh is
+ */
+void MeshBuffer::Free(const MeshAllocation &allocation)
+{
+    mVertices.Free(allocation.baseVertex, allocation.numVertices);
+    mIndices.Free(allocation.indexOffset, allocation.indexBytes);
+}
+
+
+
+/**
+ * Give the VAOs a draw id attribute, read out of a buffer
+ * holding 0, 1, 2, ... (one unsigned int per draw)
+ *
+ * @param buffer GL id of the buffer (0 to take the attribute away)
+ */
+void MeshBuffer::SetDrawIdBuffer(unsigned int buffer)
+{
+    if (buffer == 0 && mDrawIdBuffer != 0)
+    {
+        for (unsigned int vao : {mVAO, mDepthVAO})
+        {
+            glBindVertexArray(vao);
+            glDisableVertexAttribArray(DRAW_ID_ATTRIB_LOCATION);
+        }
+        glBindVertexArray(0);
+    }
+
+    mDrawIdBuffer = buffer;
+    if (mDrawIdBuffer != 0)
+        SetUpVertexArray();
+}
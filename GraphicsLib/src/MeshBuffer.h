@@ -0,0 +1,158 @@
+/**
+ * @file MeshBuffer.h
+ * @author Elijah Gleckler
+ *
+ * One big vertex buffer & element buffer that all the meshes
+ * with the same vertex layout share.
+ *
+ * Each mesh gets a range of vertices and a range of indices
+ * out of the shared buffers (see FreeListAllocator), and draws
+ * with glDraw*BaseVertex, so its indices stay relative to its
+ * own first vertex. There's just one VAO per layout, so going
+ * from one mesh to the next doesn't change any vertex state at
+ * all, and draws of different meshes can go out together in one
+ * glMultiDrawElementsBaseVertex (see RenderQueue).
+ *
+ * Next to the interleaved vertices there's a position-only copy of
+ * them, tightly packed, with a VAO of its own for depth-only passes,
+ * which don't need normals or texture coordinates (8 bytes a vertex
+ * instead of 16 packed, 12 instead of 32 full). It's numbered the
+ * same as the main vertex buffer, and shares its element buffer, so
+ * a mesh draws the same ranges from either VAO.
+ *
+ * The buffers start out small and double when they run out of
+ * room; what's in them gets copied over on the GPU.
+ *
+ * Each layout's buffer is only made once a mesh of that layout
+ * needs it, and its GL objects go when the WindowManager lets go
+ * of the context (see ReleaseAll), not at exit, when the context
+ * is already gone. Meshes freed after that just give their ranges
+ * back; there's nothing left on the GPU to touch.
+ *
+ * For indirect draws (see IndirectRenderer), the VAO can also get a
+ * per-instance "draw id" attribute, read from a buffer of 0, 1, 2, ...
+ * Instanced attributes start at a draw's base instance, so a draw
+ * whose base instance is N sees draw id N.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHBUFFER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHBUFFER_H
+
+#include <cstddef>
+
+#include "FreeListAllocator.h"
+
+enum class VertexLayout;
+
+/// Attribute location of the draw id (after the InstanceBuffer's 3-9)
+const unsigned int DRAW_ID_ATTRIB_LOCATION = 10;
+
+/**
+ * Where a mesh's vertices & indices are in a MeshBuffer
+ */
+struct MeshAllocation
+{
+    /// First vertex of the mesh (gets added to every index)
+    unsigned int baseVertex = 0;
+
+    /// Number of vertices
+    unsigned int numVertices = 0;
+
+    /// Byte offset of the mesh's indices in the element buffer
+    unsigned int indexOffset = 0;
+
+    /// Size of the indices, in bytes
+    unsigned int indexBytes = 0;
+};
+
+/**
+ * Vertex & element buffers shared by all meshes of one vertex layout
+ */
+class MeshBuffer
+{
+private:
+
+    /// How the vertices are laid out
+    VertexLayout mLayout;
+
+    /// Size of one vertex, in bytes
+    unsigned int mVertexSize;
+
+    /// GL id of the vertex array object, set up for mLayout
+    unsigned int mVAO;
+
+    /// GL id of the vertex buffer
+    unsigned int mVBO;
+
+    /// Size of one vertex of the position stream, in bytes
+    unsigned int mPositionSize;
+
+    /// GL id of the depth-only vertex array object (positions only)
+    unsigned int mDepthVAO;
+
+    /// GL id of the position stream's vertex buffer
+    unsigned int mPositionVBO;
+
+    /// GL id of the element buffer
+    unsigned int mEBO;
+
+    /// Ranges of the vertex buffers, in vertices
+    FreeListAllocator mVertices;
+
+    /// Ranges of the element buffer, in bytes
+    FreeListAllocator mIndices;
+
+    /// GL id of the buffer the draw id attribute reads from (0 for none)
+    unsigned int mDrawIdBuffer = 0;
+
+    void SetUpVertexArray();
+    void SetUpPositionAttribute(unsigned int stride);
+    void SetUpDrawIdAttribute();
+    void Release();
+
+public:
+
+    explicit MeshBuffer(VertexLayout layout);
+
+    /// Copy constructor (disabled)
+    MeshBuffer(const MeshBuffer &) = delete;
+
+    /// Assignment operator
+    void operator=(const MeshBuffer &) = delete;
+
+    ~MeshBuffer();
+
+    // ****************************************************************
+
+    static MeshBuffer& For(VertexLayout layout);
+    static void ReleaseAll();
+
+    MeshAllocation Allocate(const void* vertices, const void* positions, unsigned int numVertices,
+                            const void* indices, unsigned int indexBytes);
+    void Free(const MeshAllocation& allocation);
+    void SetDrawIdBuffer(unsigned int buffer);
+
+    /**
+     * Get the vertex array to draw the buffer's meshes with
+     * @return GL id of the VAO
+     */
+    unsigned int GetVertexArray() const { return mVAO; }
+
+    /**
+     * Get the vertex array for depth-only passes (just positions)
+     * @return GL id of the VAO
+     */
+    unsigned int GetDepthVertexArray() const { return mDepthVAO; }
+
+    /**
+     * Get how much of the buffers the meshes take up
+     * @return bytes of vertices & indices in use
+     */
+    size_t GetBytesUsed() const
+    {
+        return (size_t)mVertices.GetUsed() * (mVertexSize + mPositionSize) + mIndices.GetUsed();
+    }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHBUFFER_H
@@ -0,0 +1,428 @@
+/**
+ * @file MeshCache.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "MeshCache.h"
+#include "FileStamp.h"
+
+/// First four bytes of every mesh cache file
+const char MESH_CACHE_MAGIC[4] = {'M', 'R', 'M', 'C'};
+
+/// Start of a cache file
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t numMeshes;
+
+    /// Stamp of the .obj the cache was made from
+    FileStamp source;
+
+    /// Number of other files the import read (see DependencyRecord)
+    uint32_t numDependencies;
+};
+
+/// Another file the import read, like the .obj's .mtl; its path follows it
+struct DependencyRecord
+{
+    /// Stamp of the file when the cache was made
+    FileStamp stamp;
+
+    uint32_t pathLength;
+};
+
+/// Start of one mesh in a cache file
+struct MeshRecord
+{
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t numTextures;
+    uint32_t numLODs;
+    uint32_t numParts;
+    uint32_t numClusters;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+/// One part of a batched mesh in a cache file (see MeshPart)
+struct PartRecord
+{
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t firstCluster;
+    uint32_t numClusters;
+};
+
+/// One cluster of a mesh in a cache file (see MeshCluster)
+struct ClusterRecord
+{
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    float sphere[4];
+    float cone[4];
+};
+
+/// One texture of a mesh in a cache file; its path follows it
+struct TextureRecord
+{
+    uint32_t type;
+    uint32_t pathLength;
+};
+
+
+/**
+ * Round a size up to the next multiple of 4
+ * @param size size in bytes
+ * @return the size, padded to 4 bytes
+ */
+static size_t Pad4(size_t size)
+{
+    return (size + 3) & ~size_t(3);
+}
+
+
+
+/**
+ * Open a cache file, if it's up-to-date with its source.
+ *
+ * The cache is fresh if its source, and every other file the
+ * import read, still match the stamps the cache was made with
+ * (see FileStamp.h).
+ *
+ * @param cachePath path to the cache file
+ * @param sourcePath path to the .obj the cache was made from
+ * @return true if the cache is fresh and its meshes are ready to use
+ */
+bool MeshCache::Open(const std::string &cachePath, const std::string &sourcePath)
+{
+    mMeshes.clear();
+    if (!mFile.Open(cachePath) || mFile.GetSize() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, mFile.GetData(), sizeof(header));
+    if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MESH_CACHE_VERSION ||
+        header.vertexSize != sizeof(Vertex))
+    {
+        mFile.Close();
+        return false;
+    }
+
+    size_t offset = sizeof(Header);
+    if (!header.source.Matches(sourcePath) || !DependenciesMatch(header.numDependencies, offset))
+    {
+        mFile.Close();
+        return false;
+    }
+
+    if (!Parse(offset))
+    {
+        std::cout
+            << "****************************************************************" << std::endl
+            << "WARNING::MESH_CACHE::Corrupt cache file, ignoring it: " << cachePath << std::endl
+            << "****************************************************************" << std::endl;
+        mMeshes.clear();
+        mFile.Close();
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/**
+ * Check the other files the import read against their stamps in
+ * the mapped file. (A truncated list counts as not matching.)
+ *
+ * @param numDependencies how many files the header says there are
+ * @param offset where the list starts; moved past it
+ * @return true if every file still matches its stamp
+ */
+bool MeshCache::DependenciesMatch(uint32_t numDependencies, size_t &offset) const
+{
+    const unsigned char* data = mFile.GetData();
+    size_t size = mFile.GetSize();
+
+    for (uint32_t i = 0; i < numDependencies; ++i)
+    {
+        if (offset + sizeof(DependencyRecord) > size)
+            return false;
+
+        DependencyRecord record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(DependencyRecord);
+
+        if (offset + record.pathLength > size)
+            return false;
+
+        std::string path(reinterpret_cast<const char*>(data + offset), record.pathLength);
+        offset += Pad4(record.pathLength);
+        if (!record.stamp.Matches(path))
+            return false;
+    }
+
+    return true;
+}
+
+
+
+/**
+ * Walk the mapped file and make a MeshView for each mesh.
+ * Checks every size against the end of the file, so a
+ * truncated cache is rejected instead of read past, and
+ * every index against its mesh's vertex count, so a bad one
+ * can't draw some other mesh's vertices out of the MeshBuffer.
+ *
+ * @param offset where the first mesh starts
+ * @return true if the whole file made sense
+ */
+bool MeshCache::Parse(size_t offset)
+{
+    const unsigned char* data = mFile.GetData();
+    size_t size = mFile.GetSize();
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+
+    for (uint32_t i = 0; i < header.numMeshes; ++i)
+    {
+        if (offset + sizeof(MeshRecord) > size)
+            return false;
+
+        MeshRecord record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(MeshRecord);
+
+        MeshView mesh;
+        mesh.numVertices = record.numVertices;
+        mesh.numIndices = record.numIndices;
+        mesh.bounds.min = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+        mesh.bounds.max = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+
+        for (uint32_t t = 0; t < record.numTextures; ++t)
+        {
+            if (offset + sizeof(TextureRecord) > size)
+                return false;
+
+            TextureRecord texRecord;
+            std::memcpy(&texRecord, data + offset, sizeof(texRecord));
+            offset += sizeof(TextureRecord);
+
+            if (offset + texRecord.pathLength > size)
+                return false;
+
+            MaterialTexture texture;
+            texture.type = (TextureType)texRecord.type;
+            texture.filepath.assign(reinterpret_cast<const char*>(data + offset), texRecord.pathLength);
+            mesh.textures.push_back(texture);
+            offset += Pad4(texRecord.pathLength);
+        }
+
+        size_t lodBytes = (size_t)record.numLODs * sizeof(MeshLOD);
+        if (offset + lodBytes > size)
+            return false;
+        mesh.lods.resize(record.numLODs);
+        std::memcpy(mesh.lods.data(), data + offset, lodBytes);
+        offset += lodBytes;
+        for (const MeshLOD& lod : mesh.lods)
+        {
+            if ((size_t)lod.firstIndex + lod.numIndices > record.numIndices)
+                return false;
+        }
+
+        for (uint32_t p = 0; p < record.numParts; ++p)
+        {
+            if (offset + sizeof(PartRecord) > size)
+                return false;
+
+            PartRecord partRecord;
+            std::memcpy(&partRecord, data + offset, sizeof(partRecord));
+            offset += sizeof(PartRecord);
+            if ((size_t)partRecord.firstIndex + partRecord.numIndices > record.numIndices ||
+                (size_t)partRecord.firstCluster + partRecord.numClusters > record.numClusters)
+                return false;
+
+            MeshPart part;
+            part.firstIndex = partRecord.firstIndex;
+            part.numIndices = partRecord.numIndices;
+            part.bounds.min = glm::vec3(partRecord.boundsMin[0], partRecord.boundsMin[1], partRecord.boundsMin[2]);
+            part.bounds.max = glm::vec3(partRecord.boundsMax[0], partRecord.boundsMax[1], partRecord.boundsMax[2]);
+            part.firstCluster = partRecord.firstCluster;
+            part.numClusters = partRecord.numClusters;
+            mesh.parts.push_back(part);
+        }
+
+        for (uint32_t c = 0; c < record.numClusters; ++c)
+        {
+            if (offset + sizeof(ClusterRecord) > size)
+                return false;
+
+            ClusterRecord clusterRecord;
+            std::memcpy(&clusterRecord, data + offset, sizeof(clusterRecord));
+            offset += sizeof(ClusterRecord);
+            if ((size_t)clusterRecord.firstIndex + clusterRecord.numIndices > record.numIndices)
+                return false;
+
+            MeshCluster cluster;
+            cluster.firstIndex = clusterRecord.firstIndex;
+            cluster.numIndices = clusterRecord.numIndices;
+            cluster.sphere = glm::vec4(clusterRecord.sphere[0], clusterRecord.sphere[1],
+                                       clusterRecord.sphere[2], clusterRecord.sphere[3]);
+            cluster.cone = glm::vec4(clusterRecord.cone[0], clusterRecord.cone[1],
+                                     clusterRecord.cone[2], clusterRecord.cone[3]);
+            mesh.clusters.push_back(cluster);
+        }
+
+        size_t vertexBytes = (size_t)record.numVertices * sizeof(Vertex);
+        size_t indexBytes = (size_t)record.numIndices * sizeof(unsigned int);
+        if (offset + vertexBytes + indexBytes > size)
+            return false;
+
+        // Everything's 4-byte aligned, and Vertex is all floats,
+        // so these can point right into the file
+        mesh.vertices = reinterpret_cast<const Vertex*>(data + offset);
+        offset += vertexBytes;
+        mesh.indices = reinterpret_cast<const unsigned int*>(data + offset);
+        offset += indexBytes;
+        for (uint32_t n = 0; n < record.numIndices; ++n)
+        {
+            if (mesh.indices[n] >= record.numVertices)
+                return false;
+        }
+
+        mMeshes.push_back(std::move(mesh));
+    }
+
+    return true;
+}
+
+
+
+/**
+ * Write out a cache file for a model's meshes.
+ *
+ * Writes to a temporary file first and renames it into place,
+ * so a crash halfway through never leaves a broken cache behind.
+ *
+ * @param cachePath path to write the cache file to
+ * @param sourcePath path to the .obj the meshes came from
+ * @param dependencies every other file the import read (like the .mtl)
+ * @param meshes the model's meshes
+ * @return true if the cache got written
+ */
+bool MeshCache::Write(const std::string &cachePath, const std::string &sourcePath,
+                      const std::vector<std::string> &dependencies,
+                      const std::vector<MeshData> &meshes)
+{
+    Header header = {};
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.numMeshes = (uint32_t)meshes.size();
+    header.numDependencies = (uint32_t)dependencies.size();
+    if (!FileStamp::Read(sourcePath, header.source))
+        return false;
+
+    std::vector<DependencyRecord> dependencyRecords(dependencies.size());
+    for (size_t i = 0; i < dependencies.size(); ++i)
+    {
+        dependencyRecords[i].pathLength = (uint32_t)dependencies[i].size();
+        if (!FileStamp::Read(dependencies[i], dependencyRecords[i].stamp))
+            return false;
+    }
+
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    const char padding[4] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < dependencies.size(); ++i)
+    {
+        file.write(reinterpret_cast<const char*>(&dependencyRecords[i]), sizeof(DependencyRecord));
+        file.write(dependencies[i].data(), dependencies[i].size());
+        file.write(padding, Pad4(dependencies[i].size()) - dependencies[i].size());
+    }
+    for (const MeshData& mesh : meshes)
+    {
+        MeshRecord record = {};
+        record.numVertices = (uint32_t)mesh.vertices.size();
+        record.numIndices = (uint32_t)mesh.indices.size();
+        record.numTextures = (uint32_t)mesh.textures.size();
+        record.numLODs = (uint32_t)mesh.lods.size();
+        record.numParts = (uint32_t)mesh.parts.size();
+        record.numClusters = (uint32_t)mesh.clusters.size();
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            record.boundsMin[axis] = mesh.bounds.min[axis];
+            record.boundsMax[axis] = mesh.bounds.max[axis];
+        }
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+        for (const MaterialTexture& texture : mesh.textures)
+        {
+            TextureRecord texRecord;
+            texRecord.type = (uint32_t)texture.type;
+            texRecord.pathLength = (uint32_t)texture.filepath.size();
+            file.write(reinterpret_cast<const char*>(&texRecord), sizeof(texRecord));
+            file.write(texture.filepath.data(), texture.filepath.size());
+            file.write(padding, Pad4(texture.filepath.size()) - texture.filepath.size());
+        }
+
+        file.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLOD));
+
+        for (const MeshPart& part : mesh.parts)
+        {
+            PartRecord partRecord;
+            partRecord.firstIndex = part.firstIndex;
+            partRecord.numIndices = part.numIndices;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                partRecord.boundsMin[axis] = part.bounds.min[axis];
+                partRecord.boundsMax[axis] = part.bounds.max[axis];
+            }
+            partRecord.firstCluster = part.firstCluster;
+            partRecord.numClusters = part.numClusters;
+            file.write(reinterpret_cast<const char*>(&partRecord), sizeof(partRecord));
+        }
+
+        for (const MeshCluster& cluster : mesh.clusters)
+        {
+            ClusterRecord clusterRecord;
+            clusterRecord.firstIndex = cluster.firstIndex;
+            clusterRecord.numIndices = cluster.numIndices;
+            for (int i = 0; i < 4; ++i)
+            {
+                clusterRecord.sphere[i] = cluster.sphere[i];
+                clusterRecord.cone[i] = cluster.cone[i];
+            }
+            file.write(reinterpret_cast<const char*>(&clusterRecord), sizeof(clusterRecord));
+        }
+
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+    }
+
+    file.close();
+    if (!file)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // (rename won't replace an existing file on Windows)
+    std::remove(cachePath.c_str());
+    return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
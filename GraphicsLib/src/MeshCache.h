@@ -0,0 +1,145 @@
+/**
+ * @file MeshCache.h
+ * @author Elijah Gleckler
+ *
+ * Binary cache of a model's meshes, so Assimp only has
+ * to parse a model's .obj file the first time it's loaded.
+ *
+ * The cache sits next to the .obj (<name>.meshcache) and holds
+ * every mesh's vertices & indices (already run through the
+ * MeshOptimizer), plus the paths of its textures and its bounding
+ * box. Loading it is one mmap, and the vertex & index data get
+ * handed straight to the Mesh, no per-vertex parsing at all.
+ *
+ * The cache remembers the size, modification time and hash of the
+ * .obj it came from, and of every other file Assimp read to import
+ * it (like the .mtl with the materials & texture paths). If any of
+ * them changes (or MESH_CACHE_VERSION gets bumped because the format
+ * changed) the cache is stale, and the model is loaded through Assimp
+ * again, which rewrites the cache.
+ *
+ * Layout (everything 4-byte aligned, native endianness--the cache
+ * isn't meant to be shared between machines):
+ *
+ *   Header
+ *   for each other file read: DependencyRecord, path chars (padded to 4)
+ *   for each mesh:
+ *       MeshRecord
+ *       for each texture: TextureRecord, path chars (padded to 4)
+ *       MeshLOD[numLODs]
+ *       PartRecord[numParts]
+ *       ClusterRecord[numClusters]
+ *       Vertex[numVertices]
+ *       uint32[numIndices]
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHCACHE_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "MappedFile.h"
+
+/// Bump whenever the layout of a cache file (or of Vertex), or
+/// what's done to the meshes before they're cached, changes
+const uint32_t MESH_CACHE_VERSION = 11;
+
+/**
+ * A texture a mesh wants, before it gets loaded
+ */
+struct MaterialTexture
+{
+    /// What the texture is for
+    TextureType type;
+
+    /// Path to the image, relative to the model's directory
+    std::string filepath;
+};
+
+/**
+ * Everything needed to make a Mesh, on the CPU.
+ * What a model import produces, and what gets cached.
+ */
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MaterialTexture> textures;
+    AABB bounds;
+
+    /// Index ranges of the levels of detail (see MeshSimplifier.h)
+    std::vector<MeshLOD> lods;
+
+    /// Meshes this one was batched from (see MeshBatcher.h)
+    std::vector<MeshPart> parts;
+
+    /// Clusters full detail is cut into (see ClusterCulling.h)
+    std::vector<MeshCluster> clusters;
+};
+
+/**
+ * A read-only, memory-mapped mesh cache file
+ */
+class MeshCache
+{
+public:
+
+    /**
+     * One mesh in the cache. The vertex & index
+     * pointers point right into the mapped file.
+     */
+    struct MeshView
+    {
+        const Vertex* vertices;
+        unsigned int numVertices;
+        const unsigned int* indices;
+        unsigned int numIndices;
+        std::vector<MaterialTexture> textures;
+        AABB bounds;
+        std::vector<MeshLOD> lods;
+        std::vector<MeshPart> parts;
+        std::vector<MeshCluster> clusters;
+    };
+
+private:
+
+    /// The cache file, mapped into memory
+    MappedFile mFile;
+
+    /// Every mesh in the cache, in order
+    std::vector<MeshView> mMeshes;
+
+    bool DependenciesMatch(uint32_t numDependencies, size_t& offset) const;
+    bool Parse(size_t offset);
+
+public:
+
+    /// Default constructor
+    MeshCache() = default;
+
+    /// Copy constructor (disabled)
+    MeshCache(const MeshCache &) = delete;
+
+    /// Assignment operator
+    void operator=(const MeshCache &) = delete;
+
+    // ****************************************************************
+
+    bool Open(const std::string& cachePath, const std::string& sourcePath);
+
+    static bool Write(const std::string& cachePath, const std::string& sourcePath,
+                      const std::vector<std::string>& dependencies,
+                      const std::vector<MeshData>& meshes);
+
+    /**
+     * Get the meshes in the cache. Only valid while the cache is open!
+     * @return every mesh in the cache
+     */
+    const std::vector<MeshView>& GetMeshes() const { return mMeshes; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHCACHE_H
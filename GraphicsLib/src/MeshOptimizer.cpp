@@ -0,0 +1,426 @@
+/**
+ * @file MeshOptimizer.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+
+/// Cache size Forsyth's scoring assumes (bigger than any real
+/// FIFO, so the order holds up on whatever GPU it runs on)
+const int FORSYTH_CACHE_SIZE = 32;
+
+/// How fast a vertex's score falls off as it ages in the cache
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+
+/// Score of the last triangle's vertices. Lower than the next few
+/// cache slots, so the order doesn't keep fanning around one vertex
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+
+/// How much vertices with few triangles left get pushed forward,
+/// so they're finished off instead of left for a cache miss later
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+
+/// How fast that boost falls off with more triangles left
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+/// Marks a vertex that hasn't been put in the cache / renumbered yet
+const unsigned int NO_VERTEX = std::numeric_limits<unsigned int>::max();
+
+
+/**
+ * Simulate drawing a mesh through a FIFO vertex cache
+ *
+ * @param indices the mesh's triangles
+ * @param numVertices number of vertices the indices index into
+ * @param cacheSize how many vertices the cache holds
+ * @return how well the index order uses the cache
+ */
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int numVertices,
+                                    unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = (unsigned int)indices.size() / 3;
+
+    // A vertex is in the cache if fewer than cacheSize misses
+    // have happened since it went in
+    std::vector<unsigned int> missWhenCached(numVertices, NO_VERTEX);
+    for (unsigned int index : indices)
+    {
+        if (missWhenCached[index] == NO_VERTEX)
+            stats.vertices++;
+        else if (stats.misses - missWhenCached[index] < cacheSize)
+            continue;
+
+        missWhenCached[index] = stats.misses++;
+    }
+
+    return stats;
+}
+
+
+
+/**
+ * Score a vertex for Forsyth's algorithm: higher means drawing a
+ * triangle with it next is a better idea. Vertices already in the
+ * cache score high, and so do vertices with few triangles left.
+ *
+ * @param cachePosition where the vertex is in the cache (-1 if it isn't)
+ * @param liveTriangles how many of its triangles aren't drawn yet
+ * @return the vertex's score
+ */
+static float ForsythVertexScore(int cachePosition, unsigned int liveTriangles)
+{
+    if (liveTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+        {
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            float age = (float)(cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - age, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    score += FORSYTH_VALENCE_BOOST_SCALE * std::pow((float)liveTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+    return score;
+}
+
+
+
+/**
+ * Reorder triangles to reuse the vertices in the post-transform
+ * cache as much as possible (Forsyth's algorithm).
+ *
+ * Greedy: draw the best-scoring triangle, shuffle its vertices to
+ * the front of a simulated LRU cache, rescore only the triangles of
+ * the vertices in the cache, repeat. Linear time in the triangles.
+ *
+ * @param indices the mesh's triangles, reordered in place
+ * @param numVertices number of vertices the indices index into
+ */
+void OptimizeVertexCache(std::vector<unsigned int> &indices, unsigned int numVertices)
+{
+    auto numTriangles = (unsigned int)indices.size() / 3;
+    if (numTriangles == 0)
+        return;
+
+    // Triangles of each vertex, as one list per vertex, end to end.
+    // The first liveTriangles[v] of vertex v's list aren't drawn yet
+    std::vector<unsigned int> liveTriangles(numVertices, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+
+    std::vector<unsigned int> triangleListStart(numVertices, 0);
+    for (unsigned int v = 1; v < numVertices; ++v)
+        triangleListStart[v] = triangleListStart[v - 1] + liveTriangles[v - 1];
+
+    std::vector<unsigned int> vertexTriangles(indices.size());
+    std::vector<unsigned int> listFill = triangleListStart;
+    for (unsigned int i = 0; i < indices.size(); ++i)
+        vertexTriangles[listFill[indices[i]]++] = i / 3;
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> vertexScore(numVertices);
+    for (unsigned int v = 0; v < numVertices; ++v)
+        vertexScore[v] = ForsythVertexScore(-1, liveTriangles[v]);
+
+    auto scoreTriangle = [&](unsigned int t) {
+        return vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+    };
+
+    // Start with the best triangle of all
+    int best = 0;
+    float bestScore = -1.0f;
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        float score = scoreTriangle(t);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = (int)t;
+        }
+    }
+
+    std::vector<bool> drawn(numTriangles, false);
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    unsigned int nextUndrawn = 0;
+
+    while (result.size() < indices.size())
+    {
+        // Nothing in the cache has triangles left; start somewhere fresh
+        if (best < 0)
+        {
+            while (drawn[nextUndrawn])
+                ++nextUndrawn;
+            best = (int)nextUndrawn;
+        }
+
+        const unsigned int* triangle = &indices[3 * best];
+        drawn[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // Take the triangle off its vertices' lists
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = triangle[k];
+            unsigned int* list = &vertexTriangles[triangleListStart[v]];
+            unsigned int last = --liveTriangles[v];
+            for (unsigned int i = 0; i < last; ++i)
+            {
+                if (list[i] == (unsigned int)best)
+                {
+                    std::swap(list[i], list[last]);
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices go to the front of the cache
+        newCache.clear();
+        for (int k = 0; k < 3; ++k)
+        {
+            if (std::find(newCache.begin(), newCache.end(), triangle[k]) == newCache.end())
+                newCache.push_back(triangle[k]);
+        }
+        auto numFront = (long)newCache.size();
+        for (unsigned int v : cache)
+        {
+            if (std::find(newCache.begin(), newCache.begin() + numFront, v) == newCache.begin() + numFront)
+                newCache.push_back(v);
+        }
+
+        // Rescore the cached vertices (and any that just fell out)
+        for (unsigned int i = 0; i < newCache.size(); ++i)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = (i < (unsigned int)FORSYTH_CACHE_SIZE) ? (int)i : -1;
+            vertexScore[v] = ForsythVertexScore(cachePosition[v], liveTriangles[v]);
+        }
+
+        // Only their triangles' scores changed, so the next
+        // triangle is the best of those
+        best = -1;
+        bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            const unsigned int* list = &vertexTriangles[triangleListStart[v]];
+            for (unsigned int i = 0; i < liveTriangles[v]; ++i)
+            {
+                float score = scoreTriangle(list[i]);
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = (int)list[i];
+                }
+            }
+        }
+
+        if (newCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(newCache);
+    }
+
+    indices.swap(result);
+}
+
+
+
+/**
+ * Reorder the triangles of a vertex-cache-optimized mesh to cut
+ * down on overdraw, without giving back much of the cache gains.
+ *
+ * The triangle order is cut into clusters: a cluster ends as soon
+ * as its ACMR, starting from an empty cache, gets within threshold
+ * of the whole mesh's. So drawing the clusters in any order costs
+ * at most that much more in cache misses. Then the clusters are
+ * sorted by how much they face out from the middle of the mesh;
+ * the outward ones draw first, and tend to cover the inner ones.
+ *
+ * @param indices the mesh's triangles, reordered in place
+ * @param vertices the mesh's vertices
+ * @param threshold how much worse a cluster's ACMR can be than the mesh's
+ */
+void OptimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices,
+                      float threshold)
+{
+    auto numTriangles = (unsigned int)indices.size() / 3;
+    auto numVertices = (unsigned int)vertices.size();
+    if (numTriangles < 2)
+        return;
+
+    float targetACMR = AnalyzeVertexCache(indices, numVertices).ACMR() * threshold;
+
+    // Cut the triangles into clusters, with the same FIFO cache
+    // as AnalyzeVertexCache, emptied at the start of each cluster
+    std::vector<unsigned int> clusterStarts = {0};
+    std::vector<unsigned int> missWhenCached(numVertices, NO_VERTEX);
+    unsigned int misses = 0;
+    unsigned int clusterFirstMiss = 0;
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[3 * t + k];
+            bool cached = missWhenCached[v] != NO_VERTEX && missWhenCached[v] >= clusterFirstMiss &&
+                          misses - missWhenCached[v] < VERTEX_CACHE_SIZE;
+            if (!cached)
+                missWhenCached[v] = misses++;
+        }
+
+        float clusterTriangles = (float)(t + 1 - clusterStarts.back());
+        if (t + 1 < numTriangles && (float)(misses - clusterFirstMiss) / clusterTriangles <= targetACMR)
+        {
+            clusterStarts.push_back(t + 1);
+            clusterFirstMiss = misses;
+        }
+    }
+    clusterStarts.push_back(numTriangles);
+
+    auto numClusters = (unsigned int)clusterStarts.size() - 1;
+    if (numClusters < 2)
+        return;
+
+    // Area-weighted middle & facing of each cluster, and of the mesh
+    std::vector<glm::vec3> clusterCenters(numClusters, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(numClusters, glm::vec3(0.0f));
+    std::vector<float> clusterAreas(numClusters, 0.0f);
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (unsigned int c = 0; c < numClusters; ++c)
+    {
+        for (unsigned int t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+        {
+            const glm::vec3& a = vertices[indices[3 * t]].position;
+            const glm::vec3& b = vertices[indices[3 * t + 1]].position;
+            const glm::vec3& d = vertices[indices[3 * t + 2]].position;
+
+            // (The cross product's length is twice the area; same weights either way)
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            glm::vec3 center = (a + b + d) / 3.0f;
+
+            clusterCenters[c] += center * area;
+            clusterNormals[c] += normal;
+            clusterAreas[c] += area;
+        }
+
+        meshCenter += clusterCenters[c];
+        meshArea += clusterAreas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    std::vector<float> clusterFacing(numClusters, 0.0f);
+    for (unsigned int c = 0; c < numClusters; ++c)
+    {
+        float normalLength = glm::length(clusterNormals[c]);
+        if (clusterAreas[c] <= 0.0f || normalLength <= 0.0f)
+            continue;
+
+        glm::vec3 center = clusterCenters[c] / clusterAreas[c];
+        clusterFacing[c] = glm::dot(center - meshCenter, clusterNormals[c] / normalLength);
+    }
+
+    // Most outward-facing clusters first
+    std::vector<unsigned int> clusterOrder(numClusters);
+    for (unsigned int c = 0; c < numClusters; ++c)
+        clusterOrder[c] = c;
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](unsigned int a, unsigned int b) {
+        return clusterFacing[a] > clusterFacing[b];
+    });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (unsigned int c : clusterOrder)
+    {
+        result.insert(result.end(), indices.begin() + 3 * clusterStarts[c],
+                      indices.begin() + 3 * clusterStarts[c + 1]);
+    }
+
+    indices.swap(result);
+}
+
+
+
+/**
+ * Renumber the vertices in the order the triangles first use
+ * them, so the GPU reads the vertex buffer front to back.
+ * Vertices no triangle uses get dropped.
+ *
+ * @param vertices the mesh's vertices, reordered in place
+ * @param indices the mesh's triangles, renumbered in place
+ */
+void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    std::vector<unsigned int> newIndex(vertices.size(), NO_VERTEX);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (unsigned int& index : indices)
+    {
+        if (newIndex[index] == NO_VERTEX)
+        {
+            newIndex[index] = (unsigned int)result.size();
+            result.push_back(vertices[index]);
+        }
+        index = newIndex[index];
+    }
+
+    vertices.swap(result);
+}
+
+
+
+/**
+ * Run all the passes on a mesh: vertex cache, then
+ * overdraw, then vertex fetch. (See MeshOptimizer.h)
+ *
+ * Each level of detail's triangles get reordered on their own.
+ * So do each part's, in a batched mesh (see MeshBatcher.h), so
+ * no triangle moves out of its part's range.
+ * The vertex fetch order follows full detail, since the other
+ * LODs only use some of its vertices.
+ *
+ * @param mesh the mesh to optimize, in place
+ */
+void OptimizeMesh(MeshData &mesh)
+{
+    if (mesh.lods.empty())
+        mesh.lods.push_back({0, (unsigned int)mesh.indices.size()});
+
+    // Full detail is the parts, if there are any
+    std::vector<MeshLOD> ranges;
+    for (const MeshPart& part : mesh.parts)
+        ranges.push_back({part.firstIndex, part.numIndices});
+    ranges.insert(ranges.end(), mesh.lods.begin() + (mesh.parts.empty() ? 0 : 1), mesh.lods.end());
+
+    for (const MeshLOD& lod : ranges)
+    {
+        auto first = mesh.indices.begin() + lod.firstIndex;
+        std::vector<unsigned int> indices(first, first + lod.numIndices);
+        OptimizeVertexCache(indices, (unsigned int)mesh.vertices.size());
+        OptimizeOverdraw(indices, mesh.vertices);
+        std::copy(indices.begin(), indices.end(), first);
+    }
+
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    // Unused vertices might be gone
+    mesh.bounds = AABB();
+    for (const Vertex& vertex : mesh.vertices)
+        mesh.bounds.Expand(vertex.position);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file MeshOptimizer.h
+ * @author Elijah Gleckler
+ *
+ * Reorders a mesh's triangles & vertices so the GPU draws it faster.
+ * Run once at import time; the results go into the mesh cache.
+ *
+ * Three passes, in this order (each one keeps what the last won):
+ *
+ *  1. Vertex cache: triangles are reordered so they reuse the
+ *     vertices the GPU just transformed (Tom Forsyth's "Linear-Speed
+ *     Vertex Cache Optimisation"), so fewer vertices get shaded twice.
+ *
+ *  2. Overdraw: that order gets cut into clusters wherever the cache
+ *     would barely notice (Sander et al., "Fast Triangle Reordering
+ *     for Vertex Locality and Reduced Overdraw"), and the clusters
+ *     are sorted so the ones facing out of the mesh draw first, and
+ *     hide the ones behind them from the fragment shader.
+ *
+ *  3. Vertex fetch: vertices are renumbered in the order the
+ *     triangles first use them, so fetching them walks through
+ *     the vertex buffer instead of jumping around it.
+ *
+ * How well the cache gets used is measured with a simulated FIFO
+ * cache, as ACMR (cache misses per triangle; 0.5 is about as low
+ * as it goes, 3 is no reuse at all) and ATVR (misses per vertex;
+ * 1 is perfect).
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHOPTIMIZER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHOPTIMIZER_H
+
+#include <vector>
+
+#include "Mesh.h"
+
+struct MeshData;
+
+/// Size of the FIFO vertex cache AnalyzeVertexCache simulates
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+/// How much worse than the whole mesh's ACMR an overdraw
+/// cluster can be (1.05 = 5% more cache misses, tops)
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+/**
+ * How well a mesh's index order uses the vertex cache
+ */
+struct VertexCacheStats
+{
+    /// Triangles drawn
+    unsigned int triangles = 0;
+
+    /// Different vertices the triangles use
+    unsigned int vertices = 0;
+
+    /// Vertices that had to be transformed (weren't in the cache)
+    unsigned int misses = 0;
+
+    /**
+     * Get the average cache miss ratio
+     * @return cache misses per triangle
+     */
+    float ACMR() const { return triangles > 0 ? (float)misses / (float)triangles : 0.0f; }
+
+    /**
+     * Get the average transform to vertex ratio
+     * @return cache misses per vertex
+     */
+    float ATVR() const { return vertices > 0 ? (float)misses / (float)vertices : 0.0f; }
+
+    /**
+     * Add another mesh's stats to these
+     * @param other the other mesh's stats
+     * @return these stats
+     */
+    VertexCacheStats& operator+=(const VertexCacheStats& other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int numVertices,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices);
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+                      float threshold = OVERDRAW_ACMR_THRESHOLD);
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+void OptimizeMesh(MeshData& mesh);
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHOPTIMIZER_H
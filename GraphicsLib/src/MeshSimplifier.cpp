@@ -0,0 +1,373 @@
+/**
+ * @file MeshSimplifier.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+
+#include "MeshSimplifier.h"
+#include "MeshCache.h"
+
+/// A collapse can't turn a triangle further than this
+/// (cosine of the angle), or it might end up folded over
+const float COLLAPSE_MIN_NORMAL_COS = 0.25f;
+
+/// A LOD has to drop at least this much of the last
+/// one's triangles to be worth keeping
+const float LOD_MIN_REDUCTION = 0.15f;
+
+/**
+ * The sum of squared distances to a bunch of planes, as the
+ * upper half of a symmetric 4x4 matrix. Doubles, since the
+ * error is a small difference of big sums.
+ */
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    /**
+     * Add a plane, n . p + d = 0
+     * @param n unit normal of the plane
+     * @param d distance of the plane from the origin
+     */
+    void AddPlane(const glm::vec3& n, float d)
+    {
+        a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+        a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+        a22 += n.z * n.z; a23 += n.z * d;
+        a33 += d * d;
+    }
+
+    /**
+     * Add another quadric's planes to this one's
+     * @param other the other quadric
+     */
+    void Add(const Quadric& other)
+    {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+        a11 += other.a11; a12 += other.a12; a13 += other.a13;
+        a22 += other.a22; a23 += other.a23;
+        a33 += other.a33;
+    }
+
+    /**
+     * Get the sum of squared distances from a point to the planes
+     * @param p the point
+     * @return the error of moving a vertex to the point
+     */
+    double Error(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a00 * x * x + a11 * y * y + a22 * z * z
+                     + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                     + 2.0 * (a03 * x + a13 * y + a23 * z)
+                     + a33;
+        return error > 0.0 ? error : 0.0;
+    }
+};
+
+/// Moving one vertex onto another
+struct Collapse
+{
+    unsigned int from;
+    unsigned int to;
+    double cost;
+};
+
+
+/**
+ * Pack a directed edge into one number
+ * @param a vertex the edge starts at
+ * @param b vertex the edge ends at
+ * @return the edge's key
+ */
+static uint64_t EdgeKey(unsigned int a, unsigned int b)
+{
+    return ((uint64_t)a << 32) | b;
+}
+
+
+
+/**
+ * Would moving a vertex flip (or nearly flip) any of its triangles over?
+ *
+ * @param from the vertex that moves
+ * @param to where it moves to
+ * @param triangles the triangles around from
+ * @param numTriangles how many of them
+ * @param indices the mesh's triangles
+ * @param vertices the mesh's vertices
+ * @return true if some triangle (that doesn't just disappear) would turn too far
+ */
+static bool CollapseFlips(unsigned int from, unsigned int to,
+                          const unsigned int* triangles, unsigned int numTriangles,
+                          const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices)
+{
+    for (unsigned int i = 0; i < numTriangles; ++i)
+    {
+        const unsigned int* triangle = &indices[3 * triangles[i]];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            before[k] = vertices[triangle[k]].position;
+            after[k] = (triangle[k] == from) ? vertices[to].position : before[k];
+        }
+
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+        if (glm::dot(normalBefore, normalAfter) <= COLLAPSE_MIN_NORMAL_COS * lengths)
+            return true;
+    }
+
+    return false;
+}
+
+
+
+/**
+ * Find the vertices that can't move: the ones on an open edge,
+ * i.e. an edge with no twin going the other way around.
+ *
+ * @param indices the mesh's triangles
+ * @param numVertices how many vertices the mesh has
+ * @return whether each vertex is locked
+ */
+static std::vector<bool> FindLockedVertices(const std::vector<unsigned int> &indices, unsigned int numVertices)
+{
+    std::unordered_set<uint64_t> edges;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (size_t k = 0; k < 3; ++k)
+            edges.insert(EdgeKey(indices[i + k], indices[i + (k + 1) % 3]));
+    }
+
+    std::vector<bool> locked(numVertices, false);
+    for (uint64_t edge : edges)
+    {
+        auto a = (unsigned int)(edge >> 32);
+        auto b = (unsigned int)(edge & 0xFFFFFFFF);
+        if (edges.count(EdgeKey(b, a)) == 0)
+        {
+            locked[a] = true;
+            locked[b] = true;
+        }
+    }
+
+    return locked;
+}
+
+
+
+/**
+ * Simplify a mesh down to (about) a target number of indices.
+ *
+ * Works in passes: each pass finds every possible edge collapse,
+ * and does the cheapest ones that don't overlap (no vertex in two
+ * collapses, nor next to one), then drops the triangles that
+ * collapsed to nothing. Passes go until the target's met, or no
+ * collapse is left under the error limit.
+ *
+ * @param vertices the mesh's vertices
+ * @param indices the mesh's triangles
+ * @param targetIndexCount how many indices to get down to
+ * @param maxError furthest the surface may move (in model units)
+ * @return the simplified mesh's triangles, into the same vertices
+ */
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> &vertices,
+                                       const std::vector<unsigned int> &indices,
+                                       unsigned int targetIndexCount, float maxError)
+{
+    auto numVertices = (unsigned int)vertices.size();
+    std::vector<unsigned int> result = indices;
+
+    // Every vertex starts with the planes of its triangles
+    std::vector<Quadric> quadrics(numVertices);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const glm::vec3& a = vertices[indices[i]].position;
+        const glm::vec3& b = vertices[indices[i + 1]].position;
+        const glm::vec3& c = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normal /= length;
+
+        float d = -glm::dot(normal, a);
+        for (size_t k = 0; k < 3; ++k)
+            quadrics[indices[i + k]].AddPlane(normal, d);
+    }
+
+    // Vertices on an open edge stay put
+    std::vector<bool> locked = FindLockedVertices(indices, numVertices);
+
+    double maxCost = (double)maxError * (double)maxError;
+    std::vector<unsigned int> triangleCounts(numVertices);
+    std::vector<unsigned int> triangleListStart(numVertices);
+    std::vector<unsigned int> vertexTriangles;
+    std::vector<Collapse> collapses;
+    std::vector<bool> touched(numVertices);
+    std::vector<unsigned int> remap(numVertices);
+
+    while (result.size() > targetIndexCount)
+    {
+        // Triangles of each vertex, one list per vertex, end to end
+        std::fill(triangleCounts.begin(), triangleCounts.end(), 0);
+        for (unsigned int index : result)
+            triangleCounts[index]++;
+        unsigned int start = 0;
+        for (unsigned int v = 0; v < numVertices; ++v)
+        {
+            triangleListStart[v] = start;
+            start += triangleCounts[v];
+        }
+        vertexTriangles.resize(result.size());
+        std::vector<unsigned int> listFill = triangleListStart;
+        for (unsigned int i = 0; i < result.size(); ++i)
+            vertexTriangles[listFill[result[i]]++] = i / 3;
+
+        // Every way an edge could collapse, cheapest first
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                unsigned int a = result[i + k];
+                unsigned int b = result[i + (k + 1) % 3];
+                for (int direction = 0; direction < 2; ++direction)
+                {
+                    unsigned int from = direction == 0 ? a : b;
+                    unsigned int to = direction == 0 ? b : a;
+                    if (locked[from])
+                        continue;
+
+                    Quadric combined = quadrics[from];
+                    combined.Add(quadrics[to]);
+                    double cost = combined.Error(vertices[to].position);
+                    if (cost <= maxCost)
+                        collapses.push_back({from, to, cost});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        // Do as many as it takes (each one drops ~2 triangles),
+        // never two next to each other in the same pass
+        std::fill(touched.begin(), touched.end(), false);
+        for (unsigned int v = 0; v < numVertices; ++v)
+            remap[v] = v;
+
+        unsigned int trianglesToRemove = ((unsigned int)result.size() - targetIndexCount) / 3;
+        unsigned int trianglesRemoved = 0;
+        unsigned int numCollapsed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (trianglesRemoved >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            const unsigned int* triangles = &vertexTriangles[triangleListStart[collapse.from]];
+            unsigned int numTriangles = triangleCounts[collapse.from];
+            if (CollapseFlips(collapse.from, collapse.to, triangles, numTriangles, result, vertices))
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            numCollapsed++;
+
+            for (unsigned int i = 0; i < numTriangles; ++i)
+            {
+                const unsigned int* triangle = &result[3 * triangles[i]];
+                bool sharesEdge = false;
+                for (int k = 0; k < 3; ++k)
+                {
+                    touched[triangle[k]] = true;
+                    sharesEdge = sharesEdge || triangle[k] == collapse.to;
+                }
+                if (sharesEdge)
+                    trianglesRemoved++;
+            }
+        }
+
+        if (numCollapsed == 0)
+            break;
+
+        // Move the collapsed vertices, and drop the triangles that went flat
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]];
+            unsigned int b = remap[result[i + 1]];
+            unsigned int c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+
+    return result;
+}
+
+
+
+/**
+ * Make the levels of detail of a mesh.
+ *
+ * Each LOD is simplified from the full mesh (not the last LOD, so
+ * errors don't pile up), aiming for LOD_TRIANGLE_RATIO of the last
+ * one's triangles. The LODs' indices go on the end of the mesh's
+ * index buffer, and mesh.lods says where each one is. It stops at
+ * MAX_MESH_LODS, or once the next one wouldn't save much.
+ *
+ * @param mesh the mesh; gets its LODs added
+ * @return how many of its vertices are locked on an open edge; if
+ *         that's most of them, the mesh probably wasn't welded
+ */
+unsigned int GenerateLODs(MeshData &mesh)
+{
+    mesh.lods.clear();
+    mesh.lods.push_back({0, (unsigned int)mesh.indices.size()});
+
+    const std::vector<unsigned int> full = mesh.indices;
+    auto numVertices = (unsigned int)mesh.vertices.size();
+    std::vector<bool> locked = FindLockedVertices(full, numVertices);
+    auto numLocked = (unsigned int)std::count(locked.begin(), locked.end(), true);
+
+    float maxError = LOD_MAX_ERROR * glm::length(mesh.bounds.Extents()) * 2.0f;
+    auto lastIndexCount = (unsigned int)full.size();
+
+    while (mesh.lods.size() < MAX_MESH_LODS)
+    {
+        unsigned int targetTriangles = (unsigned int)((float)(lastIndexCount / 3) * LOD_TRIANGLE_RATIO);
+        if (targetTriangles < LOD_MIN_TRIANGLES)
+            break;
+
+        std::vector<unsigned int> lod = SimplifyMesh(mesh.vertices, full, targetTriangles * 3, maxError);
+        if ((float)lod.size() > (float)lastIndexCount * (1.0f - LOD_MIN_REDUCTION))
+            break;
+
+        mesh.lods.push_back({(unsigned int)mesh.indices.size(), (unsigned int)lod.size()});
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        lastIndexCount = (unsigned int)lod.size();
+    }
+
+    return numLocked;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file MeshSimplifier.h
+ * @author Elijah Gleckler
+ *
+ * Makes lower levels of detail (LODs) of a mesh at import time,
+ * with quadric error metric simplification (Garland & Heckbert,
+ * "Surface Simplification Using Quadric Error Metrics").
+ *
+ * Every vertex keeps a quadric: the sum of the squared distances
+ * to the planes of the triangles around it. Collapsing an edge
+ * moves one vertex onto the other, and costs the combined quadric
+ * at where it lands, i.e. how far the surface moves. The cheapest
+ * collapses go first, until the mesh is down to its target size
+ * or every collapse left would move it too far.
+ *
+ * Vertices only ever collapse onto other vertices, so no new ones
+ * get made: every LOD uses the same vertex buffer, and is just
+ * another range of the index buffer (see MeshLOD).
+ *
+ * Vertices on an open edge--the mesh's border, or a seam where the
+ * vertices are split for different texture coordinates or normals--
+ * never move, so the mesh can't tear apart. Meshes that are mostly
+ * seams don't simplify much, and meshes that were never welded (every
+ * triangle with vertices of its own) are all seams and don't simplify
+ * at all--GenerateLODs returns how many vertices got locked, so that
+ * shows up.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHSIMPLIFIER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHSIMPLIFIER_H
+
+#include <vector>
+
+#include "Mesh.h"
+
+struct MeshData;
+
+/// How many of the last LOD's triangles each LOD aims to keep
+const float LOD_TRIANGLE_RATIO = 0.5f;
+
+/// Furthest a LOD's surface can move, as a fraction of the mesh's size
+const float LOD_MAX_ERROR = 0.02f;
+
+/// Meshes (or LODs) with fewer triangles than this don't get another LOD
+const unsigned int LOD_MIN_TRIANGLES = 64;
+
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex>& vertices,
+                                       const std::vector<unsigned int>& indices,
+                                       unsigned int targetIndexCount, float maxError);
+
+unsigned int GenerateLODs(MeshData& mesh);
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_MESHSIMPLIFIER_H
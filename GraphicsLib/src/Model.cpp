@@ -5,14 +5,19 @@
 
 #include "Model.h"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <glad/glad.h>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
+#include <assimp/DefaultIOSystem.h>
 
 #include "Texture2D.h"
+#include "TextureRegistry.h"
+#include "MeshBatcher.h"
+#include "ClusterCulling.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
 
 /**
@@ -22,32 +27,220 @@
 Model::Model(const char *fileDirectory)
 {
     mFileDirectory = fileDirectory;
-    LoadModel(fileDirectory);
+    BuildMeshes(Import(mFileDirectory));
+}
+
+
+
+/**
+ * Constructor, from a model that's already been imported
+ * (like on another thread--see Import()). Only the GL side
+ * of loading is left to do, so this needs the GL context.
+ *
+ * @param fileDirectory directory where this objects resources lie
+ * @param data the model's imported meshes
+ */
+Model::Model(const std::string &fileDirectory, const ModelData &data)
+{
+    mFileDirectory = fileDirectory;
+    BuildMeshes(data);
 }
 
 
 
 /**
- * Loads a model from it's resource folder filepath.
+ * Imports a model from it's resource folder filepath.
  * By convention, all models files should be wavefront
  * files (.obj) with the same name as the resources
  * directory in which they are contained.
  *
+ * If there's an up-to-date mesh cache next to the .obj, the
+ * meshes come straight out of that (see MeshCache.h). Otherwise
+ * the .obj goes through Assimp, the MeshBatcher, the MeshSimplifier
+ * and the MeshOptimizer, gets cut into clusters (see ClusterCulling.h),
+ * and the cache gets (re)written for next time.
+ *
+ * Doesn't touch OpenGL (or the model's textures), so it's safe
+ * to run on any thread. Hand the result to the Model constructor
+ * on the GL thread to finish loading.
+ *
  * Code copied from LearnOpenGL pg.165
  *
- * @param filepath Filepath of the model's resources folder
+ * @param fileDirectory Filepath of the model's resources folder
+ * @return the model's meshes, ready to upload
  */
-void Model::LoadModel(const std::string &fileDirectory)
+ModelData Model::Import(const std::string &fileDirectory)
 {
-    Assimp::Importer importer;
-
     // This is why the convention of "filename" = "directory name"
     // must be enforced. Only wavefront (.obj) files are allowed!
     // This is for simplicity on the art designer (me...)
     auto fileName = fileDirectory.substr(fileDirectory.find_last_of('/') + 1);
-    auto filepath = mFileDirectory + '/' + fileName + ".obj";
+    auto filepath = fileDirectory + '/' + fileName + ".obj";
+    auto cachePath = fileDirectory + '/' + fileName + ".meshcache";
+
+    ModelData data;
+
+    // Fast path: the meshes are already sitting in the cache
+    auto cache = std::make_shared<MeshCache>();
+    if (cache->Open(cachePath, filepath))
+    {
+        data.cache = cache;
+        return data;
+    }
+
+    // Slow path: have Assimp parse the .obj
+    std::vector<std::string> dependencies;
+    if (!ImportModel(filepath, data.meshes, dependencies))
+        return data;
+
+    // Merge the meshes with the same textures, so
+    // each material can draw with one call...
+    auto numMeshes = (unsigned int)data.meshes.size();
+    BatchMeshesByMaterial(data.meshes);
+
+    // ... then make the levels of detail and reorder the meshes for the
+    // GPU once, here, so it all sticks in the cache
+    VertexCacheStats before;
+    VertexCacheStats after;
+    unsigned int numLODs = 0;
+    unsigned int numClusters = 0;
+    unsigned int numVertices = 0;
+    unsigned int numLocked = 0;
+    for (MeshData& mesh : data.meshes)
+    {
+        before += AnalyzeVertexCache(mesh.indices, (unsigned int)mesh.vertices.size());
+        numLocked += GenerateLODs(mesh);
+        numVertices += (unsigned int)mesh.vertices.size();
+        OptimizeMesh(mesh);
+        BuildClusters(mesh);
+        numLODs += (unsigned int)mesh.lods.size() - 1;
+        numClusters += (unsigned int)mesh.clusters.size();
+
+        std::vector<unsigned int> fullDetail(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].numIndices);
+        after += AnalyzeVertexCache(fullDetail, (unsigned int)mesh.vertices.size());
+    }
+
+    // One string, so lines from models importing at once don't interleave
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(3)
+            << "Optimized " << filepath << ": " << numMeshes << " meshes -> "
+            << data.meshes.size() << " batches, ACMR " << before.ACMR() << " -> " << after.ACMR()
+            << ", ATVR " << before.ATVR() << " -> " << after.ATVR()
+            << ", " << numLODs << " LODs (" << std::setprecision(1)
+            << (numVertices > 0 ? 100.0f * (float)numLocked / (float)numVertices : 0.0f)
+            << "% of vertices locked on open edges), " << numClusters << " clusters" << std::endl;
+    std::cout << message.str();
+
+    if (!MeshCache::Write(cachePath, filepath, dependencies, data.meshes))
+    {
+        std::cout
+        << "****************************************************************" << std::endl
+        << "WARNING::MESH_CACHE::Couldn't write mesh cache: " << cachePath << std::endl
+        << "****************************************************************" << std::endl;
+    }
+
+    return data;
+}
 
-    const aiScene* scene = importer.ReadFile(filepath, aiProcess_Triangulate | aiProcess_FlipUVs);
+
+
+/**
+ * Make the GL meshes (and start loading the textures) of an imported model.
+ *
+ * Every texture no model has asked for yet starts decoding on the
+ * shared ThreadPool, and gets handed to the TextureStreamer,
+ * which uploads it over the next frames as it finishes. Nothing here
+ * waits on a texture, so models can load mid-game without a hitch.
+ *
+ * @param data the model's imported meshes
+ */
+void Model::BuildMeshes(const ModelData &data)
+{
+    // Pack every mesh against the whole model's box, so they all
+    // share a position transform and a RenderQueue can merge their draws
+    if (data.cache != nullptr)
+    {
+        for (const MeshCache::MeshView& view : data.cache->GetMeshes())
+            mBounds.Expand(view.bounds);
+    }
+    for (const MeshData& mesh : data.meshes)
+        mBounds.Expand(mesh.bounds);
+
+    if (data.cache != nullptr)
+    {
+        // Upload right out of the mapped cache
+        for (const MeshCache::MeshView& view : data.cache->GetMeshes())
+        {
+            mMeshes.push_back(std::make_shared<Mesh>(view.vertices, view.numVertices,
+                                                     view.indices, view.numIndices,
+                                                     LoadTextures(view.textures), view.bounds,
+                                                     view.lods, view.parts, view.clusters, mBounds));
+        }
+    }
+
+    for (const MeshData& mesh : data.meshes)
+    {
+        mMeshes.push_back(std::make_shared<Mesh>(mesh.vertices, mesh.indices,
+                                                 LoadTextures(mesh.textures), mesh.bounds,
+                                                 mesh.lods, mesh.parts, mesh.clusters, mBounds));
+    }
+}
+
+
+
+/**
+ * Assimp's file system, except it remembers every file the
+ * importer opens, so the mesh cache can tell when any of them
+ * change (the .obj's .mtl, mostly)
+ */
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+
+    /// Paths of the files opened so far, in order, without repeats
+    std::vector<std::string> mOpened;
+
+    /**
+     * Open a file, and remember it if it's really there
+     * @param file path to the file
+     * @param mode fopen-style mode
+     * @return the file's stream, or nullptr if it couldn't be opened
+     */
+    Assimp::IOStream* Open(const char* file, const char* mode) override
+    {
+        Assimp::IOStream* stream = DefaultIOSystem::Open(file, mode);
+        if (stream != nullptr && std::find(mOpened.begin(), mOpened.end(), file) == mOpened.end())
+            mOpened.emplace_back(file);
+        return stream;
+    }
+};
+
+
+
+/**
+ * Parse a model file with Assimp into MeshData.
+ * (Each call has its own Importer, so this is thread-safe.)
+ *
+ * @param filepath path to the model's .obj file
+ * @param meshes filled with every mesh in the model
+ * @param dependencies filled with every other file Assimp read (like the .mtl)
+ * @return false if Assimp couldn't load the file
+ */
+bool Model::ImportModel(const std::string &filepath, std::vector<MeshData> &meshes,
+                        std::vector<std::string> &dependencies)
+{
+    Assimp::Importer importer;
+
+    // (The importer owns it from here on, and deletes it)
+    auto* files = new RecordingIOSystem();
+    importer.SetIOHandler(files);
+
+    // Weld the vertices, too: the .obj importer gives every triangle
+    // corner a vertex of its own, which leaves the vertex cache nothing
+    // to reuse (see MeshOptimizer.h) and every edge open, so nothing
+    // could ever be simplified (see MeshSimplifier.h)
+    const aiScene* scene = importer.ReadFile(filepath, aiProcess_Triangulate | aiProcess_FlipUVs |
+                                                       aiProcess_JoinIdenticalVertices);
     // The pFlags argument is a set of post-processing flags that
     // assimp can run. Check pg. 165 of LearningOpenGL, there are
     // some nice ones, like "aiProcess_GenNormals" that might be
@@ -61,10 +254,16 @@ void Model::LoadModel(const std::string &fileDirectory)
         << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl
         << "Occured when loading model from: " << filepath << std::endl
         << "****************************************************************" << std::endl;
-        return;
+        return false;
     }
-    ProcessNode(scene->mRootNode, scene);
+    ProcessNode(scene->mRootNode, scene, aiMatrix4x4(), meshes);
 
+    for (const std::string& file : files->mOpened)
+    {
+        if (file != filepath)
+            dependencies.push_back(file);
+    }
+    return true;
 }
 
 
@@ -73,23 +272,32 @@ void Model::LoadModel(const std::string &fileDirectory)
  * Process one node of the Assimp scene, then recursively
  * process its childen
  *
+ * Each node's transform is relative to its parent's, so they get
+ * multiplied down the tree, and baked into the meshes' vertices.
+ * That puts every mesh in model space, ready to be batched.
+ *
  * Code copied from LearnOpenGL pg. 166
  *
  * @param node Assimp node
  * @param scene Assimp scene object
+ * @param parentTransform the node's parent's transform, to model space
+ * @param meshes the node's meshes get added to this
  */
-void Model::ProcessNode(aiNode *node, const aiScene *scene)
+void Model::ProcessNode(aiNode *node, const aiScene *scene, const aiMatrix4x4 &parentTransform,
+                        std::vector<MeshData> &meshes)
 {
+    aiMatrix4x4 transform = parentTransform * node->mTransformation;
+
     // process all the node’s meshes (if any)
     for(unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        mMeshes.push_back(ProcessMesh(mesh, scene));
+        meshes.push_back(ProcessMesh(mesh, scene, transform));
     }
     // then do the same for each of its children
     for(unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        ProcessNode(node->mChildren[i], scene);
+        ProcessNode(node->mChildren[i], scene, transform, meshes);
     }
 
 }
@@ -98,34 +306,42 @@ void Model::ProcessNode(aiNode *node, const aiScene *scene)
 
 
 /**
- * Translate an aiMesh object into our Mesh object
+ * Translate an aiMesh object into our own MeshData
  *
  * @param mesh Assimp aiMesh object
  * @param scene Assimo scene object
- * @return A Mesh object of our own making
+ * @param transform the mesh's node's transform, to model space
+ * @return the mesh's vertices, indices, textures & bounds
  */
-std::shared_ptr<Mesh> Model::ProcessMesh(aiMesh *mesh, const aiScene *scene)
+MeshData Model::ProcessMesh(aiMesh *mesh, const aiScene *scene, const aiMatrix4x4 &transform)
 {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<TextureData> textures;
+    MeshData data;
+    data.vertices.reserve(mesh->mNumVertices);
+    data.indices.reserve(mesh->mNumFaces * 3);
 
+    // Normals go through the inverse transpose, so they stay
+    // perpendicular to the surface under non-uniform scales
+    aiMatrix3x3 normalTransform = aiMatrix3x3(transform);
+    normalTransform.Inverse().Transpose();
 
     // Get all the vertex data
     for(unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
         Vertex vertex;
         // process vertex positions, ...
+        aiVector3D position = transform * mesh->mVertices[i];
         glm::vec3 vector;
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
+        vector.x = position.x;
+        vector.y = position.y;
+        vector.z = position.z;
         vertex.position = vector;
+        data.bounds.Expand(vector);
 
         // ... normals, ...
-        vector.x = mesh->mNormals[i].x;
-        vector.y = mesh->mNormals[i].y;
-        vector.z = mesh->mNormals[i].z;
+        aiVector3D normal = (normalTransform * mesh->mNormals[i]).Normalize();
+        vector.x = normal.x;
+        vector.y = normal.y;
+        vector.z = normal.z;
         vertex.normal = vector;
 
         // ... and texture coordinates.
@@ -139,17 +355,26 @@ std::shared_ptr<Mesh> Model::ProcessMesh(aiMesh *mesh, const aiScene *scene)
         else
             vertex.texCoords = glm::vec2(0.0f, 0.0f);
 
-        vertices.push_back(vertex);
+        data.vertices.push_back(vertex);
     }
 
 
 
-    // Get all the index data
+    // Get all the index data. A mirroring transform turns the
+    // triangles inside out, so flip them back around
+    bool mirrored = transform.Determinant() < 0.0f;
     for(unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
+        if (mirrored && face.mNumIndices == 3)
+        {
+            data.indices.push_back(face.mIndices[0]);
+            data.indices.push_back(face.mIndices[2]);
+            data.indices.push_back(face.mIndices[1]);
+            continue;
+        }
         for(unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+            data.indices.push_back(face.mIndices[j]);
     }
 
 
@@ -161,153 +386,71 @@ std::shared_ptr<Mesh> Model::ProcessMesh(aiMesh *mesh, const aiScene *scene)
         // Get pointer to this particular material
         aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
 
-        // Load the material's diffuse maps
-        std::vector<TextureData> diffuseMaps = LoadMaterialTextures(material,
-                                                                    aiTextureType_DIFFUSE, TextureType::Diffuse);
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-        // Load the material's specular maps
-        std::vector<TextureData> specularMaps = LoadMaterialTextures(material,
-                                                                     aiTextureType_SPECULAR, TextureType::Specular);
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-
-        // Load the material's roughness maps
-        std::vector<TextureData> roughnessMaps = LoadMaterialTextures(material,
-                                                                      aiTextureType_SHININESS, TextureType::Roughness);
-        textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
+        // The material's diffuse, specular & roughness maps. (Not its normal
+        // map: no shader samples one yet, so it'd just be loaded, cooked
+        // & bound for nothing. TextureType::Normal cooks to BC5 for when
+        // one does.)
+        GetMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::Diffuse, data.textures);
+        GetMaterialTextures(material, aiTextureType_SPECULAR, TextureType::Specular, data.textures);
+        GetMaterialTextures(material, aiTextureType_SHININESS, TextureType::Roughness, data.textures);
     }
 
-
-    // Make a shared pointer to share the love (no copy constructors  >:0  )
-    return std::make_shared<Mesh>(vertices, indices, textures);
+    return data;
 }
 
 
 
 /**
- * Loads a texture from an Assimp material
- *
- * Code copied from LearnOpenGL pg.170
+ * Get the texture paths of one type out of an Assimp material
  *
  * @param mat pointer to Assimp material
  * @param type Assimp texture type enum
  * @param typeName Custom enum for texture types
- * @return vector of Texture data structs
+ * @param textures the material's textures get added to this
  */
-std::vector<TextureData> Model::LoadMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType typeName)
+void Model::GetMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType typeName,
+                                std::vector<MaterialTexture> &textures)
 {
-    std::vector<TextureData> textures;
     for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for(unsigned int j = 0; j < mTexturesLoaded.size(); j++)
-        {
-            if(std::strcmp(mTexturesLoaded[j].filepath.data(),
-                           str.C_Str()) == 0)
-            {
-                textures.push_back(mTexturesLoaded[j]);
-                skip = true;
-                break;
-            } }
-        if(!skip)
-        { // if texture hasn't been loaded already, load it
-            TextureData texture;
-            texture.id = TextureFromFile(str.C_Str(), mFileDirectory);
-            texture.type = typeName;
-            texture.filepath = str.C_Str();
-            textures.push_back(texture);
-
-            mTexturesLoaded.push_back(texture); // add to loaded textures
-        } }
-    return textures;
+        textures.push_back({typeName, str.C_Str()});
+    }
 }
 
 
 
 /**
- * RenderScene all the Model's meshes
- * @param shaders ShaderProgram program used to draw the meshes
- */
-void Model::Draw(ShaderProgram &shaders)
-{
-    for (unsigned int i = 0; i < mMeshes.size(); i++)
-        mMeshes[i]->Draw(shaders);
-}
-
-
-/**
- * Taking the filepath to a texture image, generates the texture
- * and returns the OpenGL texture Id
+ * Loads the textures of a mesh.
  *
- * @param filepath
- * @param fileDirectory
- * @return OpenGL texture id
+ * Textures come from the TextureRegistry, so every model using
+ * the same image shares one GL texture. Each one is a reference
+ * the mesh lets go of when it's destroyed.
+ *
+ * @param materialTextures the textures a mesh wants
+ * @return vector of Texture data structs
  */
-unsigned int Model::TextureFromFile(const char *filepath, std::string fileDirectory)
+std::vector<TextureData> Model::LoadTextures(const std::vector<MaterialTexture> &materialTextures)
 {
-
-    // We'll need this...
-    std::string fullFilepath = fileDirectory + '/' + std::string(filepath);
-
-    // Generate an OpenGL texture object (page 60)
-    unsigned int textureId;
-    glGenTextures(1, &textureId);
-
-    // Load an image, getting its width, height, and number of color channels
-    int width, height, numChannels;
-
-    // Shall we implement later?
-    // Uh.... LearnOpenGL said they do this by default... idek why
-    stbi_set_flip_vertically_on_load(true);
-
-    // Load the image
-    unsigned char* data = stbi_load(fullFilepath.c_str(), &width, &height, &numChannels, 0);
-
-    // Don't mess with nullptrs...
-    if(data)
-    {
-        // Find out what kind of colorformat this image is
-        GLenum colorFormat;
-
-        if (numChannels == 1)
-            colorFormat = GL_RED;
-        else if (numChannels == 3)
-            colorFormat = GL_RGB;
-        else if (numChannels == 4)
-            colorFormat = GL_RGBA;
-
-
-        // Bind and generate the texture
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, colorFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Specify the wrapping and filtering modes
-        // These are the defaults, but we'll provide a way to change them with some functions????
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    }
-    else
+    std::vector<TextureData> textures;
+    for (const MaterialTexture& wanted : materialTextures)
     {
-        std::cout
-            << "********************************************************************************" << std::endl
-            << "ERROR IN TEXTURE \"" << filepath << "\"\nwhile loading image at: " << fullFilepath << std::endl
-            << "********************************************************************************" << std::endl;
+        // The registry only loads it if no model has yet
+        textures.push_back(TextureRegistry::Get().Acquire(mFileDirectory + '/' + wanted.filepath,
+                                                          wanted.type));
     }
+    return textures;
+}
 
-    // "After we’re done generating the texture and its corresponding mipmaps,
-    // it is good practice to free the image memory:"
-    stbi_image_free(data);
-
-    // Unbind the texture so OpenGL can do other stuff
-    glBindTexture(GL_TEXTURE_2D, 0);
 
-    return textureId;
 
+/**
+ * RenderScene all the Model's meshes
+ * @param shaders ShaderProgram program used to draw the meshes
+ */
+void Model::Draw(ShaderProgram &shaders)
+{
+    for (unsigned int i = 0; i < mMeshes.size(); i++)
+        mMeshes[i]->Draw(shaders);
 }
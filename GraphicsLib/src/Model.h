@@ -25,6 +25,21 @@
 #include <assimp/postprocess.h>
 
 #include "Mesh.h"// "had to" do this, some weird error on the constructor
+#include "MeshCache.h"
+
+/**
+ * A model's meshes, imported but not on the GPU yet.
+ * Either points into an open mesh cache, or holds
+ * meshes freshly parsed by Assimp.
+ */
+struct ModelData
+{
+    /// The model's up-to-date mesh cache (nullptr if there wasn't one)
+    std::shared_ptr<MeshCache> cache;
+
+    /// The meshes Assimp parsed, when there was no cache
+    std::vector<MeshData> meshes;
+};
 
 class ShaderProgram;
 /**
@@ -37,17 +52,21 @@ private:
     /// All the meshes that are a part of this model
     std::vector<std::shared_ptr<Mesh>> mMeshes;
 
+    /// Bounding box around all the meshes, in model space
+    AABB mBounds;
+
     /// Directory holding the assets so we can load textures
     std::string mFileDirectory;
 
-    /// For optimization, so we don't reload extra textures
-    std::vector<TextureData> mTexturesLoaded;
-
-    void LoadModel(const std::string& fileDirectory);
-    void ProcessNode(aiNode* node, const aiScene* scene);
-    std::shared_ptr<Mesh> ProcessMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<TextureData> LoadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName);
-    unsigned int TextureFromFile(const char* filepath, std::string fileDirectory);
+    void BuildMeshes(const ModelData& data);
+    static bool ImportModel(const std::string& filepath, std::vector<MeshData>& meshes,
+                            std::vector<std::string>& dependencies);
+    static void ProcessNode(aiNode* node, const aiScene* scene, const aiMatrix4x4& parentTransform,
+                            std::vector<MeshData>& meshes);
+    static MeshData ProcessMesh(aiMesh* mesh, const aiScene* scene, const aiMatrix4x4& transform);
+    static void GetMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName,
+                                    std::vector<MaterialTexture>& textures);
+    std::vector<TextureData> LoadTextures(const std::vector<MaterialTexture>& textures);
 
 
 public:
@@ -58,6 +77,8 @@ public:
      */
     explicit Model(const char* filepath);
 
+    Model(const std::string& fileDirectory, const ModelData& data);
+
     /// Default constructor (disabled)
     Model() = delete;
 
@@ -69,8 +90,22 @@ public:
 
     // ****************************************************************
 
+    static ModelData Import(const std::string& fileDirectory);
+
     void Draw(ShaderProgram &shaders);
 
+    /**
+     * Get the meshes that make up this model
+     * @return the meshes that make up this model
+     */
+    const std::vector<std::shared_ptr<Mesh>>& GetMeshes() const { return mMeshes; }
+
+    /**
+     * Get the bounding box around all the meshes, in model space
+     * @return the bounding box of this model
+     */
+    const AABB& GetBounds() const { return mBounds; }
+
 
 
 };
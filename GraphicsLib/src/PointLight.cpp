@@ -3,6 +3,9 @@
  * @author Elijah Gleckler
  */
 
+#include <cmath>
+#include <limits>
+
 #include "PointLight.h"
 #include "ShaderProgram.h"
 
@@ -23,15 +26,99 @@ void PointLight::SetLightingUniforms(ShaderProgram &shaders)
     auto phongColors = GetPhongColors();
     auto attenCoeffs = mAttenuationCoefficients;
 
-    std::string indexStr = "pointLights[" + std::to_string(mShaderIndex) + "]";
+    // Only build the uniform names when we land in
+    // a different program or a different array slot
+    if (mHandlesProgram != &shaders || mHandlesIndex != mShaderIndex)
+    {
+        ResolveUniformHandles(shaders);
+    }
 
     // Set a slew of uniforms in the shaders:
-    shaders.SetVec3Uniform(indexStr + ".position", mPosition);
-    shaders.SetVec3Uniform(indexStr + ".ambient", phongColors.ambient);
-    shaders.SetVec3Uniform(indexStr + ".diffuse", phongColors.diffuse); // darkened
-    shaders.SetVec3Uniform(indexStr + ".specular", phongColors.specular);
-    shaders.set1FUniform(indexStr + ".constant", attenCoeffs.constant);
-    shaders.set1FUniform(indexStr + ".linear", attenCoeffs.linear);
-    shaders.set1FUniform(indexStr + ".quadratic", attenCoeffs.quadratic);
+    shaders.SetUniform(mHandles.position, mPosition);
+    shaders.SetUniform(mHandles.ambient, phongColors.ambient);
+    shaders.SetUniform(mHandles.diffuse, phongColors.diffuse); // darkened
+    shaders.SetUniform(mHandles.specular, phongColors.specular);
+    shaders.SetUniform(mHandles.constant, attenCoeffs.constant);
+    shaders.SetUniform(mHandles.linear, attenCoeffs.linear);
+    shaders.SetUniform(mHandles.quadratic, attenCoeffs.quadratic);
+
+}
+
+
+
+/**
+ * Get the distance past which this light no longer lights anything.
+ *
+ * That's where the attenuation 1/(c + l*d + q*d^2) drops below
+ * POINT_LIGHT_ATTENUATION_CUTOFF, the same cutoff the lighting
+ * shaders use to skip a light, so culling a light beyond its
+ * range never changes the picture.
+ *
+ * @return range of this light in world units
+ */
+float PointLight::GetRange() const
+{
+    float c = mAttenuationCoefficients.constant - 1.0f / POINT_LIGHT_ATTENUATION_CUTOFF;
+    float l = mAttenuationCoefficients.linear;
+    float q = mAttenuationCoefficients.quadratic;
+
+    // Already below the cutoff right at the light
+    if (c >= 0.0f)
+        return 0.0f;
+
+    // Positive root of q*d^2 + l*d + c = 0
+    if (q > 0.0f)
+        return (-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q);
+
+    // Only linear falloff
+    if (l > 0.0f)
+        return -c / l;
+
+    // No falloff at all, so it reaches everywhere
+    return std::numeric_limits<float>::max();
+}
+
+
+
+/**
+ * Pack this light into the layout the lighting shaders read
+ * out of the point light texture buffer.
+ *
+ * @return this light's record for the point light buffer
+ */
+PackedPointLight PointLight::Pack() const
+{
+    const PhongColors& phongColors = GetPhongColors();
+
+    PackedPointLight packed;
+    packed.positionConstant = glm::vec4(mPosition, mAttenuationCoefficients.constant);
+    packed.ambientLinear = glm::vec4(phongColors.ambient, mAttenuationCoefficients.linear);
+    packed.diffuseQuadratic = glm::vec4(phongColors.diffuse, mAttenuationCoefficients.quadratic);
+    packed.specularRange = glm::vec4(phongColors.specular, GetRange());
+
+    return packed;
+}
+
+
+
+/**
+ * Look up the uniforms of this light's slot in the point
+ * light array of a shader program, and remember them.
+ *
+ * @param shaders Shader program to resolve the uniforms in
+ */
+void PointLight::ResolveUniformHandles(const ShaderProgram &shaders)
+{
+    std::string indexStr = "pointLights[" + std::to_string(mShaderIndex) + "]";
+
+    mHandles.position = shaders.GetUniformHandle<glm::vec3>(indexStr + ".position");
+    mHandles.ambient = shaders.GetUniformHandle<glm::vec3>(indexStr + ".ambient");
+    mHandles.diffuse = shaders.GetUniformHandle<glm::vec3>(indexStr + ".diffuse");
+    mHandles.specular = shaders.GetUniformHandle<glm::vec3>(indexStr + ".specular");
+    mHandles.constant = shaders.GetUniformHandle<float>(indexStr + ".constant");
+    mHandles.linear = shaders.GetUniformHandle<float>(indexStr + ".linear");
+    mHandles.quadratic = shaders.GetUniformHandle<float>(indexStr + ".quadratic");
 
+    mHandlesProgram = &shaders;
+    mHandlesIndex = mShaderIndex;
 }
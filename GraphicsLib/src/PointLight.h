@@ -14,6 +14,7 @@
 #define LEARNING_OPENGL__POINTLIGHT_H
 
 #include "LightSource.h"
+#include "ShaderProgram.h"
 #include "lighting_structs.h"
 /**
  * A light source represented by a single point
@@ -34,6 +35,33 @@ private:
     /// array to set its uniforms in. Should be set
     /// before the light is rendered in the lighting pass
     unsigned int mShaderIndex;
+
+    /**
+     * Handles to the uniforms of this light's slot in the
+     * shader's point light array, so we only have to build
+     * the "pointLights[i].field" names once
+     */
+    struct UniformHandles
+    {
+        UniformHandle<glm::vec3> position;
+        UniformHandle<glm::vec3> ambient;
+        UniformHandle<glm::vec3> diffuse;
+        UniformHandle<glm::vec3> specular;
+        UniformHandle<float> constant;
+        UniformHandle<float> linear;
+        UniformHandle<float> quadratic;
+    };
+
+    /// Uniform handles for the program & index below
+    UniformHandles mHandles;
+
+    /// The program the handles were resolved in (nullptr if never)
+    const ShaderProgram* mHandlesProgram = nullptr;
+
+    /// The shader index the handles were resolved for
+    unsigned int mHandlesIndex = 0;
+
+    void ResolveUniformHandles(const ShaderProgram &shaders);
     
 public:
 
@@ -64,20 +92,45 @@ public:
     // Must do this:
     virtual void SetLightingUniforms(ShaderProgram &shaders) override;
 
+    PackedPointLight Pack() const;
+    float GetRange() const;
+
     // ****************************************************************
 
     /**
      * Set the position of this light source
      * @param pos the position of this light source
      */
-    void SetPosition(glm::vec3 pos) { mPosition = pos; }
+    void SetPosition(glm::vec3 pos)
+    {
+        if (pos != mPosition)
+        {
+            mPosition = pos;
+            MarkDirty();
+        }
+    }
 
     /**
      * Set the shader index of the point light so it can
      * properly index into the g-buffer lighting shader
-     * and set the correct uniform struct
+     * and set the correct uniform struct. Moving to a
+     * new slot means the light has to be packed again.
+     */
+    void SetShaderIndex(unsigned int i)
+    {
+        if (i != mShaderIndex)
+        {
+            mShaderIndex = i;
+            MarkDirty();
+        }
+    }
+
+    /**
+     * Get the shader index of the point light, which is
+     * also its slot in the scene's point light buffer
+     * @return the shader index of the point light
      */
-    void SetShaderIndex(unsigned int i) { mShaderIndex = i; }
+    unsigned int GetShaderIndex() const { return mShaderIndex; }
 
 
 
@@ -0,0 +1,185 @@
+/**
+ * @file PointLightBuffer.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "PointLightBuffer.h"
+
+/// Number of RGBA32F texels each light takes up in the buffer
+const unsigned int TEXELS_PER_POINT_LIGHT = sizeof(PackedPointLight) / (4 * sizeof(float));
+
+/// Lights the buffer has room for before it first has to grow
+const unsigned int INITIAL_POINT_LIGHT_CAPACITY = 64;
+
+
+/**
+ * Constructor
+ *
+ * Makes the buffer object and the buffer texture that views it.
+ * Needs a current GL context!
+ */
+PointLightBuffer::PointLightBuffer()
+{
+    // The spec only promises 65536 texels, but most GPUs do way more
+    int maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    mMaxLights = (unsigned int)maxTexels / TEXELS_PER_POINT_LIGHT;
+
+    glGenBuffers(1, &mBuffer);
+    glGenTextures(1, &mTexture);
+
+    // Make some room up front
+    mCapacity = INITIAL_POINT_LIGHT_CAPACITY;
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, mCapacity * sizeof(PackedPointLight), nullptr, GL_DYNAMIC_DRAW);
+
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+
+
+/**
+ * Destructor
+ */
+PointLightBuffer::~PointLightBuffer()
+{
+    glDeleteTextures(1, &mTexture);
+    glDeleteBuffers(1, &mBuffer);
+}
+
+
+
+/**
+ * Set how many lights are in the buffer. New lights start
+ * out zeroed (black, so they light nothing) until they're Set.
+ *
+ * @param numLights number of lights the scene has
+ */
+void PointLightBuffer::Resize(unsigned int numLights)
+{
+    if (numLights > mMaxLights)
+    {
+        std::cout << "WARNING: " << numLights << " point lights requested, but this GPU's "
+                  << "buffer textures only fit " << mMaxLights << ". Extra lights are dropped." << std::endl;
+        numLights = mMaxLights;
+    }
+
+    auto oldSize = (unsigned int)mLights.size();
+    mLights.resize(numLights);
+
+    if (numLights > oldSize)
+    {
+        MarkDirty(oldSize, numLights);
+    }
+}
+
+
+
+/**
+ * Set the data of one light. Only actually marks it for
+ * upload if something about the light changed.
+ *
+ * @param index index of the light in the buffer
+ * @param light the light's packed data
+ */
+void PointLightBuffer::Set(unsigned int index, const PackedPointLight &light)
+{
+    if (index >= mLights.size())
+        return;
+
+    if (std::memcmp(&mLights[index], &light, sizeof(PackedPointLight)) != 0)
+    {
+        mLights[index] = light;
+        MarkDirty(index, index + 1);
+    }
+}
+
+
+
+/**
+ * Grow the dirty range to cover some more lights
+ *
+ * @param begin first light that changed
+ * @param end one past the last light that changed
+ */
+void PointLightBuffer::MarkDirty(unsigned int begin, unsigned int end)
+{
+    if (mDirtyBegin == mDirtyEnd)
+    {
+        mDirtyBegin = begin;
+        mDirtyEnd = end;
+    }
+    else
+    {
+        mDirtyBegin = std::min(mDirtyBegin, begin);
+        mDirtyEnd = std::max(mDirtyEnd, end);
+    }
+}
+
+
+
+/**
+ * Send every light that changed since the last upload to
+ * the GPU, as one contiguous copy. Does nothing at all when
+ * no light changed, which is the usual case for a static scene.
+ *
+ * If the lights outgrew the GPU buffer, it gets re-made
+ * (twice as big) and filled in one go instead.
+ */
+void PointLightBuffer::Upload()
+{
+    auto numLights = (unsigned int)mLights.size();
+
+    if (numLights > mCapacity)
+    {
+        while (mCapacity < numLights)
+            mCapacity *= 2;
+
+        glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, mCapacity * sizeof(PackedPointLight), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, numLights * sizeof(PackedPointLight), mLights.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        mDirtyBegin = mDirtyEnd = 0;
+        return;
+    }
+
+    // Lights removed since they were marked dirty don't need uploading
+    mDirtyEnd = std::min(mDirtyEnd, numLights);
+    if (mDirtyBegin >= mDirtyEnd)
+    {
+        mDirtyBegin = mDirtyEnd = 0;
+        return;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER,
+                    mDirtyBegin * sizeof(PackedPointLight),
+                    (mDirtyEnd - mDirtyBegin) * sizeof(PackedPointLight),
+                    &mLights[mDirtyBegin]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    mDirtyBegin = mDirtyEnd = 0;
+}
+
+
+
+/**
+ * Bind the buffer texture so shaders can read the lights
+ *
+ * @param textureUnit texture unit to bind to (0 for GL_TEXTURE0, etc.)
+ */
+void PointLightBuffer::Bind(unsigned int textureUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file PointLightBuffer.h
+ * @author Elijah Gleckler
+ *
+ * All the point lights of a scene, packed into one
+ * texture buffer that the lighting shaders index into.
+ *
+ * Setting every light through uniforms was 7 glUniform calls
+ * per light per frame, and uniform arrays capped us at 32 lights.
+ * This keeps a CPU copy of the buffer laid out exactly like the
+ * GPU one, remembers which range of lights changed since the last
+ * upload, and sends just that range with one glBufferSubData.
+ * The scene only re-packs lights that say they changed (see
+ * LightSource::IsDirty), so a static scene costs no CPU pass at all.
+ *
+ * The CPU copy is an array of whole records (AoS) rather than
+ * separate position/color/attenuation arrays (SoA) on purpose.
+ * Both things that read it want whole records: the upload copies
+ * records straight into the buffer, and LightClusterGrid::Build
+ * reads each light's position and range together. An SoA copy would
+ * just have to be interleaved back into this layout before every
+ * upload, moving the per-frame pass instead of removing it.
+ *
+ * Shaders read it as a samplerBuffer with four RGBA32F texels
+ * per light--see PackedPointLight in lighting_structs.h.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_POINTLIGHTBUFFER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_POINTLIGHTBUFFER_H
+
+#include <vector>
+
+#include "lighting_structs.h"
+
+/**
+ * All the point lights of a scene, packed into a texture buffer
+ */
+class PointLightBuffer
+{
+private:
+
+    /// CPU copy of the buffer, one record per light
+    std::vector<PackedPointLight> mLights;
+
+    /// GL id of the buffer object holding the lights
+    unsigned int mBuffer;
+
+    /// GL id of the buffer texture the shaders sample
+    unsigned int mTexture;
+
+    /// How many lights the GPU buffer has room for right now
+    unsigned int mCapacity = 0;
+
+    /// Most lights a buffer texture can hold on this GPU
+    unsigned int mMaxLights;
+
+    /// First light that changed since the last upload
+    unsigned int mDirtyBegin = 0;
+
+    /// One past the last light that changed since the last upload
+    unsigned int mDirtyEnd = 0;
+
+    void MarkDirty(unsigned int begin, unsigned int end);
+
+public:
+
+    PointLightBuffer();
+
+    /// Copy constructor (disabled)
+    PointLightBuffer(const PointLightBuffer &) = delete;
+
+    /// Assignment operator
+    void operator=(const PointLightBuffer &) = delete;
+
+    ~PointLightBuffer();
+
+    // ****************************************************************
+
+    void Resize(unsigned int numLights);
+    void Set(unsigned int index, const PackedPointLight& light);
+    void Upload();
+    void Bind(unsigned int textureUnit) const;
+
+    /**
+     * Get the number of lights in the buffer
+     * @return the number of lights in the buffer
+     */
+    unsigned int Size() const { return (unsigned int)mLights.size(); }
+
+    /**
+     * Get the CPU copy of all the lights in the buffer
+     * @return the CPU copy of all the lights in the buffer
+     */
+    const std::vector<PackedPointLight>& GetLights() const { return mLights; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_POINTLIGHTBUFFER_H
@@ -20,6 +20,19 @@ enum QuadType
 #include "Mesh.h"
 #include "quad_vertices.h"
 
+/**
+ * Bounding box of a quad's vertices, which are always -1.0 to 1.0
+ * @param depth half-depth of the quad (0 for 2D, 1 for 3D)
+ * @return the bounding box of the quad, in model space
+ */
+inline AABB QuadBounds(float depth)
+{
+    AABB bounds;
+    bounds.min = glm::vec3(-1.0f, -1.0f, -depth);
+    bounds.max = glm::vec3(1.0f, 1.0f, depth);
+    return bounds;
+}
+
 /**
  * A simplified mesh that is just a quad.
  * Quads will be -1.0 to 1.0 in model space
@@ -36,7 +49,7 @@ public:
      * @param textures List of all this quad's textures
      */
     Quad(glm::vec2 dimensions, std::vector<TextureData> textures)
-        : Mesh(GetSquareVertices(), SquareIndices(), textures) {}
+        : Mesh(GetSquareVertices(), SquareIndices(), textures, QuadBounds(0.0f)) {}
 
 
     /**
@@ -45,7 +58,7 @@ public:
      * @param textures List of all this quad's textures
      */
     Quad(glm::vec3 dimensions, std::vector<TextureData> textures)
-        : Mesh(GetCubeVertices(), CubeIndices(), textures) {}
+        : Mesh(GetCubeVertices(), CubeIndices(), textures, QuadBounds(1.0f)) {}
 
     /// Default constructor (disabled)
     Quad() = delete;
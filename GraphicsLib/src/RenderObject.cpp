@@ -4,12 +4,12 @@
  */
 
 #include <iostream>
-#include <gtc/matrix_transform.hpp>
 
 #include "RenderObject.h"
 #include "ShaderProgram.h"
 #include "Model.h"
 #include "LightSource.h"
+#include "TransformSystem.h"
 
 /// Maximum number of light sources each shader should
 /// deal with at a time.
@@ -19,6 +19,17 @@ const std::string MODEL_MAT_UNIFORM_NAME = "modelMat";  ///< Naming convention f
 const std::string NORMAL_MAT_UNIFORM_NAME = "normalMat"; ///< Naming convention for normal matrix in shaders
 
 
+/**
+ * Get the transform system every RenderObject keeps its transform in
+ * @return the transform system
+ */
+static TransformSystem& Transforms()
+{
+    static TransformSystem transforms;
+    return transforms;
+}
+
+
 /**
  * Constructor
  *
@@ -37,9 +48,55 @@ const std::string NORMAL_MAT_UNIFORM_NAME = "normalMat"; ///< Naming convention
 RenderObject::RenderObject(std::shared_ptr<Model> model, std::shared_ptr<ShaderProgram> shaders)
     : mModel(std::move(model)), mShaders(std::move(shaders))
 {
-    // Default model matrix at the origin
+    // Default transform at the origin
     // with scale 1.0 and no rotation
-    UpdateModelMatrix();
+    mTransformId = Transforms().Create(mModel != nullptr ? mModel->GetBounds() : AABB());
+}
+
+
+
+/**
+ * Destructor. Gives the transform back to the transform system.
+ */
+RenderObject::~RenderObject()
+{
+    Transforms().Destroy(mTransformId);
+}
+
+
+
+/**
+ * Rebuild the model & normal matrices (and world bounds) of every
+ * RenderObject that moved, rotated or scaled since the last call.
+ * Objects that didn't change are skipped entirely.
+ *
+ * Call this once a frame, before rendering.
+ */
+void RenderObject::UpdateTransforms()
+{
+    Transforms().Update();
+}
+
+
+
+/**
+ * Get how many objects' transforms the last UpdateTransforms() rebuilt
+ * @return number of transforms rebuilt
+ */
+unsigned int RenderObject::GetNumTransformsUpdated()
+{
+    return Transforms().GetNumUpdated();
+}
+
+
+
+/**
+ * Get the transform ids of the objects the last UpdateTransforms() rebuilt
+ * @return ids of the transforms rebuilt (see GetTransformId())
+ */
+const std::vector<unsigned int> &RenderObject::GetUpdatedTransformIds()
+{
+    return Transforms().GetUpdatedIds();
 }
 
 
@@ -55,6 +112,7 @@ RenderObject::RenderObject(std::shared_ptr<Model> model, std::shared_ptr<ShaderP
  * The g-buffer or someone else should do the rest...
  *
  * Makes sure this RenderObject is in the right place in the final scene!
+ * Uses the model matrix as of the last UpdateTransforms() call.
  *
  * @param shaders Currently bound shader program in which to set the uniforms
  * @param viewMatrix View matrix so we can compute the normal matrix
@@ -64,17 +122,9 @@ void RenderObject::SetTransformationUniforms(ShaderProgram &shaders)
 {
     if (mModel != nullptr)
     {
-        // Update the model matrix based on our current
-        // position, rotation, and scale
-        UpdateModelMatrix();
-
-        // Model-View matrix and Normal Matrix
-        // glm::mat4 modelViewMat = viewMatrix * mModelMatrix;
-        glm::mat3 normalMat = glm::mat3(glm::transpose(glm::inverse(mModelMatrix)));
-
         // Set the transformation uniforms
-        shaders.SetMat4Uniform(MODEL_MAT_UNIFORM_NAME, mModelMatrix);
-        shaders.setMat3Uniform(NORMAL_MAT_UNIFORM_NAME, normalMat);
+        shaders.SetMat4Uniform(MODEL_MAT_UNIFORM_NAME, GetModelMatrix());
+        shaders.setMat3Uniform(NORMAL_MAT_UNIFORM_NAME, GetNormalMatrix());
 
     }
     else
@@ -103,30 +153,61 @@ void RenderObject::Draw(ShaderProgram &shaders)
 
 
 /**
- * Updates the model matrix based on the current
- * data members storing the position, rotation,
- * and scale of the object.
+ * Get the model matrix of this object, as of
+ * the last UpdateTransforms() call.
+ *
+ * @return the model matrix of this object
+ */
+const glm::mat4& RenderObject::GetModelMatrix() const
+{
+    return Transforms().GetModelMatrix(mTransformId);
+}
+
+
+
+/**
+ * Get the normal matrix of this object, as of the
+ * last UpdateTransforms() call. Keeps normals
+ * perpendicular under non-uniform scaling.
+ *
+ * @return inverse transpose of the model matrix's upper 3x3
+ */
+const glm::mat3& RenderObject::GetNormalMatrix() const
+{
+    return Transforms().GetNormalMatrix(mTransformId);
+}
+
+
+
+/**
+ * Get the bounding box of this object in world space,
+ * as of the last UpdateTransforms() call.
+ *
+ * @return bounding box of the model, moved by the model matrix
  */
-void RenderObject::UpdateModelMatrix()
+const AABB& RenderObject::GetWorldBounds() const
 {
-    glm::mat4 modelMat(1.0f);
-    modelMat = glm::translate(modelMat, mPosition);
-    modelMat = glm::rotate(modelMat, mRotation.first, mRotation.second);
-    modelMat = glm::scale(modelMat, mScale);
-    mModelMatrix = modelMat;
+    if (mModel == nullptr)
+    {
+        throw std::runtime_error("Be careful! Cannot cull an instance with uninitialized assets.\n"
+                                 "(RenderObject::GetWorldBounds)");
+    }
+
+    return Transforms().GetWorldBounds(mTransformId);
 }
 
 
 
 /**
  * Set the position of this object
- * in the world. Adjusts the member model matrix.
+ * in the world. The model matrix catches
+ * up on the next UpdateTransforms().
  *
  * @param pos New position in world space
  */
 void RenderObject::SetPosition(glm::vec3 pos)
 {
-    mPosition = pos;
+    Transforms().SetPosition(mTransformId, pos);
 }
 
 
@@ -138,9 +219,7 @@ void RenderObject::SetPosition(glm::vec3 pos)
  */
 void RenderObject::SetRotation(float rads, glm::vec3 axis)
 {
-    auto axisNorm = glm::normalize(axis);
-    auto rotation = std::pair<float, glm::vec3>(rads, axisNorm);
-    mRotation = rotation;
+    Transforms().SetRotation(mTransformId, rads, glm::normalize(axis));
 }
 
 
@@ -154,7 +233,7 @@ void RenderObject::SetRotation(float rads, glm::vec3 axis)
  */
 void RenderObject::SetScale(glm::vec3 scale)
 {
-    mScale = scale;
+    Transforms().SetScale(mTransformId, scale);
 }
 
 
@@ -169,7 +248,7 @@ void RenderObject::SetScale(glm::vec3 scale)
  */
 void RenderObject::SetScale(float scale)
 {
-    mScale = glm::vec3(scale);
+    Transforms().SetScale(mTransformId, glm::vec3(scale));
 }
 
 
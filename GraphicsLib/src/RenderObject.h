@@ -15,14 +15,22 @@
  * done manually, after intialization, for now.
  * All object are intially located at (0,0,0) and
  * have scale 1.0 by default.
+ *
+ * The transforms themselves are kept in a shared
+ * TransformSystem, so objects that don't move
+ * cost nothing per frame. Call UpdateTransforms()
+ * once a frame, after moving things around.
  */
 
 #ifndef LEARNING_OPENGL__RENDERDATA_H
 #define LEARNING_OPENGL__RENDERDATA_H
 
 #include <memory>
+#include <vector>
 #include <glm.hpp>
 
+#include "bounds.h"
+
 class Model;
 class ShaderProgram;
 class PointLight;
@@ -39,26 +47,11 @@ private:
     /// ShaderProgram program this object will follow.
     std::shared_ptr<ShaderProgram> mShaders = nullptr;
 
-    /// Model matrix for this object. Make sure to adjust this
-    /// before rendering to make sure your object is in the right
-    /// place, has the right rotation, and is the right size!
-    glm::mat4 mModelMatrix = glm::mat4(1.0f);
-
-    /// Position in world space
-    glm::vec3 mPosition = glm::vec3(0.0f);
-
-    /// Rotation angle/axis pair of the object.
-    /// I decided it would be good to enforce the angle/axis coupling
-    /// ANGLE IN RADIANS! (you can use glm::radians()...)
-    /// Would be nice if it were normalized... SetRotation() does that...
-    std::pair<float, glm::vec3> mRotation =
-            std::pair<float, glm::vec3>(0.0, glm::vec3(1.0f, 0.0f, 0.0f));
-
-    /// Scale of the object in world space. Sizes the model up/down
-    /// or stretches it all silly-like
-    glm::vec3 mScale = glm::vec3(1.0f);
-
-    void UpdateModelMatrix();
+    /// Id of this object's transform in the TransformSystem.
+    /// Position, rotation & scale live there, along with the
+    /// model/normal matrices, which only get rebuilt when they
+    /// change (see UpdateTransforms())
+    unsigned int mTransformId;
 
 public:
 
@@ -73,11 +66,34 @@ public:
     /// Assignment operator
     void operator=(const RenderObject &) = delete;
 
+    ~RenderObject();
+
     // ****************************************************************
 
+    static void UpdateTransforms();
+    static unsigned int GetNumTransformsUpdated();
+    static const std::vector<unsigned int>& GetUpdatedTransformIds();
+
     void SetTransformationUniforms(ShaderProgram &shaders);
     void Draw(ShaderProgram &shaders);
 
+    const AABB& GetWorldBounds() const;
+    const glm::mat3& GetNormalMatrix() const;
+    const glm::mat4& GetModelMatrix() const;
+
+    /**
+     * Get the 3D model of this object
+     * @return the 3D model of this object
+     */
+    const std::shared_ptr<Model>& GetModel() const { return mModel; }
+
+    /**
+     * Get the id of this object's transform. Ids are small and
+     * get reused, so they make good indices into a table of transforms.
+     * @return the transform id
+     */
+    unsigned int GetTransformId() const { return mTransformId; }
+
     void SetPosition(glm::vec3 pos);
     void SetRotation(float rads, glm::vec3 axis);
     void SetScale(glm::vec3 scale);
@@ -5,11 +5,56 @@
 
 #include "RenderObjectFactory.h"
 
+#include <future>
 #include <nlohmann/json.hpp>
 
 #include "RenderObject.h"
 #include "ShaderProgram.h"
 #include "Model.h"
+#include "ThreadPool.h"
+
+
+/**
+ * Load a bunch of models all at once, in parallel, so that
+ * later Create() calls find them already loaded.
+ *
+ * The slow part of loading a model (Assimp parsing and building
+ * the vertices, or mapping its mesh cache) runs on the shared
+ * ThreadPool, all models at the same time. Only making the GL
+ * buffers & textures happens back here, on the calling thread,
+ * which must be the one with the GL context.
+ *
+ * Models that are already loaded (or listed twice) are only
+ * loaded once.
+ *
+ * @param modelDirectories model directories, like Create() takes
+ */
+void RenderObjectFactory::PreloadModels(const std::vector<std::string> &modelDirectories)
+{
+    std::map<std::string, std::future<ModelData>> imports;
+    for (const std::string& modelDirectory : modelDirectories)
+    {
+        if (mModelsInUse.count(modelDirectory) != 0 || imports.count(modelDirectory) != 0)
+            continue;
+
+        auto modelFilepath = mResourceDir + "/models/" + modelDirectory;
+        imports.emplace(modelDirectory, ThreadPool::Shared().Submit([modelFilepath]() {
+            return Model::Import(modelFilepath);
+        }));
+    }
+
+    // Upload each model as its import finishes... well, in order,
+    // but the rest keep importing while we upload this one
+    for (auto& import : imports)
+    {
+        auto modelFilepath = mResourceDir + "/models/" + import.first;
+        ModelData data = import.second.get();
+        mModelsInUse.emplace(import.first, std::make_shared<Model>(modelFilepath, data));
+    }
+}
+
+
+
 
 /**
  * Create a brand-new render object from the provided assets.
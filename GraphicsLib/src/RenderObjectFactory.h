@@ -20,6 +20,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 #include <nlohmann/json_fwd.hpp>
 
 // for clarity... recommended by nlohmann
@@ -76,6 +77,8 @@ public:
 
     // ****************************************************************
 
+    void PreloadModels(const std::vector<std::string>& modelDirectories);
+
     std::unique_ptr<RenderObject> Create(const std::string& modelDirectory,
                         const std::string& vertShaderFile,
                         const std::string& fragShaderFile);
@@ -0,0 +1,403 @@
+/**
+ * @file RenderQueue.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cstring>
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+#include "Mesh.h"
+#include "RenderObject.h"
+
+/// Bits of the sort key for the shader program id
+const unsigned int SORT_KEY_PROGRAM_BITS = 8;
+
+/// Bits of the sort key for the material id
+const unsigned int SORT_KEY_MATERIAL_BITS = 16;
+
+/// Bits of the sort key for the mesh id
+const unsigned int SORT_KEY_MESH_BITS = 14;
+
+/// Bits of the sort key for the mesh's level of detail
+const unsigned int SORT_KEY_LOD_BITS = 2;
+
+/// Bits of the sort key for the view depth
+const unsigned int SORT_KEY_DEPTH_BITS = 24;
+
+/// Where the depth bits start in the key
+const unsigned int SORT_KEY_DEPTH_SHIFT = 0;
+
+/// Where the LOD bits start in the key
+const unsigned int SORT_KEY_LOD_SHIFT = SORT_KEY_DEPTH_SHIFT + SORT_KEY_DEPTH_BITS;
+
+/// Where the mesh bits start in the key
+const unsigned int SORT_KEY_MESH_SHIFT = SORT_KEY_LOD_SHIFT + SORT_KEY_LOD_BITS;
+
+/// Where the material bits start in the key
+const unsigned int SORT_KEY_MATERIAL_SHIFT = SORT_KEY_MESH_SHIFT + SORT_KEY_MESH_BITS;
+
+/// Where the program bits start in the key
+const unsigned int SORT_KEY_PROGRAM_SHIFT = SORT_KEY_MATERIAL_SHIFT + SORT_KEY_MATERIAL_BITS;
+
+
+/**
+ * Forget all the draws of the last frame.
+ * (Program ids stick around, so they stay stable between frames.)
+ */
+void RenderQueue::Clear()
+{
+    mItems.clear();
+    mKeys.clear();
+    mRanges.clear();
+    mDepthStats = RenderQueueStats();
+}
+
+
+
+/**
+ * Queue up one draw of a mesh of an object
+ *
+ * @param program shader program to draw with
+ * @param mesh mesh to draw
+ * @param object object the mesh belongs to (for its transforms)
+ * @param viewDepth distance in front of the camera, for front-to-back order
+ * @param lod level of detail of the mesh to draw
+ * @param ranges ranges of the mesh's indices to draw, if not all of the LOD
+ *               (like the clusters in view--see ClusterCulling.h)
+ * @param numRanges number of index ranges
+ */
+void RenderQueue::Push(ShaderProgram &program, Mesh *mesh, RenderObject *object, float viewDepth,
+                       unsigned int lod, const MeshLOD *ranges, unsigned int numRanges)
+{
+    auto programId = mProgramIds.emplace(&program, (uint32_t)mProgramIds.size()).first->second;
+
+    // Positive floats sort the same as their bit patterns,
+    // so the top bits of the float make a fine depth key
+    float depth = viewDepth > 0.0f ? viewDepth : 0.0f;
+    uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    depthBits >>= (32 - SORT_KEY_DEPTH_BITS);
+
+    auto field = [](uint32_t value, unsigned int bits, unsigned int shift) {
+        return ((uint64_t)value & ((1ull << bits) - 1)) << shift;
+    };
+
+    uint64_t key = field(programId, SORT_KEY_PROGRAM_BITS, SORT_KEY_PROGRAM_SHIFT) |
+                   field(mesh->GetMaterialId(), SORT_KEY_MATERIAL_BITS, SORT_KEY_MATERIAL_SHIFT) |
+                   field(mesh->GetSortId(), SORT_KEY_MESH_BITS, SORT_KEY_MESH_SHIFT) |
+                   field(lod, SORT_KEY_LOD_BITS, SORT_KEY_LOD_SHIFT) |
+                   field(depthBits, SORT_KEY_DEPTH_BITS, SORT_KEY_DEPTH_SHIFT);
+
+    mItems.push_back({&program, mesh, object, programId, mesh->GetMaterialId(), mesh->GetSortId(), lod,
+                      (uint32_t)mRanges.size(), numRanges});
+    mRanges.insert(mRanges.end(), ranges, ranges + numRanges);
+    mKeys.push_back(key);
+}
+
+
+
+/**
+ * Sort the queued draws by their keys.
+ *
+ * LSD radix sort, a byte at a time. Bytes that are the same
+ * for every key (like the program byte, when there's only one
+ * program) are skipped, since that pass wouldn't move anything.
+ */
+void RenderQueue::Sort()
+{
+    auto count = (uint32_t)mKeys.size();
+    mOrder.resize(count);
+    mOrderScratch.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        mOrder[i] = i;
+
+    for (unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t histogram[256] = {};
+        for (uint32_t i = 0; i < count; ++i)
+            histogram[(mKeys[i] >> shift) & 0xFF]++;
+
+        // Every key has the same byte here, nothing to do
+        if (count == 0 || histogram[(mKeys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        // Counts -> starting offsets
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram)
+        {
+            uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        // Stable scatter, in the current order
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t item = mOrder[i];
+            mOrderScratch[histogram[(mKeys[item] >> shift) & 0xFF]++] = item;
+        }
+        mOrder.swap(mOrderScratch);
+    }
+
+    mInstancesUploaded = false;
+}
+
+
+
+/**
+ * Write out the transforms in sorted order, so each run's
+ * instances sit next to each other, and upload them.
+ * (Packed meshes need their positions unpacked, too.)
+ * Only happens once per Sort, however many times it's submitted.
+ */
+void RenderQueue::UploadInstances()
+{
+    if (mInstancesUploaded)
+        return;
+
+    mInstanceData.resize(mOrder.size());
+    for (unsigned int i = 0; i < mOrder.size(); ++i)
+    {
+        const Item& item = mItems[mOrder[i]];
+        mInstanceData[i].modelMat = item.object->GetModelMatrix() * item.mesh->GetPositionTransform();
+        mInstanceData[i].normalMat = item.object->GetNormalMatrix();
+    }
+    mInstanceBuffer.Upload(mInstanceData);
+    mInstancesUploaded = true;
+}
+
+
+
+/**
+ * Find the end of the run of draws starting at an item: the
+ * items right after it with the same program, mesh and LOD,
+ * which all go in one instanced draw. (Items with index ranges
+ * of their own are always alone.)
+ *
+ * @param first index (in sorted order) of the run's first item
+ * @return index one past the run's last item
+ */
+unsigned int RenderQueue::FindRunEnd(unsigned int first) const
+{
+    const Item& item = mItems[mOrder[first]];
+    if (item.numRanges > 0)
+        return first + 1;
+
+    unsigned int last = first + 1;
+    while (last < mOrder.size())
+    {
+        const Item& next = mItems[mOrder[last]];
+        if (next.programId != item.programId || next.meshId != item.meshId || next.lod != item.lod ||
+            next.numRanges > 0)
+            break;
+        ++last;
+    }
+    return last;
+}
+
+
+
+/**
+ * Add the draws of an item to the mMultiDraw vectors:
+ * its index ranges, or its whole LOD if it has none
+ *
+ * @param item the item
+ */
+void RenderQueue::AddMultiDraw(const Item &item)
+{
+    if (item.numRanges == 0)
+    {
+        MeshDrawRange range = item.mesh->GetDrawRange(item.lod);
+        mMultiDrawCounts.push_back(range.count);
+        mMultiDrawIndices.push_back(range.indices);
+        mMultiDrawBaseVertices.push_back(range.baseVertex);
+        return;
+    }
+
+    for (unsigned int i = item.firstRange; i < item.firstRange + item.numRanges; ++i)
+    {
+        MeshDrawRange range = item.mesh->GetIndexRange(mRanges[i].firstIndex, mRanges[i].numIndices);
+        mMultiDrawCounts.push_back(range.count);
+        mMultiDrawIndices.push_back(range.indices);
+        mMultiDrawBaseVertices.push_back(range.baseVertex);
+    }
+}
+
+
+
+/**
+ * Gather a lone draw and the lone draws after it that can go in
+ * the same multi-draw call into the mMultiDraw vectors.
+ *
+ * Draws merge when they'd bind exactly the same state and read the
+ * same instance transform: same program, textures, vertex array,
+ * index type, object, and position transform.
+ *
+ * @param first index (in sorted order) of the first item
+ * @param runEnd end of the first item's run (see FindRunEnd)
+ * @return index one past the last item gathered
+ */
+unsigned int RenderQueue::GatherMultiDraw(unsigned int first, unsigned int runEnd)
+{
+    mMultiDrawCounts.clear();
+    mMultiDrawIndices.clear();
+    mMultiDrawBaseVertices.clear();
+
+    const Item& item = mItems[mOrder[first]];
+    unsigned int indexType = item.mesh->GetDrawRange(item.lod).indexType;
+    AddMultiDraw(item);
+
+    // Instanced runs stay instanced
+    if (runEnd - first != 1)
+        return runEnd;
+
+    unsigned int last = runEnd;
+    while (last < mOrder.size())
+    {
+        const Item& next = mItems[mOrder[last]];
+        if (next.programId != item.programId || next.materialId != item.materialId ||
+            next.object != item.object || next.mesh->GetVertexArray() != item.mesh->GetVertexArray() ||
+            next.mesh->GetPositionTransform() != item.mesh->GetPositionTransform())
+            break;
+
+        if (next.mesh->GetDrawRange(next.lod).indexType != indexType || FindRunEnd(last) != last + 1)
+            break;
+
+        AddMultiDraw(next);
+        ++last;
+    }
+    return last;
+}
+
+
+
+/**
+ * Issue the draw call for the draws GatherMultiDraw just gathered,
+ * with the right vertex array (and everything else) already bound
+ *
+ * @param item the first item gathered
+ * @param first index (in sorted order) of the first item
+ * @param runEnd end of the first item's run (see FindRunEnd)
+ * @param stats stats to count the draw in
+ */
+void RenderQueue::DrawGathered(const Item &item, unsigned int first, unsigned int runEnd, RenderQueueStats &stats)
+{
+    unsigned int indexType = item.mesh->GetDrawRange(item.lod).indexType;
+    if (mMultiDrawCounts.size() > 1)
+    {
+        // Not instanced, so every draw reads the first item's transform
+        mInstanceBuffer.BindAttributes(first);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, mMultiDrawCounts.data(), indexType,
+                                      mMultiDrawIndices.data(), (GLsizei)mMultiDrawCounts.size(),
+                                      mMultiDrawBaseVertices.data());
+        stats.mergedDraws += (unsigned int)mMultiDrawCounts.size() - 1;
+    }
+    else
+    {
+        MeshDrawRange range = {mMultiDrawCounts[0], indexType, mMultiDrawIndices[0], mMultiDrawBaseVertices[0]};
+        item.mesh->DrawInstanced(mInstanceBuffer, first, runEnd - first, range);
+    }
+    stats.drawCalls++;
+}
+
+
+
+/**
+ * Draw everything in the queue, in sorted order.
+ *
+ * Runs of the same program, material, mesh and LOD become one instanced
+ * draw, lone draws of one object's meshes with the same material become
+ * one multi-draw, and programs, textures & vertex arrays are only bound
+ * when they actually change. Call Sort() first!
+ */
+void RenderQueue::Submit()
+{
+    mStats = RenderQueueStats();
+    mStats.items = mItems.size();
+    UploadInstances();
+
+    const Item* bound = nullptr;
+    unsigned int boundVertexArray = 0;
+
+    unsigned int first = 0;
+    while (first < mOrder.size())
+    {
+        const Item& item = mItems[mOrder[first]];
+
+        unsigned int runEnd = FindRunEnd(first);
+        unsigned int last = GatherMultiDraw(first, runEnd);
+
+        // Bind only what changed. A new program needs its
+        // samplers set again, so it rebinds the material too
+        bool programChanged = (bound == nullptr || bound->programId != item.programId);
+        if (programChanged)
+        {
+            item.program->use();
+            mStats.programChanges++;
+        }
+        if (programChanged || bound->materialId != item.materialId)
+        {
+            item.mesh->BindTextures(*item.program);
+            mStats.materialChanges++;
+        }
+        if (boundVertexArray != item.mesh->GetVertexArray())
+        {
+            item.mesh->BindVertexArray();
+            boundVertexArray = item.mesh->GetVertexArray();
+            mStats.meshChanges++;
+        }
+        bound = &item;
+
+        DrawGathered(item, first, runEnd, mStats);
+        first = last;
+    }
+
+    glBindVertexArray(0);
+}
+
+
+
+/**
+ * Draw everything in the queue depth only, in the same order as Submit,
+ * all with one program: no textures get bound, and each mesh draws from
+ * its depth-only vertex array (see MeshBuffer.h). Draws get batched
+ * just like Submit batches them. Call Sort() first!
+ *
+ * Turning off color writes is up to the caller.
+ *
+ * @param depthProgram shader program that only transforms positions
+ *                     (it reads the same instance attributes)
+ */
+void RenderQueue::SubmitDepth(ShaderProgram &depthProgram)
+{
+    mDepthStats = RenderQueueStats();
+    mDepthStats.items = mItems.size();
+    UploadInstances();
+
+    depthProgram.use();
+    mDepthStats.programChanges++;
+    unsigned int boundVertexArray = 0;
+
+    unsigned int first = 0;
+    while (first < mOrder.size())
+    {
+        const Item& item = mItems[mOrder[first]];
+
+        unsigned int runEnd = FindRunEnd(first);
+        unsigned int last = GatherMultiDraw(first, runEnd);
+
+        if (boundVertexArray != item.mesh->GetDepthVertexArray())
+        {
+            item.mesh->BindDepthVertexArray();
+            boundVertexArray = item.mesh->GetDepthVertexArray();
+            mDepthStats.meshChanges++;
+        }
+
+        DrawGathered(item, first, runEnd, mDepthStats);
+        first = last;
+    }
+
+    glBindVertexArray(0);
+}
@@ -0,0 +1,193 @@
+/**
+ * @file RenderQueue.h
+ * @author Elijah Gleckler
+ *
+ * Collects every draw of a frame, sorts them so the GL
+ * state changes as little as possible, and submits them.
+ *
+ * Each draw gets a packed 64-bit sort key:
+ *
+ *   | program (8) | material (16) | mesh/VAO (14) | LOD (2) | depth (24) |
+ *
+ * so sorting the keys groups draws by shader program first,
+ * then by texture set, then by vertex array and level of detail,
+ * and finally front-to-back within those (so early-z gets to
+ * reject more). Copies of the same mesh at the same LOD end up
+ * next to each other, which makes them one instanced draw.
+ *
+ * Every mesh lives in a shared MeshBuffer, so meshes of the same
+ * vertex layout share a vertex array, too. Lone draws of different
+ * meshes of one object with the same textures (like the pieces of
+ * a building model) get merged into one glMultiDrawElementsBaseVertex.
+ * (GL 3.3 has no gl_DrawID, so merged draws have to share their
+ * transform--that's why it's only meshes of the same object.)
+ * Draws can also be of just a few ranges of a mesh's indices, like
+ * the parts and clusters of it that are in view (see ClusterCulling.h).
+ * Those go out as one multi-draw too, but never get instanced.
+ *
+ * The same sorted draws can go out twice in a frame: first depth
+ * only, with one program and the meshes' depth-only vertex arrays
+ * (see SubmitDepth), then for real.
+ *
+ * Programs get small ids the first time the queue sees them, so
+ * they fit in their bits of the key. Meshes carry their own small
+ * ids (see Mesh::GetSortId and Mesh::GetMaterialId), so a mesh made
+ * where a destroyed one used to be never inherits the old one's ids.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_RENDERQUEUE_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_RENDERQUEUE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "InstanceBuffer.h"
+
+class ShaderProgram;
+class Mesh;
+class RenderObject;
+struct MeshLOD;
+
+/**
+ * What submitting the queue took on the last frame
+ */
+struct RenderQueueStats
+{
+    /// Draws pushed into the queue
+    unsigned int items = 0;
+
+    /// Instanced draw calls the items got batched into
+    unsigned int drawCalls = 0;
+
+    /// Draws (or index ranges) that got folded into another's multi-draw call
+    unsigned int mergedDraws = 0;
+
+    /// Times a different shader program got bound
+    unsigned int programChanges = 0;
+
+    /// Times a different set of textures got bound
+    unsigned int materialChanges = 0;
+
+    /// Times a different vertex array got bound
+    unsigned int meshChanges = 0;
+
+    /**
+     * Get the total number of state changes
+     * @return program + material + mesh changes
+     */
+    unsigned int StateChanges() const { return programChanges + materialChanges + meshChanges; }
+};
+
+/**
+ * Sorts & submits the draws of a frame
+ */
+class RenderQueue
+{
+private:
+
+    /// One draw of one mesh of one object
+    struct Item
+    {
+        ShaderProgram* program;
+        Mesh* mesh;
+        RenderObject* object;
+
+        /// Full (untruncated) ids, so state changes are never missed
+        uint32_t programId;
+        uint32_t materialId;
+        uint32_t meshId;
+
+        /// Level of detail of the mesh to draw
+        uint32_t lod;
+
+        /// Where the item's index ranges start in mRanges
+        uint32_t firstRange;
+
+        /// Number of index ranges to draw (0 to draw all of the LOD)
+        uint32_t numRanges;
+    };
+
+    /// Every draw pushed this frame, in push order
+    std::vector<Item> mItems;
+
+    /// Sort key of each item, in push order
+    std::vector<uint64_t> mKeys;
+
+    /// Item indices, in sorted order after Sort()
+    std::vector<uint32_t> mOrder;
+
+    /// Scratch space for the radix sort
+    std::vector<uint32_t> mOrderScratch;
+
+    /// Index ranges of the items that only draw some of their mesh
+    std::vector<MeshLOD> mRanges;
+
+    /// Transforms of the items, in sorted order
+    std::vector<InstanceData> mInstanceData;
+
+    /// mInstanceData, on the GPU
+    InstanceBuffer mInstanceBuffer;
+
+    /// Has mInstanceData been uploaded since the last Sort?
+    bool mInstancesUploaded = false;
+
+    /// Index counts of the draws being merged into one multi-draw
+    std::vector<int> mMultiDrawCounts;
+
+    /// Index buffer offsets of the draws being merged
+    std::vector<const void*> mMultiDrawIndices;
+
+    /// Base vertices of the draws being merged
+    std::vector<int> mMultiDrawBaseVertices;
+
+    /// Ids handed out to shader programs
+    std::unordered_map<const ShaderProgram*, uint32_t> mProgramIds;
+
+    /// What submitting took on the last frame
+    RenderQueueStats mStats;
+
+    /// What submitting depth only took on the last frame
+    RenderQueueStats mDepthStats;
+
+    void UploadInstances();
+    void AddMultiDraw(const Item& item);
+    unsigned int FindRunEnd(unsigned int first) const;
+    unsigned int GatherMultiDraw(unsigned int first, unsigned int runEnd);
+    void DrawGathered(const Item& item, unsigned int first, unsigned int runEnd, RenderQueueStats& stats);
+
+public:
+
+    /// Default constructor. Needs a current GL context!
+    RenderQueue() = default;
+
+    /// Copy constructor (disabled)
+    RenderQueue(const RenderQueue &) = delete;
+
+    /// Assignment operator
+    void operator=(const RenderQueue &) = delete;
+
+    // ****************************************************************
+
+    void Clear();
+    void Push(ShaderProgram& program, Mesh* mesh, RenderObject* object, float viewDepth,
+              unsigned int lod = 0, const MeshLOD* ranges = nullptr, unsigned int numRanges = 0);
+    void Sort();
+    void Submit();
+    void SubmitDepth(ShaderProgram& depthProgram);
+
+    /**
+     * Get what submitting the queue took on the last frame
+     * @return the stats of the last Submit
+     */
+    const RenderQueueStats& GetStats() const { return mStats; }
+
+    /**
+     * Get what submitting the queue depth only took on the last frame
+     * @return the stats of the last SubmitDepth (all zero if it didn't run)
+     */
+    const RenderQueueStats& GetDepthStats() const { return mDepthStats; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_RENDERQUEUE_H
@@ -3,20 +3,75 @@
  * @author Elijah Gleckler
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include "Scene.h"
 
 #include "PointLight.h"
 #include "DirectionalLight.h"
 #include "RenderObject.h"
 #include "Skybox.h"
+#include "Model.h"
+#include "ClusterCulling.h"
 
 /// Uniform name for the "number of active lights" uniform in any
 /// lighting shader that wants to render point lights
 const std::string ACTIVE_PT_LIGHTS_UNIFORM_NAME = "numActivePtLights";
 
+/// Name of the samplerBuffer any lighting shader that
+/// wants to render point lights reads them out of
+const std::string POINT_LIGHT_DATA_UNIFORM_NAME = "pointLightData";
+
+/// Texture unit the point light buffer gets bound to. The g-buffer
+/// textures sit on units 0-2 in the lighting pass, so go after those.
+const unsigned int POINT_LIGHT_DATA_TEX_UNIT = 3;
+
 /// Naming convention for the directional light-skipping bool the lighting frag shader
 const std::string DIRLIGHT_OPTIMIZER_BOOL_UNIFORM_NAME = "dirLightIsActive";
 
+/// Overdraw (fragments per pixel) above which Auto mode turns the depth
+/// pre-pass on. Below about this, drawing everything twice costs more
+/// than the shading & g-buffer writes it saves.
+const float DEPTH_PREPASS_ON_OVERDRAW = 1.5f;
+
+/// Overdraw below which Auto mode turns the depth pre-pass back off.
+/// (A bit under the "on" one, so it doesn't flicker on and off.)
+const float DEPTH_PREPASS_OFF_OVERDRAW = 1.25f;
+
+
+/**
+ * Pick a level of detail for something of a size on screen
+ *
+ * @param pixels how many pixels across it is
+ * @param bias quality bias (see Scene::SetLODBias)
+ * @return the level of detail (0 is full detail)
+ */
+static unsigned int SelectLOD(float pixels, float bias)
+{
+    float size = pixels * bias;
+    if (size >= LOD_FULL_DETAIL_PIXELS)
+        return 0;
+
+    auto lod = (unsigned int)std::floor(std::log2(LOD_FULL_DETAIL_PIXELS / size));
+    return lod < MAX_MESH_LODS - 1 ? lod : MAX_MESH_LODS - 1;
+}
+
+
+
+/**
+ * Do a mesh's parts get culled on their own this frame? Only
+ * batched meshes have parts, and only full detail draws them.
+ *
+ * @param mesh the mesh
+ * @param lod level of detail its object picked
+ * @return true if the mesh draws just its parts in view
+ */
+static bool IsDrawnByParts(const Mesh& mesh, unsigned int lod)
+{
+    return lod == 0 && mesh.GetParts().size() > 1;
+}
+
 
 /**
  * Default constructor
@@ -113,6 +168,7 @@ void Scene::AddPointLight(PointLight *lightSrc)
 {
     mPointLights.push_back(lightSrc);
     UpdatePointLightIndices();
+    mPointLightBuffer.Resize(mPointLights.size());
 }
 
 
@@ -120,21 +176,309 @@ void Scene::AddPointLight(PointLight *lightSrc)
 /**
  * Render all RenderObjects to the currently
  * bound framebuffer with a supplied set of
- * shaders so each RenderObject can set its
- * transformation uniforms.
+ * shaders. The shaders get each object's transforms
+ * as per-instance attributes (see InstanceBuffer.h),
+ * and the draws go through a RenderQueue, which sorts
+ * them to bind as little state as possible and draws
+ * each mesh once, instanced, for all its visible copies.
+ *
+ * Anything outside the camera's view gets skipped: first
+ * whole objects are tested against the view frustum, then
+ * each mesh of the objects that made it. (Big models like
+ * Sponza are mostly behind the camera at any one time.)
+ *
+ * Each object in view also picks a level of detail from how big
+ * its bounding sphere is on screen (and the LOD bias), and objects
+ * only a pixel or so across are skipped entirely.
+ *
+ * Meshes drawn at full detail get culled in smaller pieces too:
+ * the parts of batched meshes (see MeshBatcher.h), then the clusters
+ * of triangles of those (see ClusterCulling.h), which also get
+ * dropped if they all face away from the camera. Only the pieces
+ * left get drawn.
+ * See GetRenderStats() for how much got thrown out.
+ *
+ * Same as QueueObjects, then SubmitObjects.
  *
  * @param shaders Currently bound shaders
+ * @param frame this frame's camera matrices
+ * @param screenHeight height of the framebuffer, in pixels
  */
-void Scene::RenderObjects(ShaderProgram &shaders)
+void Scene::RenderObjects(ShaderProgram &shaders, const FrameConstants &frame, int screenHeight)
 {
-    // Render all the objects to the g-buffer
+    QueueObjects(shaders, frame, screenHeight);
+    SubmitObjects();
+}
+
+
+
+/**
+ * Cull the RenderObjects, and queue up & sort the draws of what's
+ * left, without drawing anything yet (see RenderObjects for how).
+ * The queue can then be drawn depth only, with SubmitObjectsDepth,
+ * before it gets drawn for real, with SubmitObjects.
+ *
+ * @param shaders shaders the draws will be drawn with
+ * @param frame this frame's camera matrices
+ * @param screenHeight height of the framebuffer, in pixels
+ */
+void Scene::QueueObjects(ShaderProgram &shaders, const FrameConstants &frame, int screenHeight)
+{
+    const glm::mat4& viewProjMat = frame.viewProjMat;
+    Frustum frustum = Frustum::FromMatrix(viewProjMat);
+
+    // A sphere of radius r, w in front of the camera,
+    // is r * pixelsPerUnit / w pixels across
+    float pixelsPerUnit = frame.projMat[1][1] * (float)screenHeight;
+    mRenderStats = RenderStats();
+
+    // Catch up the transforms of anything that moved...
+    RenderObject::UpdateTransforms();
+    mRenderStats.updatedTransforms = RenderObject::GetNumTransformsUpdated();
+
+    // ... cull whole objects first...
+    mObjectCuller.Clear();
     for (RenderObject* object : mObjects)
     {
-        // These two functions are decoupled intentionally so
-        // that we only have to pass the view matrix to one
-        object->SetTransformationUniforms(shaders);
-        object->Draw(shaders);
+        mObjectCuller.Add(object->GetWorldBounds());
+    }
+    mObjectCuller.Cull(frustum);
+
+    // ... then the meshes of the objects that are (partly) in view
+    mVisibleObjects.clear();
+    mVisibleLODs.clear();
+    mMeshCuller.Clear();
+    mPartCuller.Clear();
+    for (unsigned int i = 0; i < mObjects.size(); ++i)
+    {
+        RenderObject* object = mObjects[i];
+        const auto& meshes = object->GetModel()->GetMeshes();
+
+        if (!mObjectCuller.IsVisible(i))
+        {
+            mRenderStats.culledObjects++;
+            mRenderStats.culledMeshes += meshes.size();
+            continue;
+        }
+
+        // Pick a level of detail from the size on screen. (If the
+        // camera's inside the sphere, it's plenty big.)
+        const AABB& bounds = object->GetWorldBounds();
+        float radius = glm::length(bounds.Extents());
+        float depth = (viewProjMat * glm::vec4(bounds.Center(), 1.0f)).w;
+        unsigned int lod = 0;
+        if (depth > radius)
+        {
+            float pixels = radius * pixelsPerUnit / depth;
+            if (pixels < LOD_CULL_PIXELS)
+            {
+                mRenderStats.culledObjects++;
+                mRenderStats.tinyObjects++;
+                mRenderStats.culledMeshes += meshes.size();
+                continue;
+            }
+            lod = SelectLOD(pixels, mLODBias);
+        }
+
+        mRenderStats.visibleObjects++;
+        mVisibleObjects.push_back(object);
+        mVisibleLODs.push_back(lod);
+        for (const auto& mesh : meshes)
+        {
+            mMeshCuller.Add(mesh->GetBounds().Transformed(object->GetModelMatrix()));
+            if (IsDrawnByParts(*mesh, lod))
+            {
+                for (const MeshPart& part : mesh->GetParts())
+                    mPartCuller.Add(part.bounds.Transformed(object->GetModelMatrix()));
+            }
+        }
+    }
+    mMeshCuller.Cull(frustum);
+    mPartCuller.Cull(frustum);
+
+    // Queue up the surviving meshes, ...
+    mRenderQueue.Clear();
+    unsigned int meshIndex = 0;
+    unsigned int partIndex = 0;
+    for (unsigned int i = 0; i < mVisibleObjects.size(); ++i)
+    {
+        RenderObject* object = mVisibleObjects[i];
+        const glm::mat4& modelMat = object->GetModelMatrix();
+
+        // Clusters get culled in model space (see ClusterCulling.h).
+        // A mirroring transform turns them inside out, so leave
+        // those objects' back faces alone
+        Frustum modelFrustum = Frustum::FromMatrix(viewProjMat * modelMat);
+        glm::vec3 modelViewPos = glm::vec3(glm::inverse(modelMat) * glm::vec4(glm::vec3(frame.viewPos), 1.0f));
+        bool cullBackfacing = mBackfaceCulling && glm::determinant(modelMat) > 0.0f;
+
+        for (const auto& mesh : object->GetModel()->GetMeshes())
+        {
+            bool byParts = IsDrawnByParts(*mesh, mVisibleLODs[i]);
+            unsigned int firstPart = partIndex;
+            if (byParts)
+                partIndex += (unsigned int)mesh->GetParts().size();
+
+            if (!mMeshCuller.IsVisible(meshIndex++))
+            {
+                mRenderStats.culledMeshes++;
+                continue;
+            }
+
+            // (Meshes too small to simplify have fewer LODs)
+            unsigned int lod = std::min(mVisibleLODs[i], mesh->GetNumLODs() - 1);
+
+            // At full detail, just draw the pieces that are in view: the
+            // parts of a batched mesh that are, and the clusters of those
+            // that are on screen and face the camera
+            const auto& clusters = mesh->GetClusters();
+            mVisibleRanges.clear();
+            auto addVisible = [&](const MeshLOD& range, unsigned int firstCluster, unsigned int numClusters) {
+                if (clusters.empty())
+                {
+                    mVisibleRanges.push_back(range);
+                    return;
+                }
+                ClusterCullStats culled = CullClusters(clusters, firstCluster, numClusters, modelFrustum,
+                                                       modelViewPos, cullBackfacing, mVisibleRanges);
+                mRenderStats.culledClusters += culled.outside + culled.backfacing;
+                mRenderStats.backfacingClusters += culled.backfacing;
+            };
+
+            bool byPieces = (lod == 0 && (byParts || !clusters.empty()));
+            if (byParts)
+            {
+                const auto& parts = mesh->GetParts();
+                for (unsigned int part = 0; part < parts.size(); ++part)
+                {
+                    if (!mPartCuller.IsVisible(firstPart + part))
+                    {
+                        mRenderStats.culledParts++;
+                        continue;
+                    }
+                    addVisible({parts[part].firstIndex, parts[part].numIndices},
+                               parts[part].firstCluster, parts[part].numClusters);
+                }
+            }
+            else if (byPieces)
+            {
+                addVisible({0, (unsigned int)mesh->GetDrawRange(0).count}, 0, (unsigned int)clusters.size());
+            }
+
+            if (byPieces && mVisibleRanges.empty())
+            {
+                mRenderStats.culledMeshes++;
+                continue;
+            }
+
+            if (lod > 0)
+                mRenderStats.reducedMeshes++;
+            mRenderStats.visibleMeshes++;
+
+            // Clip space w is the distance in front of the camera
+            glm::vec4 center = modelMat * glm::vec4(mesh->GetBounds().Center(), 1.0f);
+            float viewDepth = (viewProjMat * center).w;
+
+            // All of it's in view after all? Then it can still be instanced
+            bool whole = !byPieces || (mVisibleRanges.size() == 1 &&
+                                       (int)mVisibleRanges[0].numIndices == mesh->GetDrawRange(0).count);
+            if (whole)
+                mRenderQueue.Push(shaders, mesh.get(), object, viewDepth, lod);
+            else
+                mRenderQueue.Push(shaders, mesh.get(), object, viewDepth, lod,
+                                  mVisibleRanges.data(), (unsigned int)mVisibleRanges.size());
+        }
     }
+
+    // ... and sort them by state & depth. Copies of the same mesh
+    // (objects made from the same model share its meshes) end up
+    // side by side and go out as one instanced draw.
+    mRenderQueue.Sort();
+}
+
+
+
+/**
+ * Draw the draws the last QueueObjects call queued up
+ * to the currently bound framebuffer, with their shaders
+ */
+void Scene::SubmitObjects()
+{
+    mRenderQueue.Submit();
+}
+
+
+
+/**
+ * Draw the draws the last QueueObjects call queued up to the
+ * currently bound framebuffer, depth only: every draw uses the
+ * supplied shaders, and the meshes' position-only vertex arrays.
+ * See RenderQueue::SubmitDepth.
+ *
+ * @param depthShaders shaders that only transform the positions
+ */
+void Scene::SubmitObjectsDepth(ShaderProgram &depthShaders)
+{
+    mRenderQueue.SubmitDepth(depthShaders);
+}
+
+
+
+/**
+ * Record how much overdraw the geometry pass measured (see
+ * GetOverdraw), and in Auto mode, turn the depth pre-pass on
+ * if there's a lot of it, or back off if there's little.
+ *
+ * @param overdraw fragments shaded per pixel of the screen
+ */
+void Scene::RecordOverdraw(float overdraw)
+{
+    mOverdraw = overdraw;
+
+    if (overdraw > DEPTH_PREPASS_ON_OVERDRAW)
+        mAutoDepthPrepass = true;
+    else if (overdraw < DEPTH_PREPASS_OFF_OVERDRAW)
+        mAutoDepthPrepass = false;
+}
+
+
+
+/**
+ * Render all RenderObjects to the currently bound framebuffer,
+ * GPU-driven: the culling, LOD picking and draw building of
+ * RenderObjects all happen in a compute shader instead (see
+ * IndirectRenderer.h). Needs a GL 4.3+ context, and shaders
+ * that read their transforms like gbuf-geo-indirect.vert.
+ *
+ * Only updatedTransforms of GetRenderStats() gets filled in;
+ * see GetIndirectStats() for the rest.
+ *
+ * @param shaders shaders to draw with
+ * @param frame this frame's camera matrices
+ * @param screenHeight height of the framebuffer, in pixels
+ */
+void Scene::RenderObjectsIndirect(ShaderProgram &shaders, const FrameConstants &frame, int screenHeight)
+{
+    mRenderStats = RenderStats();
+
+    RenderObject::UpdateTransforms();
+    mRenderStats.updatedTransforms = RenderObject::GetNumTransformsUpdated();
+
+    if (mIndirectRenderer == nullptr)
+        mIndirectRenderer = std::make_unique<IndirectRenderer>();
+    mIndirectRenderer->Render(mObjects, shaders, frame, screenHeight, mLODBias);
+}
+
+
+
+/**
+ * Get what the last RenderObjectsIndirect call took
+ * @return the indirect renderer's stats (all zero if it's never run)
+ */
+const IndirectRendererStats &Scene::GetIndirectStats() const
+{
+    static const IndirectRendererStats none;
+    return mIndirectRenderer != nullptr ? mIndirectRenderer->GetStats() : none;
 }
 
 
@@ -144,7 +488,8 @@ void Scene::RenderObjects(ShaderProgram &shaders)
  *
  * Doesn't really render anything... (right now)
  *
- * Just sets the lighting uniforms in the supplied shader.
+ * Just sets the lighting uniforms in the supplied shader
+ * and uploads whatever point lights changed to the light buffer.
  * For now, these will most likely be the GBuffer's
  * lighting shaders.
  *
@@ -160,22 +505,28 @@ void Scene::RenderLighting(ShaderProgram &shaders)
         mDirectionalLight->SetLightingUniforms(shaders);
     }
 
-    // Set lighting uniforms for each point light
+    // Re-pack just the point lights that changed since last frame.
+    // The buffer widens its dirty range over them, so in a static
+    // scene nothing gets packed and the upload below does nothing.
     for(PointLight* ptLight : mPointLights)
     {
-        // The indices in the uniform array should all be ok,
-        // since they were established when the scene was created!
-        ptLight->SetLightingUniforms(shaders);
+        if (ptLight->IsDirty())
+        {
+            mPointLightBuffer.Set(ptLight->GetShaderIndex(), ptLight->Pack());
+            ptLight->ClearDirty();
+        }
     }
+    mPointLightBuffer.Upload();
+
+    mPointLightBuffer.Bind(POINT_LIGHT_DATA_TEX_UNIT);
+    shaders.SetIntUniform(POINT_LIGHT_DATA_UNIFORM_NAME, POINT_LIGHT_DATA_TEX_UNIT);
 
     // Tell the shaders how many point lights to consider.
-    // This will fail if the lighting shaders don't have this uniform!
-    // It's a feature, not a bug... what I'm saying is, if you
-    // want to render lighting anywhere, you need to make sure
-    // the shaders know how many lights you want to render on
-    // this pass. Also, all shaders that want to render lights
-    // should have this same convention.
-    shaders.SetIntUniform(ACTIVE_PT_LIGHTS_UNIFORM_NAME, mPointLights.size());
+    // The g-buffer lighting shaders don't need this anymore, since
+    // they walk the light cluster lists instead (see LightClusterGrid),
+    // but shaders that loop over every light still go by it.
+    // Setting a uniform a shader doesn't have is harmless.
+    shaders.SetIntUniform(ACTIVE_PT_LIGHTS_UNIFORM_NAME, mPointLightBuffer.Size());
     // Will set the size when it's zero, and is called on
     // every render pass, so we should never hit an error.
 }
@@ -184,17 +535,14 @@ void Scene::RenderLighting(ShaderProgram &shaders)
 
 /**
  * Render the skybox to the currently bound framebuffer.
- * Skybox will use its own shaders, but needs projection
- * and view matrices to draw.
- *
- * @param projMat projection matrix
- * @param viewMat view matrix
+ * Skybox will use its own shaders, and gets the projection
+ * and view matrices from the FrameConstants uniform buffer.
  */
-void Scene::RenderSkybox(glm::mat4 projMat, glm::mat4 viewMat)
+void Scene::RenderSkybox()
 {
     if (mSkybox != nullptr)
     {
-        mSkybox->Draw(projMat, viewMat);
+        mSkybox->Draw();
     }
 }
 
@@ -31,13 +31,76 @@
 #define LEARNING_OPENGL__SCENE_H
 
 #include <glm.hpp>
+#include <memory>
 #include <vector>
 
+#include "PointLightBuffer.h"
+#include "FrustumCuller.h"
+#include "RenderQueue.h"
+#include "FrameConstants.h"
+#include "IndirectRenderer.h"
+
 class RenderObject;
 class PointLight;
 class DirectionalLight;
 class Skybox;
 class ShaderProgram;
+
+/**
+ * How much frustum culling threw out on the last frame
+ * (see RenderQueueStats for what drawing the rest took)
+ */
+struct RenderStats
+{
+    /// Objects with at least some part in view
+    unsigned int visibleObjects = 0;
+
+    /// Objects entirely out of view
+    unsigned int culledObjects = 0;
+
+    /// Meshes drawn
+    unsigned int visibleMeshes = 0;
+
+    /// Meshes skipped, including all those of culled objects
+    unsigned int culledMeshes = 0;
+
+    /// Objects whose transforms changed, and got rebuilt
+    unsigned int updatedTransforms = 0;
+
+    /// Objects in view, but too small on screen to bother drawing
+    /// (counted in culledObjects too)
+    unsigned int tinyObjects = 0;
+
+    /// Meshes drawn at less than full detail
+    unsigned int reducedMeshes = 0;
+
+    /// Parts of batched meshes left out of their mesh's draw (see MeshBatcher.h)
+    unsigned int culledParts = 0;
+
+    /// Clusters of triangles left out of their mesh's draw (see ClusterCulling.h)
+    unsigned int culledClusters = 0;
+
+    /// Clusters that faced away from the camera (counted in culledClusters too)
+    unsigned int backfacingClusters = 0;
+};
+
+/**
+ * Whether the geometry pass draws the scene's depth
+ * first, so it only shades the nearest fragment of
+ * each pixel (see GBuffer.h)
+ */
+enum class DepthPrepassMode
+{
+    /// Never draw the depth first
+    Off,
+
+    /// Always draw the depth first
+    On,
+
+    /// Draw the depth first while the scene's overdraw is high
+    Auto
+};
+
 /**
  * Manages all the visible entities in the game
  */
@@ -51,6 +114,9 @@ private:
     /// Pointers to all the movable LightSources
     std::vector<PointLight*> mPointLights;
 
+    /// The point lights, packed into a texture buffer for the lighting shaders
+    PointLightBuffer mPointLightBuffer;
+
     /// Pointer to a single directional light source
     /// It's my design choice that only one is allowed per scene
     DirectionalLight* mDirectionalLight = nullptr;
@@ -58,6 +124,51 @@ private:
     /// Skybox for this scene
     Skybox* mSkybox;
 
+    /// Culls whole objects against the camera's view
+    FrustumCuller mObjectCuller;
+
+    /// Culls the meshes of objects that survived mObjectCuller
+    FrustumCuller mMeshCuller;
+
+    /// Culls the parts of batched meshes drawn at full detail
+    FrustumCuller mPartCuller;
+
+    /// Index ranges of the pieces of a mesh that are in view
+    std::vector<MeshLOD> mVisibleRanges;
+
+    /// Should the geometry pass cull back faces (and clusters facing away)?
+    bool mBackfaceCulling = false;
+
+    /// Whether the geometry pass draws the depth first
+    DepthPrepassMode mDepthPrepassMode = DepthPrepassMode::Auto;
+
+    /// Is the depth pre-pass on in Auto mode?
+    bool mAutoDepthPrepass = false;
+
+    /// Fragments the geometry pass shaded per pixel, as last measured
+    float mOverdraw = 0.0f;
+
+    /// Objects that survived mObjectCuller this frame
+    std::vector<RenderObject*> mVisibleObjects;
+
+    /// Level of detail picked for each of mVisibleObjects
+    std::vector<unsigned int> mVisibleLODs;
+
+    /// Quality bias for picking levels of detail: 2 keeps full
+    /// detail until objects are half as big on screen, 0.5 drops
+    /// it when they're twice as big
+    float mLODBias = 1.0f;
+
+    /// Sorts the visible meshes' draws to keep state changes down
+    RenderQueue mRenderQueue;
+
+    /// What drawing the objects took on the last frame
+    RenderStats mRenderStats;
+
+    /// Culls & draws on the GPU instead, in GPU-driven contexts.
+    /// Made the first time RenderObjectsIndirect is called
+    std::unique_ptr<IndirectRenderer> mIndirectRenderer;
+
     /// Is there a directional light currently active?
     /// Helps use save some lighting calculations when there isn't
     /// and reduces uniform calls to only on state change.
@@ -68,7 +179,7 @@ private:
 
 public:
 
-    /// Default constructor
+    /// Default constructor. Needs a current GL context!
     Scene();
 
     /// Copy constructor (disabled)
@@ -91,6 +202,12 @@ public:
      */
     std::vector<PointLight*>& GetPointLights() { return mPointLights; }
 
+    /**
+     * Get the packed point light data the lighting shaders read
+     * @return the scene's point light buffer
+     */
+    const PointLightBuffer& GetPointLightBuffer() const { return mPointLightBuffer; }
+
     /**
      * Get a pointer to the scene's single directional light
      * @return pointer to the sole directional light source
@@ -122,11 +239,96 @@ public:
 
     void AddPointLight(PointLight* lightSrc);
 
+    /**
+     * Get how many objects & meshes frustum culling kept
+     * and threw out in the last RenderObjects call
+     * @return the culling counts of the last frame
+     */
+    const RenderStats& GetRenderStats() const { return mRenderStats; }
+
+    /**
+     * Get how many draw calls & state changes the
+     * last RenderObjects call took
+     * @return the render queue stats of the last frame
+     */
+    const RenderQueueStats& GetRenderQueueStats() const { return mRenderQueue.GetStats(); }
+
+    const IndirectRendererStats& GetIndirectStats() const;
+
+    /**
+     * Set the quality bias for picking levels of detail.
+     * Higher keeps more detail further away.
+     * @param bias the LOD bias (1 is the default)
+     */
+    void SetLODBias(float bias) { mLODBias = bias; }
+
+    /**
+     * Get the quality bias for picking levels of detail
+     * @return the LOD bias
+     */
+    float GetLODBias() const { return mLODBias; }
+
+    /**
+     * Turn back-face culling in the geometry pass on or off. With it
+     * on, clusters of triangles facing away from the camera don't even
+     * get drawn (see ClusterCulling.h). It's off by default, because
+     * it's only right for some scenes: single-sided cards & foliage
+     * vanish from behind, and objects with mirroring transforms get
+     * their front faces culled instead. Turn it on for scenes of
+     * closed models with no mirroring.
+     * @param cull true to cull back faces (off by default)
+     */
+    void SetBackfaceCulling(bool cull) { mBackfaceCulling = cull; }
+
+    /**
+     * Does the geometry pass cull back faces?
+     * @return true if back faces get culled
+     */
+    bool GetBackfaceCulling() const { return mBackfaceCulling; }
+
+    /**
+     * Choose whether the geometry pass draws the depth first.
+     * Auto (the default) turns it on and off with the overdraw.
+     * @param mode the new depth pre-pass mode
+     */
+    void SetDepthPrepassMode(DepthPrepassMode mode) { mDepthPrepassMode = mode; }
+
+    /**
+     * Get whether the geometry pass draws the depth first
+     * @return the depth pre-pass mode
+     */
+    DepthPrepassMode GetDepthPrepassMode() const { return mDepthPrepassMode; }
+
+    /**
+     * Should the next geometry pass draw the depth first?
+     * @return true if the depth pre-pass is on, by mode or by overdraw
+     */
+    bool UsesDepthPrepass() const
+    {
+        return mDepthPrepassMode == DepthPrepassMode::On ||
+               (mDepthPrepassMode == DepthPrepassMode::Auto && mAutoDepthPrepass);
+    }
+
+    /**
+     * Get the overdraw of the scene, as last measured: how many fragments
+     * the geometry pass would shade per pixel of the screen without the
+     * depth pre-pass (1 is every pixel once; empty sky counts as 0).
+     * The GPU reports it a few frames late.
+     * @return the fragments shaded per pixel
+     */
+    float GetOverdraw() const { return mOverdraw; }
+
+    void RecordOverdraw(float overdraw);
+
     // ****************************************************************
 
-    void RenderObjects(ShaderProgram& shaders);
+    void RenderObjects(ShaderProgram& shaders, const FrameConstants& frame, int screenHeight);
+    void QueueObjects(ShaderProgram& shaders, const FrameConstants& frame, int screenHeight);
+    void SubmitObjects();
+    void SubmitObjectsDepth(ShaderProgram& depthShaders);
+    void RenderObjectsIndirect(ShaderProgram& shaders, const FrameConstants& frame, int screenHeight);
     void RenderLighting(ShaderProgram& shaders);
-    void RenderSkybox(glm::mat4 projMat, glm::mat4 viewMat);
+    void RenderSkybox();
 
 
 
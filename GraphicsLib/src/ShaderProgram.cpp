@@ -4,15 +4,31 @@
  */
 
 #include "ShaderProgram.h"
+#include "FrameConstants.h"
 
 #include "glad/glad.h"
 #include "gtc/type_ptr.hpp"
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 
 using namespace std;
 
+
+// Map each type a UniformHandle can hold to its GLSL uniform type
+template <> unsigned int UniformGLType<bool>() { return GL_BOOL; }
+template <> unsigned int UniformGLType<int>() { return GL_INT; }
+template <> unsigned int UniformGLType<float>() { return GL_FLOAT; }
+template <> unsigned int UniformGLType<glm::vec3>() { return GL_FLOAT_VEC3; }
+template <> unsigned int UniformGLType<glm::vec4>() { return GL_FLOAT_VEC4; }
+template <> unsigned int UniformGLType<glm::mat3>() { return GL_FLOAT_MAT3; }
+template <> unsigned int UniformGLType<glm::mat4>() { return GL_FLOAT_MAT4; }
+
+
+// Upload counts are shared by all the programs
+UniformUploadStats ShaderProgram::sFrameUploadStats;
+
 /**
  * Constructor
  * @param vertexPath filepath to the vertex shader GLSL code
@@ -174,9 +190,112 @@ ShaderProgram::ShaderProgram(string programName, const char* vertexPath, const c
     glDeleteShader(fragmentShader);
 
 
+    //
+    // 4. Find out what uniforms the linked program has
+    //
+
+    IntrospectUniforms();
+
+    // Hook the per-frame camera block up to its binding
+    // point, if this program uses it at all
+    unsigned int blockIndex = glGetUniformBlockIndex(mProgramID, FRAME_CONSTANTS_BLOCK_NAME.c_str());
+    if (blockIndex != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(mProgramID, blockIndex, FRAME_CONSTANTS_BINDING);
+    }
+
 }
 
 
+/**
+ * Constructor, for a compute program. Needs a GL 4.3+ context,
+ * and glad generated for GL 4.3+!
+ * @param programName human-readable name, for error messages
+ * @param computePath filepath to the compute shader GLSL code
+ */
+ShaderProgram::ShaderProgram(string programName, const char* computePath) : mProgramName(programName)
+{
+#ifdef GL_VERSION_4_3
+    // Get the source...
+    string computeCode;
+    ifstream computeShaderFile;
+    computeShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
+    try
+    {
+        computeShaderFile.open(computePath);
+        stringstream computeShaderStream;
+        computeShaderStream << computeShaderFile.rdbuf();
+        computeShaderFile.close();
+        computeCode = computeShaderStream.str();
+    }
+    catch (ifstream::failure e)
+    {
+        std::cout
+        << "********************************************************************************" << std::endl
+        << "ERROR IN PROGRAM \"" << mProgramName << "\"\nwhile loading compute shader source from: \"" << computePath << "\""
+        << "\nCOULD NOT READ COMPUTE SHADER FILE INPUT" << std::endl
+        << "********************************************************************************" << std::endl;
+    }
+    const char* computeShaderCode = computeCode.c_str();
+
+    // ... compile it...
+    int success;
+    char infoLog[512];
+
+    unsigned int computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShader, 1, &computeShaderCode, NULL);
+    glCompileShader(computeShader);
+
+    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(computeShader, 512, NULL, infoLog);
+        std::cout
+        << "********************************************************************************" << std::endl
+        << "ERROR IN PROGRAM \"" << mProgramName << "\"\nwhile compiling compute shader source code at: \"" << computePath << "\""
+        << "\nCOMPUTE SHADER COMPILATION FAILED\n\ninfoLog:" << std::endl
+        << infoLog  << std::endl
+        << "********************************************************************************" << std::endl;
+    }
+
+    // ... and link it
+    mProgramID = glCreateProgram();
+    glAttachShader(mProgramID, computeShader);
+    glLinkProgram(mProgramID);
+
+    glGetProgramiv(mProgramID, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        glGetProgramInfoLog(mProgramID, 512, nullptr, infoLog);
+        std::cout
+        << "********************************************************************************" << std::endl
+        << "ERROR IN PROGRAM \"" << mProgramName << "\":\nSHADER PROGRAM LINKING FAILED" << std::endl
+        << "Could not link \n\"" << computePath << "\"" << std::endl
+        << "\ninfoLog:\n" << infoLog << std::endl
+        << "********************************************************************************" << std::endl;
+    }
+    glDeleteShader(computeShader);
+
+    IntrospectUniforms();
+
+    unsigned int blockIndex = glGetUniformBlockIndex(mProgramID, FRAME_CONSTANTS_BLOCK_NAME.c_str());
+    if (blockIndex != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(mProgramID, blockIndex, FRAME_CONSTANTS_BINDING);
+    }
+#else
+    // glad wasn't generated with compute shaders
+    std::cout
+    << "********************************************************************************" << std::endl
+    << "ERROR IN PROGRAM \"" << mProgramName << "\"\nwhile loading compute shader: \"" << computePath << "\""
+    << "\nCOMPUTE SHADERS NEED GLAD GENERATED FOR GL 4.3+" << std::endl
+    << "********************************************************************************" << std::endl;
+    mProgramID = 0;
+#endif
+}
+
+
+
 /**
  * Use this shader program.
  * Binds this shader program to OpenGL
@@ -190,48 +309,54 @@ void ShaderProgram::use()
 
 /**
  * Set a bool uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * @param uniformName the name of the uniform we want to set
  * @param val the new value to set it to
  */
-void ShaderProgram::SetBoolUniform(const std::string &uniformName, bool val) const
+void ShaderProgram::SetBoolUniform(const std::string &uniformName, bool val)
 {
-    glUniform1i(glGetUniformLocation(mProgramID, uniformName.c_str()), (int)val);
+    UniformHandle<bool> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, val);
 }
 
 
 
 /**
  * Set an integer uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * @param uniformName the name of the uniform we want to set
  * @param val the new value to set it to
  */
-void ShaderProgram::SetIntUniform(const std::string &uniformName, int val) const
+void ShaderProgram::SetIntUniform(const std::string &uniformName, int val)
 {
-    glUniform1i(glGetUniformLocation(mProgramID, uniformName.c_str()), val);
+    UniformHandle<int> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, val);
 }
 
 
 
 /**
  * Set a float uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * @param uniformName the name of the uniform we want to set
  * @param val the new value to set it to
  */
-void ShaderProgram::set1FUniform(const std::string &uniformName, float val) const
+void ShaderProgram::set1FUniform(const std::string &uniformName, float val)
 {
-    glUniform1f(glGetUniformLocation(mProgramID, uniformName.c_str()), val);
+    UniformHandle<float> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, val);
 }
 
 
 /**
  * Set a three-element float array uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * You'd better not segfault it!
  *
@@ -240,14 +365,16 @@ void ShaderProgram::set1FUniform(const std::string &uniformName, float val) cons
  */
 void ShaderProgram::set3FUniform(const std::string& uniformName, float ary[])
 {
-    glUniform3f(glGetUniformLocation(mProgramID, uniformName.c_str()), ary[0], ary[1], ary[2]);
+    UniformHandle<glm::vec3> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, glm::vec3(ary[0], ary[1], ary[2]));
 }
 
 
 
 /**
  * Set a four-element float array uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * You'd better not segfault it!
  *
@@ -256,52 +383,298 @@ void ShaderProgram::set3FUniform(const std::string& uniformName, float ary[])
  */
 void ShaderProgram::set4FUniform(const string &uniformName, float ary[])
 {
-    glUniform4f(glGetUniformLocation(mProgramID, uniformName.c_str()), ary[0], ary[1], ary[2], ary[3]);
+    UniformHandle<glm::vec4> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, glm::vec4(ary[0], ary[1], ary[2], ary[3]));
 }
 
 
 
 /**
  * Set a four-by-four float matrix uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * @param uniformName the name of the uniform we want to set
  * @param mat the transformation matrix we want to pass in
  */
 void ShaderProgram::SetMat4Uniform(const std::string& uniformName, glm::mat4 mat)
 {
-    unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-    glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
-
+    UniformHandle<glm::mat4> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, mat);
 }
 
 
 
 /**
  * Set a three-by-three float matrix uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * @param uniformName the name of the uniform we want to set
  * @param mat the transformation matrix we want to pass in
  */
 void ShaderProgram::setMat3Uniform(const std::string& uniformName, glm::mat3 mat)
 {
-    unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-    glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
-
+    UniformHandle<glm::mat3> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, mat);
 }
 
 
 
 /**
  * Set a vec3 uniform in the shader program.
- * Will search for the uniform in the program source code.
+ * Looks the uniform up in the program's table of active uniforms.
  *
  * @param uniformName the name of the uniform we want to set
  * @param mat the vec3 we want to pass in
  */
 void ShaderProgram::SetVec3Uniform(const std::string& uniformName, glm::vec3 vec)
 {
-    unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-    glUniform3fv(loc, 1, glm::value_ptr(vec));
-}
\ No newline at end of file
+    UniformHandle<glm::vec3> handle;
+    handle.slot = getUniformSlot(uniformName);
+    SetUniform(handle, vec);
+}
+
+
+
+/**
+ * Ask OpenGL for every active uniform in the freshly linked
+ * program and remember its location and type in a table.
+ *
+ * Arrays of basic types only show up once, as "name[0]", so
+ * every element gets its own entry, plus the bare array name.
+ * Members of arrays of structs, like "pointLights[3].position",
+ * are already listed one by one.
+ */
+void ShaderProgram::IntrospectUniforms()
+{
+    mUniforms.clear();
+    mUniformSlots.clear();
+
+    int numUniforms = 0;
+    int maxNameLength = 0;
+    glGetProgramiv(mProgramID, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(mProgramID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    // Little helper to add one entry to the table
+    auto addUniform = [this](const std::string& name, int location, unsigned int type)
+    {
+        UniformInfo info;
+        info.location = location;
+        info.type = type;
+        mUniformSlots[name] = (int)mUniforms.size();
+        mUniforms.push_back(info);
+    };
+
+    std::string name(maxNameLength, '\0');
+    for (int i = 0; i < numUniforms; ++i)
+    {
+        int nameLength = 0;
+        int arraySize = 0;
+        GLenum type;
+        glGetActiveUniform(mProgramID, i, maxNameLength, &nameLength,
+                           &arraySize, &type, &name[0]);
+        std::string uniformName = name.substr(0, nameLength);
+
+        // Uniforms that live in uniform blocks have no location
+        int location = glGetUniformLocation(mProgramID, uniformName.c_str());
+        if (location < 0)
+            continue;
+
+        addUniform(uniformName, location, type);
+
+        // Expand arrays of basic types into all their elements
+        auto bracket = uniformName.rfind("[0]");
+        if (arraySize > 1 && bracket != std::string::npos && bracket + 3 == uniformName.size())
+        {
+            std::string baseName = uniformName.substr(0, bracket);
+            mUniformSlots[baseName] = mUniformSlots[uniformName];
+
+            for (int j = 1; j < arraySize; ++j)
+            {
+                std::string elementName = baseName + "[" + std::to_string(j) + "]";
+                int elementLoc = glGetUniformLocation(mProgramID, elementName.c_str());
+                addUniform(elementName, elementLoc, type);
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Get the slot of a uniform in the introspection table.
+ *
+ * @param uniformName the name of the uniform in the shader source
+ * @return slot of the uniform, or -1 if the program has no
+ *         such active uniform (setting it then does nothing)
+ */
+int ShaderProgram::getUniformSlot(const std::string &uniformName) const
+{
+    auto it = mUniformSlots.find(uniformName);
+    return it != mUniformSlots.end() ? it->second : -1;
+}
+
+
+
+/**
+ * Get the slot of a uniform in the introspection table,
+ * checking that it has the type the caller expects.
+ *
+ * Ints are allowed to set samplers and bools, since that's
+ * what glUniform1i is for.
+ *
+ * @param uniformName the name of the uniform in the shader source
+ * @param glType GL type enum the caller wants to set
+ * @return slot of the uniform, or -1 if it wasn't found
+ */
+int ShaderProgram::FindUniformSlot(const std::string &uniformName, unsigned int glType) const
+{
+    int slot = getUniformSlot(uniformName);
+    if (slot < 0)
+        return -1;
+
+    unsigned int actualType = mUniforms[slot].type;
+    bool intLike = actualType == GL_INT || actualType == GL_BOOL ||
+                   actualType == GL_SAMPLER_2D || actualType == GL_SAMPLER_CUBE ||
+                   actualType == GL_SAMPLER_BUFFER || actualType == GL_INT_SAMPLER_BUFFER ||
+                   actualType == GL_UNSIGNED_INT_SAMPLER_BUFFER;
+    bool compatible = actualType == glType ||
+                      ((glType == GL_INT || glType == GL_BOOL) && intLike);
+
+    if (!compatible)
+    {
+        std::cout
+        << "********************************************************************************" << std::endl
+        << "WARNING IN PROGRAM \"" << mProgramName << "\":\nuniform \"" << uniformName
+        << "\" does not have the type of the handle requested for it" << std::endl
+        << "********************************************************************************" << std::endl;
+    }
+
+    return slot;
+}
+
+
+
+/**
+ * Compare a new uniform value against the shadow copy of
+ * the last value we uploaded, and update the shadow copy.
+ *
+ * The driver never sees a value it already has. This relies
+ * on all uniform uploads going through this class!
+ *
+ * @param slot slot of the uniform in the table (-1 is a no-op)
+ * @param data the new value
+ * @param bytes size of the new value
+ * @return true if the value changed and must be uploaded
+ */
+bool ShaderProgram::ShadowUniform(int slot, const void *data, unsigned int bytes)
+{
+    if (slot < 0)
+        return false;
+
+    UniformInfo& uniform = mUniforms[slot];
+    if (uniform.shadowValid && std::memcmp(uniform.shadow, data, bytes) == 0)
+    {
+        ++sFrameUploadStats.skipped;
+        return false;
+    }
+
+    std::memcpy(uniform.shadow, data, bytes);
+    uniform.shadowValid = true;
+    ++sFrameUploadStats.issued;
+    return true;
+}
+
+
+
+/**
+ * Set a bool uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param val the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<bool> handle, bool val)
+{
+    int intVal = (int)val;
+    if (ShadowUniform(handle.slot, &intVal, sizeof(intVal)))
+        glUniform1i(mUniforms[handle.slot].location, intVal);
+}
+
+
+
+/**
+ * Set an int (or sampler) uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param val the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<int> handle, int val)
+{
+    if (ShadowUniform(handle.slot, &val, sizeof(val)))
+        glUniform1i(mUniforms[handle.slot].location, val);
+}
+
+
+
+/**
+ * Set a float uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param val the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<float> handle, float val)
+{
+    if (ShadowUniform(handle.slot, &val, sizeof(val)))
+        glUniform1f(mUniforms[handle.slot].location, val);
+}
+
+
+
+/**
+ * Set a vec3 uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param vec the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<glm::vec3> handle, const glm::vec3 &vec)
+{
+    if (ShadowUniform(handle.slot, glm::value_ptr(vec), sizeof(glm::vec3)))
+        glUniform3fv(mUniforms[handle.slot].location, 1, glm::value_ptr(vec));
+}
+
+
+
+/**
+ * Set a vec4 uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param vec the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<glm::vec4> handle, const glm::vec4 &vec)
+{
+    if (ShadowUniform(handle.slot, glm::value_ptr(vec), sizeof(glm::vec4)))
+        glUniform4fv(mUniforms[handle.slot].location, 1, glm::value_ptr(vec));
+}
+
+
+
+/**
+ * Set a mat3 uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param mat the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<glm::mat3> handle, const glm::mat3 &mat)
+{
+    if (ShadowUniform(handle.slot, glm::value_ptr(mat), sizeof(glm::mat3)))
+        glUniformMatrix3fv(mUniforms[handle.slot].location, 1, GL_FALSE, glm::value_ptr(mat));
+}
+
+
+
+/**
+ * Set a mat4 uniform through a pre-resolved handle
+ * @param handle handle from GetUniformHandle
+ * @param mat the new value to set it to
+ */
+void ShaderProgram::SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4 &mat)
+{
+    if (ShadowUniform(handle.slot, glm::value_ptr(mat), sizeof(glm::mat4)))
+        glUniformMatrix4fv(mUniforms[handle.slot].location, 1, GL_FALSE, glm::value_ptr(mat));
+}
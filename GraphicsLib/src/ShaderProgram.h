@@ -14,8 +14,61 @@
 #define LEARNING_OPENGL__SHADER_H
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glm.hpp>
 
+/**
+ * A uniform location resolved once, up front, so that setting
+ * the uniform later doesn't need any string building or lookups.
+ *
+ * The template parameter is the C++ type of the value the uniform
+ * holds, so the compiler stops us from, say, sending a float to
+ * a mat4. Get one from ShaderProgram::GetUniformHandle<T>().
+ *
+ * Only valid for the shader program that made it!
+ */
+template <typename T>
+struct UniformHandle
+{
+    /// Index of the uniform in its program's uniform table,
+    /// -1 if the program doesn't have it (setting it does nothing)
+    int slot = -1;
+
+    /**
+     * Is this handle pointing at an active uniform?
+     * @return true if the uniform was found in the program
+     */
+    bool IsValid() const { return slot >= 0; }
+};
+
+
+/**
+ * Counts of glUniform* uploads, to see how many redundant
+ * ones the shadowed uniform values saved us.
+ */
+struct UniformUploadStats
+{
+    /// Uploads that actually went to the driver
+    unsigned int issued = 0;
+
+    /// Uploads skipped because the value hadn't changed
+    unsigned int skipped = 0;
+};
+
+/// GL type enum of the uniform type matching a C++ type. Specialized
+/// in ShaderProgram.cpp for all the types a UniformHandle can hold.
+template <typename T>
+unsigned int UniformGLType();
+
+template <> unsigned int UniformGLType<bool>();
+template <> unsigned int UniformGLType<int>();
+template <> unsigned int UniformGLType<float>();
+template <> unsigned int UniformGLType<glm::vec3>();
+template <> unsigned int UniformGLType<glm::vec4>();
+template <> unsigned int UniformGLType<glm::mat3>();
+template <> unsigned int UniformGLType<glm::mat4>();
+
 /**
  * Class to encapsulate the functionality of a GLSL shader
  */
@@ -29,8 +82,45 @@ private:
     /// ID of the shader program this is a part of, used by OpenGL
     unsigned int mProgramID;
 
+    /// Biggest uniform value we shadow, in bytes (a mat4)
+    static constexpr unsigned int MAX_UNIFORM_BYTES = 16 * sizeof(float);
+
+    /**
+     * Everything introspection tells us about one active uniform,
+     * plus a CPU-side copy of the last value we sent to it
+     */
+    struct UniformInfo
+    {
+        /// Location of the uniform in the program
+        int location;
+
+        /// GL type enum of the uniform, e.g. GL_FLOAT_VEC3
+        unsigned int type;
+
+        /// Has a value been uploaded yet? (Until then,
+        /// whatever GL initialized it to is a mystery to us)
+        bool shadowValid = false;
+
+        /// The last value uploaded to this uniform
+        unsigned char shadow[MAX_UNIFORM_BYTES];
+    };
+
+    /// Table of all the active uniforms in the program, filled by
+    /// glGetActiveUniform right after linking
+    std::vector<UniformInfo> mUniforms;
+
+    /// Index into mUniforms of each uniform, by the full name
+    /// the shader uses, e.g. "pointLights[3].position"
+    std::unordered_map<std::string, int> mUniformSlots;
+
+    /// Upload counts across all programs since the last reset
+    static UniformUploadStats sFrameUploadStats;
+
     // Helper functions:
-    unsigned int getUniformLoc(const std::string& uniformName);
+    void IntrospectUniforms();
+    int getUniformSlot(const std::string& uniformName) const;
+    int FindUniformSlot(const std::string& uniformName, unsigned int glType) const;
+    bool ShadowUniform(int slot, const void* data, unsigned int bytes);
 
 public:
 
@@ -38,6 +128,9 @@ public:
     // Constructor
     ShaderProgram(std::string programName, const char* vertexPath, const char* fragmentPath);
 
+    // Constructor, for a compute shader (needs GL 4.3)
+    ShaderProgram(std::string programName, const char* computePath);
+
     /// Default constructor (disabled)
     ShaderProgram() = delete;
 
@@ -47,10 +140,68 @@ public:
     /// Assignment operator
     void operator=(const ShaderProgram &) = delete;
 
+    // ****************************************************************
+
+    /**
+     * Resolve the location of a uniform once so it can be set
+     * over and over without any name lookups.
+     *
+     * Warns if the uniform in the program isn't of type T.
+     *
+     * @tparam T C++ type of the value the uniform holds
+     * @param uniformName full name of the uniform in the shader source
+     * @return handle to pass to SetUniform
+     */
+    template <typename T>
+    UniformHandle<T> GetUniformHandle(const std::string& uniformName) const
+    {
+        UniformHandle<T> handle;
+        handle.slot = FindUniformSlot(uniformName, UniformGLType<T>());
+        return handle;
+    }
+
+    void SetUniform(UniformHandle<bool> handle, bool val);
+    void SetUniform(UniformHandle<int> handle, int val);
+    void SetUniform(UniformHandle<float> handle, float val);
+    void SetUniform(UniformHandle<glm::vec3> handle, const glm::vec3& vec);
+    void SetUniform(UniformHandle<glm::vec4> handle, const glm::vec4& vec);
+    void SetUniform(UniformHandle<glm::mat3> handle, const glm::mat3& mat);
+    void SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4& mat);
+
+    /**
+     * Is there an active uniform with this name in the program?
+     * @param uniformName full name of the uniform in the shader source
+     * @return true if the uniform was found by introspection
+     */
+    bool HasUniform(const std::string& uniformName) const
+    {
+        return mUniformSlots.find(uniformName) != mUniformSlots.end();
+    }
+
+    /**
+     * Get the OpenGL ID of this shader program
+     * @return the OpenGL ID of this shader program
+     */
+    unsigned int GetProgramID() const { return mProgramID; }
+
+    // ****************************************************************
+
+    /**
+     * Get the glUniform* upload counts, across all programs,
+     * since the last call to ResetFrameUploadStats
+     * @return issued & skipped upload counts
+     */
+    static UniformUploadStats GetFrameUploadStats() { return sFrameUploadStats; }
+
+    /// Start counting uploads for a new frame
+    static void ResetFrameUploadStats() { sFrameUploadStats = UniformUploadStats(); }
+
+    // ****************************************************************
+
     void use();
-    void SetBoolUniform(const std::string& uniformName, bool val) const;
-    void SetIntUniform(const std::string& uniformName, int val) const;
-    void set1FUniform(const std::string& uniformName, float val) const;
+    void SetBoolUniform(const std::string& uniformName, bool val);
+    void SetIntUniform(const std::string& uniformName, int val);
+    void set1FUniform(const std::string& uniformName, float val);
     void set3FUniform(const std::string& uniformName, float ary[]);
     void set4FUniform(const std::string& uniformName, float ary[]);
     void SetMat4Uniform(const std::string& uniformName, glm::mat4 mat);
@@ -8,7 +8,10 @@
 #include "Skybox.h"
 
 #include <glad/glad.h>
-#include <stb_image.h>
+
+#include "TextureImage.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
 
 /// Naming convention for the positive x direction (world) face
 const std::string POS_X_IMG_NAME = "pos_x.jpg";
@@ -90,12 +93,6 @@ const std::string SKYBOX_VERT_SHADER_FILEPATH = "../resources/shaders/skybox.ver
 /// Hardcoded filepath to the simple, skybox fragment shader
 const std::string SKYBOX_FRAG_SHADER_FILEPATH = "../resources/shaders/skybox.frag";
 
-/// Uniform name for the projection matrix in shaders
-const std::string SKYBOX_SHADERS_PROJMAT_UNIFORM_NAME = "projMat";
-
-/// Uniform name for the view matrix in shaders
-const std::string SKYBOX_SHADERS_VIEWMAT_UNIFORM_NAME = "viewmat";
-
 /// Uniform name for the samplerCube cubemap sampler in the frag shader
 const std::string CUBEMAP_TEX_UNIFORM_NAME = "skyboxTex";
 
@@ -135,6 +132,8 @@ mSkyboxShaders("skybox shaders",
 
 
     // Set the cubemap texture uniform in the shaders (texture unit 0)
+    // The program has to be bound for this to land in the right place!
+    mSkyboxShaders.use();
     mSkyboxShaders.SetIntUniform(CUBEMAP_TEX_UNIFORM_NAME, 0);
 
 }
@@ -158,36 +157,31 @@ unsigned int Skybox::LoadCubeMap(const std::string &faceTexDir)
 
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
-    // Load each of the face images, one at a time
+    // Decode all the face images at once, on worker threads,
+    // and let the streamer put them together as they finish.
+    // Cubemap faces go top row first, so no flipping, and
+    // the skybox doesn't use mips.
+    TextureImageOptions options;
+    options.isColor = true;
+    options.buildMips = false;
+    options.flipVertically = false;
 
-    // Put 'em together
-    int width, height, numChannels;
     for(int i = 0; i < 6; ++i)
     {
         std::string fullFp = (faceTexDir + '/' + IMG_NAMES[i]);
-
-        // Load the image
-        unsigned char* imgData = stbi_load(fullFp.c_str(), &width, &height,
-                                           &numChannels, 0);
-
-        if (imgData)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB,
-                         width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imgData);
-        }
-        else
-        {
-            std::cout << "Failed to load cubemap texture: " << IMG_NAMES[i] << std::endl;
-        }
-
-        stbi_image_free(imgData);
+        auto image = ThreadPool::Shared().Submit([fullFp, options]() {
+            return LoadTextureImage(fullFp, options);
+        });
+        TextureStreamer::Get().Enqueue(textureID, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                                       std::move(image), fullFp);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
 
     return textureID;
 }
@@ -196,18 +190,13 @@ unsigned int Skybox::LoadCubeMap(const std::string &faceTexDir)
 /**
  * Draw the cubemap to the currently bound framebuffer
  *
- * @param projMat projection matrix to use in shaders
- * @param viewMat view matrix to use in shaders
+ * The projection & view matrices come from the FrameConstants
+ * uniform buffer--the vertex shader strips the translation
+ * out of the view matrix itself.
  */
-void Skybox::Draw(glm::mat4 projMat, glm::mat4 viewMat)
+void Skybox::Draw()
 {
-    // Modify the view matrix to remove the translation portion
-    viewMat = glm::mat4(glm::mat3(viewMat));
-
-    // Set transformation uniforms
     mSkyboxShaders.use();
-    mSkyboxShaders.SetMat4Uniform(SKYBOX_SHADERS_PROJMAT_UNIFORM_NAME, projMat);
-    mSkyboxShaders.SetMat4Uniform(SKYBOX_SHADERS_VIEWMAT_UNIFORM_NAME, viewMat);
 
     // Bind texture
     glActiveTexture(GL_TEXTURE0);
@@ -47,7 +47,7 @@ public:
 
     // ****************************************************************
 
-    void Draw(glm::mat4 projMat, glm::mat4 viewMat);
+    void Draw();
 
 };
 
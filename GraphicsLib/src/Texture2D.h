@@ -17,6 +17,7 @@ enum TextureType
     Diffuse,
     Specular,
     Roughness,
+    Normal,
 };
 
 // TODO docs
@@ -0,0 +1,187 @@
+/**
+ * @file TextureCache.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#include "TextureCache.h"
+#include "FileStamp.h"
+#include "MappedFile.h"
+
+/// First four bytes of every texture cache file
+const char TEXTURE_CACHE_MAGIC[4] = {'M', 'R', 'T', 'C'};
+
+/// Start of a cache file
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+
+    /// The options the texture was cooked with
+    uint32_t requested;
+    uint32_t flags;
+
+    /// What it actually got compressed to (BC1 can become BC3)
+    uint32_t compression;
+    uint32_t channels;
+    uint32_t numMips;
+    uint32_t padding;
+
+    /// Stamp of the image the texture was cooked from
+    FileStamp source;
+};
+
+/// Start of one mip in a cache file; its blocks follow it
+struct MipRecord
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t size;
+};
+
+
+/**
+ * Pack the options that change what gets cooked into some bits
+ * @param options the options
+ * @return the options' flags
+ */
+static uint32_t OptionFlags(const TextureImageOptions& options)
+{
+    return (options.isColor ? 1u : 0u) |
+           (options.buildMips ? 2u : 0u) |
+           (options.flipVertically ? 4u : 0u);
+}
+
+
+
+/**
+ * Get where an image's cache file goes
+ * @param sourcePath path to the image
+ * @return path to its cache file
+ */
+std::string TextureCache::CachePath(const std::string &sourcePath)
+{
+    return sourcePath + ".texcache";
+}
+
+
+
+/**
+ * Load a cooked texture, if there's a cache for it that's up-to-date
+ * with its image and was cooked with the same options.
+ *
+ * @param sourcePath path to the image
+ * @param options the options the texture should be cooked with
+ * @param image filled with the cooked texture
+ * @return true if the cache was good and the image got loaded
+ */
+bool TextureCache::Load(const std::string &sourcePath, const TextureImageOptions &options,
+                        TextureImage &image)
+{
+    MappedFile file;
+    if (!file.Open(CachePath(sourcePath)) || file.GetSize() < sizeof(Header))
+        return false;
+
+    const unsigned char* data = file.GetData();
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TEXTURE_CACHE_VERSION ||
+        header.requested != (uint32_t)options.compression ||
+        header.flags != OptionFlags(options) ||
+        !header.source.Matches(sourcePath))
+    {
+        return false;
+    }
+
+    TextureImage cached;
+    cached.channels = (int)header.channels;
+    cached.compression = (TextureCompression)header.compression;
+
+    size_t offset = sizeof(Header);
+    for (uint32_t i = 0; i < header.numMips; ++i)
+    {
+        if (offset + sizeof(MipRecord) > file.GetSize())
+            return false;
+
+        MipRecord record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(MipRecord);
+
+        if (offset + record.size > file.GetSize())
+            return false;
+
+        MipLevel mip;
+        mip.width = (int)record.width;
+        mip.height = (int)record.height;
+        mip.pixels.assign(data + offset, data + offset + record.size);
+        cached.mips.push_back(std::move(mip));
+        offset += record.size;
+    }
+
+    image = std::move(cached);
+    return image.IsValid();
+}
+
+
+
+/**
+ * Write out the cache file for a cooked texture.
+ *
+ * Writes to a temporary file first and renames it into place. The
+ * temporary name is unique to the thread, since two models can
+ * share an image and cook it at the same time.
+ *
+ * @param sourcePath path to the image
+ * @param options the options the texture was cooked with
+ * @param image the cooked texture
+ * @return true if the cache got written
+ */
+bool TextureCache::Write(const std::string &sourcePath, const TextureImageOptions &options,
+                         const TextureImage &image)
+{
+    Header header = {};
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.requested = (uint32_t)options.compression;
+    header.flags = OptionFlags(options);
+    header.compression = (uint32_t)image.compression;
+    header.channels = (uint32_t)image.channels;
+    header.numMips = (uint32_t)image.mips.size();
+    if (!FileStamp::Read(sourcePath, header.source))
+        return false;
+
+    std::string cachePath = CachePath(sourcePath);
+    std::string tempPath = cachePath + "." +
+            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const MipLevel& mip : image.mips)
+    {
+        MipRecord record;
+        record.width = (uint32_t)mip.width;
+        record.height = (uint32_t)mip.height;
+        record.size = (uint32_t)mip.pixels.size();
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        file.write(reinterpret_cast<const char*>(mip.pixels.data()), mip.pixels.size());
+    }
+
+    file.close();
+    if (!file)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // (rename won't replace an existing file on Windows)
+    std::remove(cachePath.c_str());
+    return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
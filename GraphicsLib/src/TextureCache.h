@@ -0,0 +1,48 @@
+/**
+ * @file TextureCache.h
+ * @author Elijah Gleckler
+ *
+ * Binary cache of a cooked (block-compressed) texture, so
+ * the slow compression only ever happens once per image.
+ *
+ * The cache sits next to the image (<image>.texcache) and holds
+ * the whole compressed mip chain, ready for glCompressedTexImage2D.
+ * Like the mesh cache, it remembers the stamp of the image it was
+ * cooked from (see FileStamp.h) plus the options it was cooked
+ * with, and is ignored (then rewritten) if either changes.
+ *
+ * Layout (native endianness):
+ *
+ *   Header
+ *   for each mip: MipRecord, then its blocks
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURECACHE_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURECACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "TextureImage.h"
+
+/// Bump whenever the layout of a cache file or the encoders change
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+/**
+ * Reads & writes cooked texture cache files
+ */
+class TextureCache
+{
+public:
+
+    static std::string CachePath(const std::string& sourcePath);
+
+    static bool Load(const std::string& sourcePath, const TextureImageOptions& options,
+                     TextureImage& image);
+
+    static bool Write(const std::string& sourcePath, const TextureImageOptions& options,
+                      const TextureImage& image);
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURECACHE_H
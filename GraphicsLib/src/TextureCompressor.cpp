@@ -0,0 +1,412 @@
+/**
+ * @file TextureCompressor.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+
+#include "TextureCompressor.h"
+
+// S3TC (BC1-3) is an extension in GL 3.3, so the
+// loader header might not have these. RGTC (BC4-5) is core.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/// Power iterations when finding a block's principal axis
+const int PRINCIPAL_AXIS_ITERATIONS = 8;
+
+
+/**
+ * Read a 4x4 block of pixels out of an image as RGBA.
+ * Blocks hanging off the edge of small mips repeat the edge pixels.
+ * Gray images become gray RGB, and missing alpha is opaque.
+ *
+ * @param mip the mip level
+ * @param channels channels per pixel in the mip
+ * @param blockX x of the block, in blocks
+ * @param blockY y of the block, in blocks
+ * @param block filled with the block's 16 pixels, row by row
+ */
+static void FetchBlock(const MipLevel& mip, int channels, int blockX, int blockY, uint8_t block[16][4])
+{
+    for (int y = 0; y < 4; ++y)
+    {
+        int py = std::min(blockY * 4 + y, mip.height - 1);
+        for (int x = 0; x < 4; ++x)
+        {
+            int px = std::min(blockX * 4 + x, mip.width - 1);
+            const uint8_t* pixel = &mip.pixels[((size_t)py * mip.width + px) * channels];
+            uint8_t* out = block[y * 4 + x];
+
+            if (channels >= 3)
+            {
+                out[0] = pixel[0];
+                out[1] = pixel[1];
+                out[2] = pixel[2];
+                out[3] = channels == 4 ? pixel[3] : 255;
+            }
+            else
+            {
+                // Data maps only use the first one or two channels,
+                // so these stay in R & G for BC4/BC5 too
+                out[0] = out[1] = out[2] = pixel[0];
+                out[3] = channels == 2 ? pixel[1] : 255;
+                if (channels == 2)
+                    out[1] = pixel[1];
+            }
+        }
+    }
+}
+
+
+
+/**
+ * Pack a color to 5:6:5
+ * @param r red, 0-255
+ * @param g green, 0-255
+ * @param b blue, 0-255
+ * @return the packed color
+ */
+static uint16_t PackColor565(float r, float g, float b)
+{
+    auto quantize = [](float value, int maxValue) {
+        return (int)std::clamp(value * maxValue / 255.0f + 0.5f, 0.0f, (float)maxValue);
+    };
+    return (uint16_t)((quantize(r, 31) << 11) | (quantize(g, 63) << 5) | quantize(b, 31));
+}
+
+
+
+/**
+ * Unpack a 5:6:5 color, the way the GPU will
+ * @param color the packed color
+ * @param rgb filled with the color's red, green & blue, 0-255
+ */
+static void UnpackColor565(uint16_t color, float rgb[3])
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (float)((r << 3) | (r >> 2));
+    rgb[1] = (float)((g << 2) | (g >> 4));
+    rgb[2] = (float)((b << 3) | (b >> 2));
+}
+
+
+
+/**
+ * Encode the color of a 4x4 block as BC1 (4-color mode), 8 bytes:
+ * two 5:6:5 endpoints, then 2 bits per pixel picking one of the
+ * endpoints or a point 1/3 or 2/3 of the way between them.
+ *
+ * @param block the block's pixels as RGBA
+ * @param out where to write the 8 bytes
+ */
+static void EncodeColorBlock(const uint8_t block[16][4], uint8_t* out)
+{
+    // Mean & covariance of the block's colors
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            mean[c] += block[i][c] / 16.0f;
+
+    float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i)
+    {
+        float r = block[i][0] - mean[0];
+        float g = block[i][1] - mean[1];
+        float b = block[i][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    // Principal axis, by power iteration
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < PRINCIPAL_AXIS_ITERATIONS; ++iteration)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+        if (length <= 0.0f)
+            break;
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    // Endpoints: the colors furthest along the axis either way
+    float minProj = 1e30f, maxProj = -1e30f;
+    int minIndex = 0, maxIndex = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        float proj = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+        if (proj < minProj) { minProj = proj; minIndex = i; }
+        if (proj > maxProj) { maxProj = proj; maxIndex = i; }
+    }
+
+    // Pull the endpoints in a little; the extremes are
+    // usually outliers, and it lowers the average error
+    float start[3], end[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        float inset = (block[maxIndex][c] - block[minIndex][c]) / 16.0f;
+        start[c] = block[maxIndex][c] - inset;
+        end[c] = block[minIndex][c] + inset;
+    }
+
+    uint16_t color0 = PackColor565(start[0], start[1], start[2]);
+    uint16_t color1 = PackColor565(end[0], end[1], end[2]);
+
+    // 4-color mode needs color0 > color1
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        float palette[4][3];
+        UnpackColor565(color0, palette[0]);
+        UnpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for (int p = 0; p < 4; ++p)
+            {
+                float dr = block[i][0] - palette[p][0];
+                float dg = block[i][1] - palette[p][1];
+                float db = block[i][2] - palette[p][2];
+                float error = dr * dr + dg * dg + db * db;
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int b = 0; b < 4; ++b)
+        out[4 + b] = (indices >> (b * 8)) & 0xFF;
+}
+
+
+
+/**
+ * Encode one channel of a 4x4 block as BC4, 8 bytes: two 8-bit
+ * endpoints, then 3 bits per pixel picking one of the endpoints
+ * or one of six points evenly between them.
+ *
+ * (BC3's alpha and each half of BC5 are exactly this, too.)
+ *
+ * @param block the block's pixels as RGBA
+ * @param channel which channel to encode
+ * @param out where to write the 8 bytes
+ */
+static void EncodeChannelBlock(const uint8_t block[16][4], int channel, uint8_t* out)
+{
+    int minValue = 255, maxValue = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        minValue = std::min(minValue, (int)block[i][channel]);
+        maxValue = std::max(maxValue, (int)block[i][channel]);
+    }
+
+    // 8-value mode needs endpoint 0 > endpoint 1
+    out[0] = (uint8_t)maxValue;
+    out[1] = (uint8_t)minValue;
+
+    uint64_t indices = 0;
+    if (maxValue > minValue)
+    {
+        float range = (float)(maxValue - minValue);
+        for (int i = 0; i < 16; ++i)
+        {
+            // Steps from endpoint 0 toward endpoint 1...
+            int step = (int)((maxValue - block[i][channel]) * 7.0f / range + 0.5f);
+
+            // ... but the index order is 0, 2, 3, 4, 5, 6, 7, 1
+            int index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+            indices |= (uint64_t)index << (i * 3);
+        }
+    }
+
+    for (int b = 0; b < 6; ++b)
+        out[2 + b] = (indices >> (b * 8)) & 0xFF;
+}
+
+
+
+/**
+ * Get the size of one 4x4 block of a compressed format
+ * @param compression the format
+ * @return bytes per block (0 if not compressed)
+ */
+unsigned int CompressedBlockBytes(TextureCompression compression)
+{
+    switch (compression)
+    {
+        case TextureCompression::BC1:
+        case TextureCompression::BC4:
+            return 8;
+        case TextureCompression::BC3:
+        case TextureCompression::BC5:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+
+
+/**
+ * Get the GL internal format for a compressed format
+ * @param compression the format
+ * @return GL internal format enum (0 if not compressed)
+ */
+unsigned int CompressedGLFormat(TextureCompression compression)
+{
+    switch (compression)
+    {
+        case TextureCompression::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureCompression::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureCompression::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case TextureCompression::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        default:
+            return 0;
+    }
+}
+
+
+
+/**
+ * Can the GPU take textures in a compressed format?
+ * Needs the GL context (the answer is remembered after).
+ *
+ * @param compression the format
+ * @return true if textures can be uploaded in this format
+ */
+bool IsTextureCompressionSupported(TextureCompression compression)
+{
+    // RGTC is core since GL 3.0
+    if (compression != TextureCompression::BC1 && compression != TextureCompression::BC3)
+        return true;
+
+    static const bool s3tcSupported = []() {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (GLint i = 0; i < numExtensions; ++i)
+        {
+            auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (name != nullptr && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                return true;
+        }
+        return false;
+    }();
+    return s3tcSupported;
+}
+
+
+
+/**
+ * Block-compress every mip of an image.
+ * Doesn't touch OpenGL, so it's safe on any thread.
+ *
+ * @param image the uncompressed image
+ * @param compression format to compress to. BC1 becomes BC3
+ *                    if the image has any transparency.
+ * @return the compressed image
+ */
+TextureImage CompressTextureImage(const TextureImage &image, TextureCompression compression)
+{
+    if (compression == TextureCompression::None || !image.IsValid())
+        return image;
+
+    // Only worth the extra bytes if something's actually see-through
+    if (compression == TextureCompression::BC1 && (image.channels == 2 || image.channels == 4))
+    {
+        int alphaChannel = image.channels - 1;
+        const std::vector<unsigned char>& pixels = image.mips[0].pixels;
+        for (size_t i = alphaChannel; i < pixels.size(); i += image.channels)
+        {
+            if (pixels[i] != 255)
+            {
+                compression = TextureCompression::BC3;
+                break;
+            }
+        }
+    }
+
+    TextureImage compressed;
+    compressed.channels = image.channels;
+    compressed.compression = compression;
+
+    unsigned int blockBytes = CompressedBlockBytes(compression);
+    for (const MipLevel& mip : image.mips)
+    {
+        int blocksX = (mip.width + 3) / 4;
+        int blocksY = (mip.height + 3) / 4;
+
+        MipLevel out;
+        out.width = mip.width;
+        out.height = mip.height;
+        out.pixels.resize((size_t)blocksX * blocksY * blockBytes);
+
+        uint8_t block[16][4];
+        uint8_t* dst = out.pixels.data();
+        for (int by = 0; by < blocksY; ++by)
+        {
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                FetchBlock(mip, image.channels, bx, by, block);
+                switch (compression)
+                {
+                    case TextureCompression::BC1:
+                        EncodeColorBlock(block, dst);
+                        break;
+                    case TextureCompression::BC3:
+                        EncodeChannelBlock(block, 3, dst);
+                        EncodeColorBlock(block, dst + 8);
+                        break;
+                    case TextureCompression::BC4:
+                        EncodeChannelBlock(block, 0, dst);
+                        break;
+                    case TextureCompression::BC5:
+                        EncodeChannelBlock(block, 0, dst);
+                        EncodeChannelBlock(block, 1, dst + 8);
+                        break;
+                    default:
+                        break;
+                }
+                dst += blockBytes;
+            }
+        }
+
+        compressed.mips.push_back(std::move(out));
+    }
+
+    return compressed;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file TextureCompressor.h
+ * @author Elijah Gleckler
+ *
+ * CPU encoders for the block-compressed texture formats,
+ * so textures take 4-8x less memory (and bandwidth) on the GPU.
+ *
+ *  - BC1: color maps with no transparency (6:1 vs. RGB)
+ *  - BC3: color maps with transparency (4:1 vs. RGBA)
+ *  - BC4: one channel of data, like specular & roughness maps
+ *         (6:1 vs. the RGB they're usually saved as)
+ *  - BC5: two channels of data, like the XY of normal maps (3:1 vs. RGB)
+ *
+ * Each 4x4 block of pixels gets two endpoint colors, and every
+ * pixel picks a point on the line between them. The encoders fit
+ * that line to the block's principal axis, which is cheap and
+ * looks good enough; the point is to cook textures once (see
+ * TextureCache.h), not to win any quality contests.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURECOMPRESSOR_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURECOMPRESSOR_H
+
+#include "TextureImage.h"
+
+TextureImage CompressTextureImage(const TextureImage& image, TextureCompression compression);
+
+unsigned int CompressedBlockBytes(TextureCompression compression);
+unsigned int CompressedGLFormat(TextureCompression compression);
+bool IsTextureCompressionSupported(TextureCompression compression);
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURECOMPRESSOR_H
@@ -0,0 +1,180 @@
+/**
+ * @file TextureImage.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "TextureImage.h"
+#include "TextureCompressor.h"
+#include "TextureCache.h"
+
+/// Entries in the linear -> sRGB lookup table. Plenty
+/// of precision to round-trip 8-bit values exactly
+const int LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+
+
+/**
+ * Lookup tables for converting between 8-bit sRGB and linear.
+ * Built once; function-local statics are thread-safe to set up.
+ */
+struct SrgbTables
+{
+    /// 8-bit sRGB value -> linear 0..1
+    float toLinear[256];
+
+    /// Linear 0..1 (scaled to the table size) -> 8-bit sRGB value
+    unsigned char toSrgb[LINEAR_TO_SRGB_TABLE_SIZE];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i)
+        {
+            float l = i / float(LINEAR_TO_SRGB_TABLE_SIZE - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = (unsigned char)std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f);
+        }
+    }
+};
+
+
+/**
+ * Get the sRGB lookup tables
+ * @return the sRGB lookup tables
+ */
+static const SrgbTables& GetSrgbTables()
+{
+    static SrgbTables tables;
+    return tables;
+}
+
+
+
+/**
+ * Make the next mip level down from a level: half the size
+ * (rounded down, at least 1), each pixel the average of a 2x2
+ * block. Odd sizes reuse the last row/column at the edge.
+ *
+ * @param src the level to downsample
+ * @param channels channels per pixel
+ * @param isColor average the color channels in linear space?
+ * @return the next smaller level
+ */
+static MipLevel Downsample(const MipLevel& src, int channels, bool isColor)
+{
+    const SrgbTables& tables = GetSrgbTables();
+
+    MipLevel dst;
+    dst.width = std::max(src.width / 2, 1);
+    dst.height = std::max(src.height / 2, 1);
+    dst.pixels.resize((size_t)dst.width * dst.height * channels);
+
+    // Alpha is coverage, not color, so it's never gamma-corrected
+    int colorChannels = isColor ? (channels == 4 || channels == 2 ? channels - 1 : channels) : 0;
+
+    for (int y = 0; y < dst.height; ++y)
+    {
+        int y0 = std::min(y * 2, src.height - 1);
+        int y1 = std::min(y * 2 + 1, src.height - 1);
+        const unsigned char* row0 = &src.pixels[(size_t)y0 * src.width * channels];
+        const unsigned char* row1 = &src.pixels[(size_t)y1 * src.width * channels];
+        unsigned char* out = &dst.pixels[(size_t)y * dst.width * channels];
+
+        for (int x = 0; x < dst.width; ++x)
+        {
+            int x0 = std::min(x * 2, src.width - 1) * channels;
+            int x1 = std::min(x * 2 + 1, src.width - 1) * channels;
+
+            for (int c = 0; c < channels; ++c)
+            {
+                if (c < colorChannels)
+                {
+                    float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] +
+                                tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+                    int index = (int)(sum * 0.25f * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f);
+                    out[x * channels + c] = tables.toSrgb[index];
+                }
+                else
+                {
+                    int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                    out[x * channels + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    return dst;
+}
+
+
+
+/**
+ * Decode an image file and build its whole mip chain.
+ * Doesn't touch OpenGL, so it's safe on any thread.
+ *
+ * The image is flipped vertically (if asked) by hand, instead of
+ * with stbi_set_flip_vertically_on_load: that flag is global,
+ * so flipping it from several threads at once is a race.
+ *
+ * Compressed images come out of their cache if it's up to date,
+ * and otherwise get cooked and cached for next time.
+ *
+ * @param filepath full path to the image
+ * @param options whether to flip, build mips, filter them as color, and compress
+ * @return the image & its mips, or an invalid image if it couldn't be read
+ */
+TextureImage LoadTextureImage(const std::string &filepath, const TextureImageOptions &options)
+{
+    TextureImage image;
+
+    if (options.compression != TextureCompression::None &&
+        TextureCache::Load(filepath, options, image))
+    {
+        return image;
+    }
+
+    int width, height, numChannels;
+    unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &numChannels, 0);
+    if (data == nullptr)
+        return image;
+
+    image.channels = numChannels;
+
+    MipLevel base;
+    base.width = width;
+    base.height = height;
+    base.pixels.resize((size_t)width * height * numChannels);
+
+    // Flip while copying out: GL wants the bottom row first
+    size_t rowSize = (size_t)width * numChannels;
+    for (int y = 0; y < height; ++y)
+    {
+        int srcRow = options.flipVertically ? height - 1 - y : y;
+        std::memcpy(&base.pixels[y * rowSize], data + srcRow * rowSize, rowSize);
+    }
+    stbi_image_free(data);
+
+    image.mips.push_back(std::move(base));
+    while (options.buildMips && (image.mips.back().width > 1 || image.mips.back().height > 1))
+        image.mips.push_back(Downsample(image.mips.back(), numChannels, options.isColor));
+
+    if (options.compression != TextureCompression::None)
+    {
+        image = CompressTextureImage(image, options.compression);
+
+        // Not being able to cache just means cooking again next time
+        TextureCache::Write(filepath, options, image);
+    }
+
+    return image;
+}
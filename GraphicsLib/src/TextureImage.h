@@ -0,0 +1,96 @@
+/**
+ * @file TextureImage.h
+ * @author Elijah Gleckler
+ *
+ * A texture image decoded on the CPU, with its whole mip
+ * chain already built, ready to go straight to glTexImage2D.
+ *
+ * Decoding and downsampling don't touch OpenGL, so they can
+ * (and should) run on worker threads. Getting the image onto
+ * the GPU is the TextureStreamer's job.
+ *
+ * Mips are built with a 2x2 box filter. Color (diffuse) maps
+ * are averaged in linear space, not on the raw sRGB values,
+ * so the small mips don't come out darker than the original.
+ * Data maps (specular, roughness) and alpha are averaged as-is.
+ *
+ * Images can also be block-compressed (see TextureCompressor.h),
+ * which is slow, so the compressed mip chain is cooked once and
+ * cached on disk next to the image (see TextureCache.h).
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTUREIMAGE_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTUREIMAGE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * How a texture image's pixels are stored
+ */
+enum class TextureCompression
+{
+    None,   ///< Plain 8-bit pixels
+    BC1,    ///< RGB, 8 bytes per 4x4 block (DXT1)
+    BC3,    ///< RGBA, 16 bytes per 4x4 block (DXT5)
+    BC4,    ///< One channel, 8 bytes per 4x4 block (RGTC1)
+    BC5,    ///< Two channels, 16 bytes per 4x4 block (RGTC2)
+};
+
+/**
+ * One level of a mip chain
+ */
+struct MipLevel
+{
+    int width = 0;
+    int height = 0;
+
+    /// Tightly packed rows, bottom row first (unless the image wasn't flipped).
+    /// For compressed images, rows of 4x4 blocks instead
+    std::vector<unsigned char> pixels;
+};
+
+/**
+ * A decoded image and its mip chain
+ */
+struct TextureImage
+{
+    /// Color channels per pixel: 1, 2, 3 or 4
+    int channels = 0;
+
+    /// How the pixels are stored
+    TextureCompression compression = TextureCompression::None;
+
+    /// Level 0 is the full image, each after that is half the size
+    std::vector<MipLevel> mips;
+
+    /**
+     * Did the image decode okay?
+     * @return true if there's anything to upload
+     */
+    bool IsValid() const { return !mips.empty(); }
+};
+
+/**
+ * How LoadTextureImage should treat an image
+ */
+struct TextureImageOptions
+{
+    /// Is this a color map (filter its mips in linear space)?
+    bool isColor = false;
+
+    /// Build the whole mip chain, or just keep the full image?
+    bool buildMips = true;
+
+    /// Flip so the bottom row comes first, like GL's texture coordinates
+    /// want? (Cubemap faces are the exception, they go top row first.)
+    bool flipVertically = true;
+
+    /// Block-compress the image (and cache the result next to it)?
+    /// BC1 gets bumped up to BC3 if the image has any transparency.
+    TextureCompression compression = TextureCompression::None;
+};
+
+TextureImage LoadTextureImage(const std::string& filepath, const TextureImageOptions& options);
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTUREIMAGE_H
@@ -0,0 +1,211 @@
+/**
+ * @file TextureRegistry.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <filesystem>
+#include <memory>
+#include <glad/glad.h>
+
+#include "TextureRegistry.h"
+#include "TextureCompressor.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+
+
+/**
+ * Pick the block compression for a kind of material texture.
+ * Needs the GL context, to check the GPU can take it.
+ *
+ * @param type what the texture is for
+ * @return the compression to cook the texture with
+ */
+static TextureCompression CompressionFor(TextureType type)
+{
+    TextureCompression compression = TextureCompression::BC1; // (BC3 if it has alpha)
+    if (type == TextureType::Specular || type == TextureType::Roughness)
+        compression = TextureCompression::BC4;
+    else if (type == TextureType::Normal)
+        compression = TextureCompression::BC5;
+
+    if (!IsTextureCompressionSupported(compression))
+        return TextureCompression::None;
+    return compression;
+}
+
+
+
+/**
+ * Get the one path that names a file, however it's spelled
+ * ("models/a/../b/x.png" and "models/b/x.png" are the same file)
+ *
+ * @param filepath path to the file
+ * @return the canonical path (or just a tidied-up one, if the file's missing)
+ */
+static std::string CanonicalPath(const std::string& filepath)
+{
+    std::error_code error;
+    auto canonical = std::filesystem::weakly_canonical(filepath, error);
+    if (error)
+        return std::filesystem::path(filepath).lexically_normal().string();
+    return canonical.string();
+}
+
+
+
+/**
+ * Get where the registry is kept (null until it's made)
+ * @return the registry's slot
+ */
+static std::unique_ptr<TextureRegistry>& RegistrySlot()
+{
+    static std::unique_ptr<TextureRegistry> registry;
+    return registry;
+}
+
+
+
+/**
+ * Get the registry all the models share
+ * @return the texture registry
+ */
+TextureRegistry &TextureRegistry::Get()
+{
+    std::unique_ptr<TextureRegistry>& registry = RegistrySlot();
+    if (registry == nullptr)
+        registry = std::make_unique<TextureRegistry>();
+    return *registry;
+}
+
+
+
+/**
+ * Delete every texture still loaded, while the context is still
+ * around to delete them in. (The WindowManager does this, before
+ * it ends the context, and shuts the TextureStreamer down after.)
+ */
+void TextureRegistry::Shutdown()
+{
+    std::unique_ptr<TextureRegistry>& registry = RegistrySlot();
+    if (registry == nullptr)
+        return;
+
+    for (auto& entry : registry->mEntries)
+        glDeleteTextures(1, &entry.second.texture.id);
+    registry->mEntries.clear();
+    registry->mIds.clear();
+}
+
+
+
+/**
+ * Get a texture, loading it if nobody has yet.
+ * Every Acquire needs a Release when the texture's done with!
+ *
+ * @param filepath path to the image
+ * @param type what the texture is for
+ * @return the texture
+ */
+TextureData TextureRegistry::Acquire(const std::string &filepath, TextureType type)
+{
+    std::string path = CanonicalPath(filepath);
+    std::string key = path + '|' + std::to_string((int)type);
+
+    auto found = mIds.find(key);
+    if (found != mIds.end())
+    {
+        Entry& entry = mEntries.at(found->second);
+        entry.refCount++;
+        mDedupHits++;
+        return entry.texture;
+    }
+
+    Entry entry;
+    entry.texture = Load(path, type);
+    entry.key = key;
+    entry.refCount = 1;
+    mIds.emplace(key, entry.texture.id);
+    return mEntries.emplace(entry.texture.id, entry).first->second.texture;
+}
+
+
+
+/**
+ * Let go of a texture. Deletes it once nobody's using it.
+ * (Ids the registry didn't hand out are ignored.)
+ *
+ * @param textureId GL id of the texture
+ */
+void TextureRegistry::Release(unsigned int textureId)
+{
+    auto found = mEntries.find(textureId);
+    if (found == mEntries.end())
+        return;
+
+    if (--found->second.refCount > 0)
+        return;
+
+    // It might still be streaming in
+    TextureStreamer::Get().Cancel(textureId);
+    glDeleteTextures(1, &textureId);
+
+    mIds.erase(found->second.key);
+    mEntries.erase(found);
+}
+
+
+
+/**
+ * Start loading a texture: make it, then decode & cook the image
+ * on a worker thread and hand it to the TextureStreamer.
+ *
+ * @param filepath canonical path to the image
+ * @param type what the texture is for
+ * @return the new texture (a placeholder until it streams in)
+ */
+TextureData TextureRegistry::Load(const std::string &filepath, TextureType type)
+{
+    TextureData texture;
+    glGenTextures(1, &texture.id);
+    texture.type = type;
+    texture.filepath = filepath;
+
+    // Specify the wrapping and filtering modes
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Diffuse maps are colors; the others are data, and don't get gamma-corrected
+    TextureImageOptions options;
+    options.isColor = (type == TextureType::Diffuse);
+    options.compression = CompressionFor(type);
+    auto image = ThreadPool::Shared().Submit([filepath, options]() {
+        return LoadTextureImage(filepath, options);
+    });
+    TextureStreamer::Get().Enqueue(texture.id, GL_TEXTURE_2D, GL_TEXTURE_2D,
+                                   std::move(image), filepath);
+
+    return texture;
+}
+
+
+
+/**
+ * Get what's in the registry right now
+ * @return the registry's stats
+ */
+TextureRegistryStats TextureRegistry::GetStats() const
+{
+    TextureRegistryStats stats;
+    stats.uniqueTextures = (unsigned int)mEntries.size();
+    stats.dedupHits = mDedupHits;
+
+    const TextureStreamer& streamer = TextureStreamer::Get();
+    for (const auto& entry : mEntries)
+        stats.bytesResident += streamer.GetResidentBytes(entry.first);
+
+    return stats;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file TextureRegistry.h
+ * @author Elijah Gleckler
+ *
+ * Every material texture in the program, loaded once and shared.
+ *
+ * Textures are looked up by their image's canonical path (and
+ * what they're for, since that decides how the image is cooked),
+ * so two models using the same image share one GL texture, no
+ * matter how they spell the path.
+ *
+ * Each texture is reference-counted: every Mesh using it holds a
+ * reference, and the texture is deleted once the last one lets go.
+ *
+ * Only use this on the GL thread. Whatever textures are still
+ * loaded when the WindowManager ends the context get deleted
+ * then (see Shutdown); releasing them after that does nothing.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTUREREGISTRY_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTUREREGISTRY_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include "Texture2D.h"
+
+/**
+ * What's in the texture registry
+ */
+struct TextureRegistryStats
+{
+    /// Textures currently loaded (or loading)
+    unsigned int uniqueTextures = 0;
+
+    /// Bytes of those textures that have made it onto the GPU
+    size_t bytesResident = 0;
+
+    /// Times a texture was asked for that was already loaded
+    unsigned int dedupHits = 0;
+};
+
+/**
+ * Every material texture in the program, loaded once and shared
+ */
+class TextureRegistry
+{
+private:
+
+    /// One loaded texture
+    struct Entry
+    {
+        TextureData texture;
+
+        /// Key into mIds
+        std::string key;
+
+        /// Meshes (or whoever) holding a reference
+        unsigned int refCount = 0;
+    };
+
+    /// Texture id for each path & type key
+    std::unordered_map<std::string, unsigned int> mIds;
+
+    /// Every loaded texture, by GL id
+    std::unordered_map<unsigned int, Entry> mEntries;
+
+    /// Times a texture was asked for that was already loaded
+    unsigned int mDedupHits = 0;
+
+    TextureData Load(const std::string& filepath, TextureType type);
+
+public:
+
+    /// Default constructor
+    TextureRegistry() = default;
+
+    /// Copy constructor (disabled)
+    TextureRegistry(const TextureRegistry &) = delete;
+
+    /// Assignment operator
+    void operator=(const TextureRegistry &) = delete;
+
+    // ****************************************************************
+
+    static TextureRegistry& Get();
+    static void Shutdown();
+
+    TextureData Acquire(const std::string& filepath, TextureType type);
+    void Release(unsigned int textureId);
+
+    TextureRegistryStats GetStats() const;
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTUREREGISTRY_H
@@ -0,0 +1,364 @@
+/**
+ * @file TextureStreamer.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <glad/glad.h>
+
+#include "TextureStreamer.h"
+#include "TextureCompressor.h"
+
+/// Color of the placeholder textures get until their image is in
+const unsigned char PLACEHOLDER_TEXEL[4] = {128, 128, 128, 255};
+
+
+/**
+ * Constructor. Makes the PBO ring. Needs a current GL context!
+ */
+TextureStreamer::TextureStreamer()
+{
+    mSlots.resize(TEXTURE_UPLOAD_RING_SIZE);
+    for (Slot& slot : mSlots)
+        glGenBuffers(1, &slot.buffer);
+}
+
+
+
+/**
+ * Destructor
+ */
+TextureStreamer::~TextureStreamer()
+{
+    Release();
+}
+
+
+
+/**
+ * Delete the PBO ring & its fences (if they're still there), and
+ * drop whatever was left to stream. Textures stay as they are.
+ */
+void TextureStreamer::Release()
+{
+    for (Slot& slot : mSlots)
+    {
+        if (slot.fence != nullptr)
+            glDeleteSync((GLsync)slot.fence);
+        if (slot.buffer != 0)
+            glDeleteBuffers(1, &slot.buffer);
+        slot = Slot();
+    }
+
+    mRequests.clear();
+    mResidentBytes.clear();
+}
+
+
+
+/**
+ * Get where the streamer is kept (null until it's made)
+ * @return the streamer's slot
+ */
+static std::unique_ptr<TextureStreamer>& StreamerSlot()
+{
+    static std::unique_ptr<TextureStreamer> streamer;
+    return streamer;
+}
+
+
+
+/**
+ * Get the streamer everything uploads textures through.
+ * Made the first time it's asked for, so the first call
+ * has to be on the GL thread, after the context exists.
+ *
+ * @return the texture streamer
+ */
+TextureStreamer &TextureStreamer::Get()
+{
+    std::unique_ptr<TextureStreamer>& streamer = StreamerSlot();
+    if (streamer == nullptr)
+        streamer = std::make_unique<TextureStreamer>();
+    return *streamer;
+}
+
+
+
+/**
+ * Delete the streamer's GL objects, while the context is still
+ * around to delete them in. (The WindowManager does this, before
+ * it ends the context.) Nothing streams after this.
+ */
+void TextureStreamer::Shutdown()
+{
+    std::unique_ptr<TextureStreamer>& streamer = StreamerSlot();
+    if (streamer != nullptr)
+        streamer->Release();
+}
+
+
+
+/**
+ * Hand a texture over to be streamed in.
+ *
+ * The texture gets a 1x1 placeholder right now, so it's safe to
+ * draw with straight away. The caller should set the texture's
+ * wrap & filter modes itself; the streamer only fills in images.
+ *
+ * @param textureId GL id of the texture
+ * @param bindTarget what the texture binds to (GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP)
+ * @param imageTarget what the image goes to (same, or one face of a cubemap)
+ * @param image the texture's image (usually still decoding on a worker thread)
+ * @param filepath path to the image, for error messages
+ */
+void TextureStreamer::Enqueue(unsigned int textureId, unsigned int bindTarget, unsigned int imageTarget,
+                              std::future<TextureImage> image, const std::string &filepath)
+{
+    glBindTexture(bindTarget, textureId);
+    glTexImage2D(imageTarget, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_TEXEL);
+    glTexParameteri(bindTarget, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(bindTarget, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(bindTarget, 0);
+
+    Request request;
+    request.textureId = textureId;
+    request.bindTarget = bindTarget;
+    request.imageTarget = imageTarget;
+    request.filepath = filepath;
+    request.decoding = std::move(image);
+    mRequests.push_back(std::move(request));
+}
+
+
+
+/**
+ * Do this frame's share of the streaming: find out which uploads
+ * have landed and let the textures use them, then start uploads
+ * for the oldest requests until the byte budget or the PBO ring
+ * runs out. Requests still decoding are skipped over, not waited on.
+ */
+void TextureStreamer::Update()
+{
+    mStats.bytesLastFrame = 0;
+    RetireUploads();
+
+    unsigned int bytesUsed = 0;
+    bool outOfRoom = false;
+    auto request = mRequests.begin();
+    while (request != mRequests.end() && !outOfRoom)
+    {
+        if (!request->decoded)
+        {
+            if (request->decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++request;
+                continue;
+            }
+            if (!StartRequest(*request))
+            {
+                request = mRequests.erase(request);
+                continue;
+            }
+        }
+
+        while (request->nextLevel >= 0)
+        {
+            if (!UploadLevel(*request, bytesUsed))
+            {
+                outOfRoom = true;
+                break;
+            }
+        }
+
+        if (request->nextLevel < 0)
+            request = mRequests.erase(request);
+    }
+
+    mStats.bytesLastFrame = bytesUsed;
+    mStats.pendingTextures = (unsigned int)mRequests.size();
+    mStats.uploadsInFlight = 0;
+    for (const Slot& slot : mSlots)
+    {
+        if (slot.fence != nullptr)
+            mStats.uploadsInFlight++;
+    }
+}
+
+
+
+/**
+ * Stop streaming a texture (say, because it's about to be deleted).
+ * Its queued uploads are dropped, and uploads already in flight
+ * won't touch it when they land.
+ *
+ * @param textureId GL id of the texture
+ */
+void TextureStreamer::Cancel(unsigned int textureId)
+{
+    for (auto request = mRequests.begin(); request != mRequests.end();)
+    {
+        if (request->textureId == textureId)
+            request = mRequests.erase(request);
+        else
+            ++request;
+    }
+
+    for (Slot& slot : mSlots)
+    {
+        if (slot.textureId == textureId)
+            slot.textureId = 0;
+    }
+
+    mResidentBytes.erase(textureId);
+}
+
+
+
+/**
+ * Check on the uploads in flight, oldest first. Each one that's
+ * done frees up its PBO, and its mip becomes the texture's new
+ * base level. (GL runs commands in order, so once one isn't done,
+ * none after it are either.)
+ */
+void TextureStreamer::RetireUploads()
+{
+    while (mSlots[mOldestSlot].fence != nullptr)
+    {
+        Slot& slot = mSlots[mOldestSlot];
+        GLenum status = glClientWaitSync((GLsync)slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+
+        glDeleteSync((GLsync)slot.fence);
+        slot.fence = nullptr;
+
+        // Mips land smallest first, so this only ever sharpens the texture
+        if (slot.textureId != 0)
+        {
+            glBindTexture(slot.bindTarget, slot.textureId);
+            glTexParameteri(slot.bindTarget, GL_TEXTURE_MAX_LEVEL, slot.maxLevel);
+            glTexParameteri(slot.bindTarget, GL_TEXTURE_BASE_LEVEL, slot.level);
+            glBindTexture(slot.bindTarget, 0);
+            mResidentBytes[slot.textureId] += slot.bytes;
+        }
+
+        mOldestSlot = (mOldestSlot + 1) % mSlots.size();
+    }
+}
+
+
+
+/**
+ * Take a request's finished image off its worker thread
+ *
+ * @param request a request whose image is done decoding
+ * @return false if the image didn't decode (it keeps its placeholder)
+ */
+bool TextureStreamer::StartRequest(Request &request)
+{
+    request.image = request.decoding.get();
+    request.decoded = true;
+
+    if (!request.image.IsValid())
+    {
+        std::cout
+            << "********************************************************************************" << std::endl
+            << "ERROR IN TEXTURE while loading image at: " << request.filepath << std::endl
+            << "********************************************************************************" << std::endl;
+        return false;
+    }
+
+    request.nextLevel = (int)request.image.mips.size() - 1;
+    return true;
+}
+
+
+
+/**
+ * Upload a request's next mip through the PBO ring.
+ *
+ * The mip is redefined with glTexImage2D (or glCompressedTexImage2D)
+ * straight from the PBO,
+ * so there's no separate allocation step. Until its fence says
+ * it's done, the mip sits outside the texture's base..max range,
+ * so nothing samples it (and nothing waits on it).
+ *
+ * @param request the request to upload from
+ * @param bytesUsed bytes uploaded so far this frame; gets added to
+ * @return false if there's no room left this frame (budget or PBOs)
+ */
+bool TextureStreamer::UploadLevel(Request &request, unsigned int &bytesUsed)
+{
+    MipLevel& mip = request.image.mips[request.nextLevel];
+    auto bytes = (unsigned int)mip.pixels.size();
+
+    // Always let at least one upload through, even if it's
+    // bigger than the whole budget, or it'd never go
+    if (bytesUsed > 0 && bytesUsed + bytes > TEXTURE_UPLOAD_BUDGET)
+        return false;
+
+    Slot& slot = mSlots[mNextSlot];
+    if (slot.fence != nullptr)
+        return false;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (slot.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        slot.capacity = bytes;
+    }
+
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    std::memcpy(dst, mip.pixels.data(), bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // With a PBO bound, the "pointer" is an offset into it
+    glBindTexture(request.bindTarget, request.textureId);
+    if (request.image.compression != TextureCompression::None)
+    {
+        glCompressedTexImage2D(request.imageTarget, request.nextLevel,
+                               CompressedGLFormat(request.image.compression),
+                               mip.width, mip.height, 0, bytes, (void*)0);
+    }
+    else
+    {
+        GLenum colorFormat = GL_RGBA;
+        if (request.image.channels == 1)
+            colorFormat = GL_RED;
+        else if (request.image.channels == 2)
+            colorFormat = GL_RG;
+        else if (request.image.channels == 3)
+            colorFormat = GL_RGB;
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(request.imageTarget, request.nextLevel, colorFormat, mip.width, mip.height, 0,
+                     colorFormat, GL_UNSIGNED_BYTE, (void*)0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    glBindTexture(request.bindTarget, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.textureId = request.textureId;
+    slot.bindTarget = request.bindTarget;
+    slot.level = request.nextLevel;
+    slot.bytes = bytes;
+    slot.maxLevel = (int)request.image.mips.size() - 1;
+    mNextSlot = (mNextSlot + 1) % mSlots.size();
+
+    // The CPU copy of this mip isn't needed anymore
+    mip.pixels = std::vector<unsigned char>();
+    request.nextLevel--;
+    bytesUsed += bytes;
+    return true;
+}
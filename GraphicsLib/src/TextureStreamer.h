@@ -0,0 +1,184 @@
+/**
+ * @file TextureStreamer.h
+ * @author Elijah Gleckler
+ *
+ * Gets decoded texture images onto the GPU a little at a
+ * time, across frames, so loading never stalls a frame.
+ *
+ * Textures are handed over (with their image still decoding
+ * on a worker thread, usually) and get a 1x1 grey placeholder
+ * right away, so anything drawn with them works immediately.
+ * Once the image is decoded, its mips are copied into a ring of
+ * pixel buffer objects and uploaded from there, smallest first,
+ * only so many bytes per frame.
+ *
+ * Uploading from a PBO lets the driver do the actual copy in
+ * the background instead of blocking glTexSubImage2D. Each
+ * upload gets a fence; once it's signalled, the mip is really
+ * on the GPU, and GL_TEXTURE_BASE_LEVEL is lowered to let the
+ * sampler use it. So textures sharpen up as they stream in.
+ *
+ * (Cubemap faces stream the same way, but they only have the one
+ * level, so each face just replaces its placeholder when it lands.)
+ *
+ * Call Update() once a frame (WindowManager::UpdateWindow does).
+ * Its PBOs & fences belong to the GL context, so they go in
+ * Shutdown(), which the WindowManager calls before it ends the
+ * context--not at exit, when the context's long gone.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURESTREAMER_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURESTREAMER_H
+
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureImage.h"
+
+/// Bytes of mip data uploaded per frame, at most. (A single
+/// mip bigger than this still goes, alone in its frame.)
+const unsigned int TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+/// Number of PBOs in the upload ring
+const unsigned int TEXTURE_UPLOAD_RING_SIZE = 8;
+
+/**
+ * What the streamer has left to do
+ */
+struct TextureStreamerStats
+{
+    /// Textures still decoding or uploading
+    unsigned int pendingTextures = 0;
+
+    /// Mips uploaded but not yet known to be on the GPU
+    unsigned int uploadsInFlight = 0;
+
+    /// Bytes uploaded on the last Update()
+    unsigned int bytesLastFrame = 0;
+};
+
+/**
+ * Streams texture images onto the GPU across frames
+ */
+class TextureStreamer
+{
+private:
+
+    /// A texture waiting for (some of) its image to upload
+    struct Request
+    {
+        /// GL id of the texture
+        unsigned int textureId;
+
+        /// What the texture binds to (GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP)
+        unsigned int bindTarget;
+
+        /// What the image goes to (same, or one face of a cubemap)
+        unsigned int imageTarget;
+
+        /// Path to the image, for the error message if it won't decode
+        std::string filepath;
+
+        /// The image, while it's still decoding
+        std::future<TextureImage> decoding;
+
+        /// The image, once it's decoded
+        TextureImage image;
+
+        /// Has the image finished decoding?
+        bool decoded = false;
+
+        /// Next mip to upload; counts down to 0
+        int nextLevel = 0;
+    };
+
+    /// One PBO of the upload ring
+    struct Slot
+    {
+        unsigned int buffer = 0;
+        unsigned int capacity = 0;
+
+        /// Fence after the upload from this PBO (nullptr if idle)
+        void* fence = nullptr;
+
+        /// Texture & mip the upload was for (texture 0 if it got cancelled)
+        unsigned int textureId = 0;
+        unsigned int bindTarget = 0;
+        int level = 0;
+
+        /// Size of the mip
+        unsigned int bytes = 0;
+
+        /// Smallest mip of that texture
+        int maxLevel = 0;
+    };
+
+    /// Textures waiting to upload, oldest first
+    std::deque<Request> mRequests;
+
+    /// The PBO ring
+    std::vector<Slot> mSlots;
+
+    /// Next slot to upload through; slots get reused in order
+    unsigned int mNextSlot = 0;
+
+    /// Oldest slot that might still be in flight
+    unsigned int mOldestSlot = 0;
+
+    /// Bytes of each texture that have landed on the GPU
+    std::unordered_map<unsigned int, size_t> mResidentBytes;
+
+    /// What the last Update() did
+    TextureStreamerStats mStats;
+
+    void RetireUploads();
+    bool StartRequest(Request& request);
+    bool UploadLevel(Request& request, unsigned int& bytesUsed);
+    void Release();
+
+public:
+
+    TextureStreamer();
+
+    /// Copy constructor (disabled)
+    TextureStreamer(const TextureStreamer &) = delete;
+
+    /// Assignment operator
+    void operator=(const TextureStreamer &) = delete;
+
+    ~TextureStreamer();
+
+    // ****************************************************************
+
+    static TextureStreamer& Get();
+    static void Shutdown();
+
+    void Enqueue(unsigned int textureId, unsigned int bindTarget, unsigned int imageTarget,
+                 std::future<TextureImage> image, const std::string& filepath);
+    void Update();
+    void Cancel(unsigned int textureId);
+
+    /**
+     * Get how much of a texture has made it onto the GPU
+     * @param textureId GL id of the texture
+     * @return bytes of the texture's mips that have landed
+     */
+    size_t GetResidentBytes(unsigned int textureId) const
+    {
+        auto found = mResidentBytes.find(textureId);
+        return found != mResidentBytes.end() ? found->second : 0;
+    }
+
+    /**
+     * Get what the streamer has left to do, as of the last Update()
+     * @return the streamer's stats
+     */
+    const TextureStreamerStats& GetStats() const { return mStats; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_TEXTURESTREAMER_H
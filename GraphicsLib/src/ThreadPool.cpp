@@ -0,0 +1,202 @@
+/**
+ * @file ThreadPool.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "ThreadPool.h"
+
+
+/**
+ * What the threads working on one ParallelFor share
+ */
+struct ParallelForState
+{
+    /// The function doing the items
+    const std::function<void(unsigned int, unsigned int)>* body;
+
+    /// Number of items
+    unsigned int count;
+
+    /// Items per chunk (the last one can have fewer)
+    unsigned int perChunk;
+
+    /// Number of chunks
+    unsigned int numChunks;
+
+    /// Next chunk nobody's claimed yet
+    std::atomic<unsigned int> nextChunk{0};
+
+    /// Guards chunksDone & error
+    std::mutex mutex;
+
+    /// Chunks finished so far
+    unsigned int chunksDone = 0;
+
+    /// Signalled when the last chunk finishes
+    std::condition_variable allDone;
+
+    /// First exception a chunk threw, if any
+    std::exception_ptr error;
+};
+
+
+
+/**
+ * Claim & run chunks of a ParallelFor until there are none left
+ * @param state the ParallelFor's shared state
+ */
+static void RunChunks(ParallelForState& state)
+{
+    while (true)
+    {
+        unsigned int chunk = state.nextChunk++;
+        if (chunk >= state.numChunks)
+            return;
+
+        unsigned int begin = chunk * state.perChunk;
+        unsigned int end = std::min(begin + state.perChunk, state.count);
+
+        std::exception_ptr error;
+        try
+        {
+            (*state.body)(begin, end);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (error && !state.error)
+            state.error = error;
+        if (++state.chunksDone == state.numChunks)
+            state.allDone.notify_all();
+    }
+}
+
+
+/**
+ * Constructor. Starts up the workers.
+ *
+ * @param numThreads how many workers to start. 0 means one
+ *                   per core, minus one for the main thread
+ */
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    if (numThreads == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        numThreads = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (unsigned int i = 0; i < numThreads; ++i)
+        mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+
+
+/**
+ * Destructor. Lets the workers finish the jobs
+ * already queued, then waits for them to quit.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mJobReady.notify_all();
+
+    for (std::thread& worker : mWorkers)
+        worker.join();
+}
+
+
+
+/**
+ * Get the pool shared by the whole renderer
+ * @return the shared thread pool
+ */
+ThreadPool &ThreadPool::Shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+
+
+/**
+ * What each worker does: take jobs off the queue and
+ * run them, until the pool stops and the queue is empty.
+ */
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobReady.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+
+            if (mJobs.empty())
+                return;
+
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        job();
+    }
+}
+
+
+
+/**
+ * Split [0, count) into chunks and run body(begin, end) on each,
+ * spread over the workers and the calling thread, then wait for
+ * them all. Small counts just run on the calling thread.
+ *
+ * The chunks get claimed off a counter. Helper jobs go to the front
+ * of the queue, ahead of any asset jobs, and the calling thread claims
+ * chunks too, so whatever no worker got to in time, it runs itself.
+ * It only ever waits on chunks that are already running (which also
+ * makes this safe to call from inside a job).
+ *
+ * @param count number of items
+ * @param minPerJob fewest items worth handing to another thread
+ * @param body function doing the items from begin to (not including) end
+ */
+void ThreadPool::ParallelFor(unsigned int count, unsigned int minPerJob,
+                             const std::function<void(unsigned int, unsigned int)> &body)
+{
+    unsigned int numJobs = std::min(GetNumThreads() + 1, count / std::max(minPerJob, 1u));
+    if (numJobs <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    // (Helpers can start after it's all over, so they share the state)
+    auto state = std::make_shared<ParallelForState>();
+    state->body = &body;
+    state->count = count;
+    state->perChunk = (count + numJobs - 1) / numJobs;
+    state->numChunks = (count + state->perChunk - 1) / state->perChunk;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (unsigned int i = 1; i < state->numChunks; ++i)
+            mJobs.emplace_front([state]() { RunChunks(*state); });
+    }
+    mJobReady.notify_all();
+
+    RunChunks(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->allDone.wait(lock, [&state]() { return state->chunksDone == state->numChunks; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
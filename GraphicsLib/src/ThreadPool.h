@@ -0,0 +1,107 @@
+/**
+ * @file ThreadPool.h
+ * @author Elijah Gleckler
+ *
+ * A fixed bunch of worker threads that run jobs off a queue.
+ *
+ * Meant for CPU work that doesn't touch OpenGL (parsing models,
+ * decoding images, crunching transforms...). Anything that needs
+ * the GL context has to go back to the thread that owns it, so
+ * jobs typically do the heavy lifting and hand their results back
+ * through the std::future Submit() returns.
+ *
+ * Shared() is the pool the whole renderer uses, so we don't end
+ * up with a pile of pools each spinning up a thread per core.
+ *
+ * That puts long asset jobs (model imports, texture decodes) in the
+ * same queue as per-frame work (ParallelFor), so ParallelFor never
+ * waits on a job still in the queue: its helper jobs go to the front,
+ * and the calling thread runs whatever chunks nobody's started yet
+ * itself.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_THREADPOOL_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed bunch of worker threads that run jobs off a queue
+ */
+class ThreadPool
+{
+private:
+
+    /// The worker threads
+    std::vector<std::thread> mWorkers;
+
+    /// Jobs waiting for a worker
+    std::deque<std::function<void()>> mJobs;
+
+    /// Guards mJobs & mStopping
+    std::mutex mMutex;
+
+    /// Signalled when a job is queued, or the pool is stopping
+    std::condition_variable mJobReady;
+
+    /// Set when the pool is destroyed, so the workers quit
+    bool mStopping = false;
+
+    void WorkerLoop();
+
+public:
+
+    explicit ThreadPool(unsigned int numThreads = 0);
+
+    /// Copy constructor (disabled)
+    ThreadPool(const ThreadPool &) = delete;
+
+    /// Assignment operator
+    void operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool();
+
+    // ****************************************************************
+
+    static ThreadPool& Shared();
+
+    void ParallelFor(unsigned int count, unsigned int minPerJob,
+                     const std::function<void(unsigned int, unsigned int)>& body);
+
+    /**
+     * Queue up a job for the workers
+     *
+     * @param job anything callable with no arguments
+     * @return future for the job's result (or the exception it threw)
+     */
+    template <class Job>
+    auto Submit(Job&& job) -> std::future<decltype(job())>
+    {
+        // std::function needs something copyable, and packaged_task isn't
+        using Result = decltype(job());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Job>(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.emplace_back([task]() { (*task)(); });
+        }
+        mJobReady.notify_one();
+        return result;
+    }
+
+    /**
+     * Get the number of worker threads
+     * @return the number of worker threads
+     */
+    unsigned int GetNumThreads() const { return (unsigned int)mWorkers.size(); }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_THREADPOOL_H
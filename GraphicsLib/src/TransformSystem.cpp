@@ -0,0 +1,407 @@
+/**
+ * @file TransformSystem.cpp
+ * @author Elijah Gleckler
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_SYSTEM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "TransformSystem.h"
+#include "ThreadPool.h"
+
+/// Fewest dirty transforms worth handing to another thread
+const unsigned int TRANSFORMS_PER_JOB = 2048;
+
+
+/**
+ * Make a new transform at the origin, unrotated, with scale 1
+ *
+ * @param localBounds model-space bounding box of what it moves
+ * @return id of the new transform
+ */
+unsigned int TransformSystem::Create(const AABB &localBounds)
+{
+    unsigned int id;
+    if (!mFreeIds.empty())
+    {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    }
+    else
+    {
+        id = (unsigned int)mPositions.size();
+        mPositions.emplace_back();
+        mRotationAxes.emplace_back();
+        mRotationAngles.emplace_back();
+        mScales.emplace_back();
+        mLocalBounds.emplace_back();
+        mModelMatrices.emplace_back();
+        mNormalMatrices.emplace_back();
+        mWorldBounds.emplace_back();
+        mDirty.push_back(0);
+        mAlive.push_back(0);
+    }
+    mAlive[id] = 1;
+
+    mPositions[id] = glm::vec3(0.0f);
+    mRotationAxes[id] = glm::vec3(1.0f, 0.0f, 0.0f);
+    mRotationAngles[id] = 0.0f;
+    mScales[id] = glm::vec3(1.0f);
+    mLocalBounds[id] = localBounds;
+    mModelMatrices[id] = glm::mat4(1.0f);
+    mNormalMatrices[id] = glm::mat3(1.0f);
+    mWorldBounds[id] = localBounds;
+
+    return id;
+}
+
+
+
+/**
+ * Give a transform's id back, to be reused. Ids that aren't
+ * in use (never made, or already destroyed) are ignored, so
+ * two later Create()s can't end up sharing one transform.
+ *
+ * @param id the transform's id
+ */
+void TransformSystem::Destroy(unsigned int id)
+{
+    if (id >= mAlive.size() || !mAlive[id])
+    {
+        std::cout
+        << "****************************************************************" << std::endl
+        << "WARNING::TRANSFORM_SYSTEM::Destroying transform " << id << "," << std::endl
+        << "which isn't in use; ignoring it" << std::endl
+        << "****************************************************************" << std::endl;
+        return;
+    }
+    mAlive[id] = 0;
+
+    // Don't let the next Update() rebuild it for whoever gets the id next
+    if (mDirty[id])
+    {
+        mDirty[id] = 0;
+        mDirtyList.erase(std::find(mDirtyList.begin(), mDirtyList.end(), id));
+    }
+
+    mFreeIds.push_back(id);
+}
+
+
+
+/**
+ * Queue a transform up for the next Update()
+ * @param id the transform's id
+ */
+void TransformSystem::MarkDirty(unsigned int id)
+{
+    if (!mDirty[id])
+    {
+        mDirty[id] = 1;
+        mDirtyList.push_back(id);
+    }
+}
+
+
+
+/**
+ * Set the position of a transform. Only marks it dirty if it moved,
+ * so setting the same position every frame stays free.
+ *
+ * @param id the transform's id
+ * @param pos new position in world space
+ */
+void TransformSystem::SetPosition(unsigned int id, const glm::vec3 &pos)
+{
+    if (mPositions[id] != pos)
+    {
+        mPositions[id] = pos;
+        MarkDirty(id);
+    }
+}
+
+
+
+/**
+ * Set the rotation of a transform
+ *
+ * @param id the transform's id
+ * @param rads angle in radians
+ * @param axis axis of rotation (normalized!)
+ */
+void TransformSystem::SetRotation(unsigned int id, float rads, const glm::vec3 &axis)
+{
+    if (mRotationAngles[id] != rads || mRotationAxes[id] != axis)
+    {
+        mRotationAngles[id] = rads;
+        mRotationAxes[id] = axis;
+        MarkDirty(id);
+    }
+}
+
+
+
+/**
+ * Set the scale of a transform
+ *
+ * @param id the transform's id
+ * @param scale new xyz scale
+ */
+void TransformSystem::SetScale(unsigned int id, const glm::vec3 &scale)
+{
+    if (mScales[id] != scale)
+    {
+        mScales[id] = scale;
+        MarkDirty(id);
+    }
+}
+
+
+
+/**
+ * Rebuild the matrices & world bounds of every transform
+ * that changed since the last call, and nothing else.
+ *
+ * Big batches get split across the shared ThreadPool; each
+ * job only touches its own transforms, so no locking.
+ */
+void TransformSystem::Update()
+{
+    mUpdatedList.clear();
+    if (mDirtyList.empty())
+        return;
+
+    ThreadPool::Shared().ParallelFor((unsigned int)mDirtyList.size(), TRANSFORMS_PER_JOB,
+                                     [this](unsigned int begin, unsigned int end) {
+                                         UpdateRange(begin, end);
+                                     });
+
+    for (unsigned int id : mDirtyList)
+        mDirty[id] = 0;
+    mDirtyList.swap(mUpdatedList);
+}
+
+
+
+/**
+ * Rebuild the transforms in a range of the dirty list.
+ *
+ * With SSE, four transforms at a time: each one's axis, angle, scale,
+ * position & local bounds get gathered into a lane, so every step of
+ * building the matrices and bounds (see UpdateScalar) is done for all
+ * four by one instruction. Only the sines & cosines stay scalar.
+ *
+ * @param begin first index in the dirty list
+ * @param end one past the last index in the dirty list
+ */
+void TransformSystem::UpdateRange(unsigned int begin, unsigned int end)
+{
+    unsigned int i = begin;
+
+#ifdef TRANSFORM_SYSTEM_USE_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        const unsigned int ids[4] = {mDirtyList[i], mDirtyList[i + 1], mDirtyList[i + 2], mDirtyList[i + 3]};
+
+        // One transform per lane
+        auto gather = [&ids](auto get) {
+            return _mm_setr_ps(get(ids[0]), get(ids[1]), get(ids[2]), get(ids[3]));
+        };
+
+        __m128 ax = gather([this](unsigned int id) { return mRotationAxes[id].x; });
+        __m128 ay = gather([this](unsigned int id) { return mRotationAxes[id].y; });
+        __m128 az = gather([this](unsigned int id) { return mRotationAxes[id].z; });
+        __m128 c = gather([this](unsigned int id) { return std::cos(mRotationAngles[id]); });
+        __m128 s = gather([this](unsigned int id) { return std::sin(mRotationAngles[id]); });
+        __m128 sx = gather([this](unsigned int id) { return mScales[id].x; });
+        __m128 sy = gather([this](unsigned int id) { return mScales[id].y; });
+        __m128 sz = gather([this](unsigned int id) { return mScales[id].z; });
+        __m128 px = gather([this](unsigned int id) { return mPositions[id].x; });
+        __m128 py = gather([this](unsigned int id) { return mPositions[id].y; });
+        __m128 pz = gather([this](unsigned int id) { return mPositions[id].z; });
+        __m128 t = _mm_sub_ps(one, c);
+
+        // Rotation matrix columns (Rodrigues)
+        __m128 txx = _mm_mul_ps(_mm_mul_ps(t, ax), ax);
+        __m128 txy = _mm_mul_ps(_mm_mul_ps(t, ax), ay);
+        __m128 txz = _mm_mul_ps(_mm_mul_ps(t, ax), az);
+        __m128 tyy = _mm_mul_ps(_mm_mul_ps(t, ay), ay);
+        __m128 tyz = _mm_mul_ps(_mm_mul_ps(t, ay), az);
+        __m128 tzz = _mm_mul_ps(_mm_mul_ps(t, az), az);
+        __m128 sax = _mm_mul_ps(s, ax);
+        __m128 say = _mm_mul_ps(s, ay);
+        __m128 saz = _mm_mul_ps(s, az);
+
+        __m128 r[3][3] = {
+            {_mm_add_ps(txx, c), _mm_add_ps(txy, saz), _mm_sub_ps(txz, say)},
+            {_mm_sub_ps(txy, saz), _mm_add_ps(tyy, c), _mm_add_ps(tyz, sax)},
+            {_mm_add_ps(txz, say), _mm_sub_ps(tyz, sax), _mm_add_ps(tzz, c)}
+        };
+
+        // Model matrix columns: rotation times scale, then the position.
+        // Normal matrix columns: rotation over scale (0 for a scale of 0)
+        __m128 scale[3] = {sx, sy, sz};
+        __m128 m[4][4];
+        __m128 n[3][3];
+        for (int col = 0; col < 3; ++col)
+        {
+            __m128 inv = _mm_and_ps(_mm_div_ps(one, scale[col]), _mm_cmpneq_ps(scale[col], zero));
+            for (int row = 0; row < 3; ++row)
+            {
+                m[col][row] = _mm_mul_ps(r[col][row], scale[col]);
+                n[col][row] = _mm_mul_ps(r[col][row], inv);
+            }
+            m[col][3] = zero;
+        }
+        m[3][0] = px;
+        m[3][1] = py;
+        m[3][2] = pz;
+        m[3][3] = one;
+
+        // World bounds (see AABB::Transformed): the center moves
+        // with the matrix, the extents with its absolute value
+        __m128 lc[3];
+        __m128 le[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m128 lo = gather([this, axis](unsigned int id) { return mLocalBounds[id].min[axis]; });
+            __m128 hi = gather([this, axis](unsigned int id) { return mLocalBounds[id].max[axis]; });
+            lc[axis] = _mm_mul_ps(_mm_add_ps(lo, hi), _mm_set1_ps(0.5f));
+            le[axis] = _mm_mul_ps(_mm_sub_ps(hi, lo), _mm_set1_ps(0.5f));
+        }
+
+        __m128 wmin[3];
+        __m128 wmax[3];
+        for (int row = 0; row < 3; ++row)
+        {
+            __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][row], lc[0]), _mm_mul_ps(m[1][row], lc[1])),
+                                       _mm_add_ps(_mm_mul_ps(m[2][row], lc[2]), m[3][row]));
+            __m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, m[0][row]), le[0]),
+                                                  _mm_mul_ps(_mm_andnot_ps(signMask, m[1][row]), le[1])),
+                                       _mm_mul_ps(_mm_andnot_ps(signMask, m[2][row]), le[2]));
+            wmin[row] = _mm_sub_ps(center, extent);
+            wmax[row] = _mm_add_ps(center, extent);
+        }
+
+        // Back to one transform each. The model matrix columns are
+        // 4 floats, so a transpose lines a lane up with each of them
+        for (int col = 0; col < 4; ++col)
+        {
+            __m128 x = m[col][0], y = m[col][1], z = m[col][2], w = m[col][3];
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(&mModelMatrices[ids[0]][col].x, x);
+            _mm_storeu_ps(&mModelMatrices[ids[1]][col].x, y);
+            _mm_storeu_ps(&mModelMatrices[ids[2]][col].x, z);
+            _mm_storeu_ps(&mModelMatrices[ids[3]][col].x, w);
+        }
+
+        // The rest are 3 floats, which a 4-wide store would run past
+        alignas(16) float lanes[3][3][4];
+        for (int col = 0; col < 3; ++col)
+        {
+            for (int row = 0; row < 3; ++row)
+                _mm_store_ps(lanes[col][row], n[col][row]);
+        }
+        alignas(16) float lo[3][4];
+        alignas(16) float hi[3][4];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            _mm_store_ps(lo[axis], wmin[axis]);
+            _mm_store_ps(hi[axis], wmax[axis]);
+        }
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            unsigned int id = ids[lane];
+            glm::mat3& normal = mNormalMatrices[id];
+            for (int col = 0; col < 3; ++col)
+                normal[col] = glm::vec3(lanes[col][0][lane], lanes[col][1][lane], lanes[col][2][lane]);
+
+            // Empty boxes stay empty
+            if (mLocalBounds[id].IsEmpty())
+            {
+                mWorldBounds[id] = mLocalBounds[id];
+                continue;
+            }
+            mWorldBounds[id].min = glm::vec3(lo[0][lane], lo[1][lane], lo[2][lane]);
+            mWorldBounds[id].max = glm::vec3(hi[0][lane], hi[1][lane], hi[2][lane]);
+        }
+    }
+#endif
+
+    // Whatever's left over (or everything, without SSE)
+    UpdateScalar(i, end);
+}
+
+
+
+/**
+ * Rebuild the transforms in a range of the dirty list, one at a time.
+ *
+ * Builds T*R*S directly: the rotation comes from the axis/angle
+ * (Rodrigues), each column gets its scale, and the translation
+ * goes in the last column. No matrix multiplies, and the normal
+ * matrix is just R with each column divided by its scale--for a
+ * uniform scale that's a single multiply.
+ *
+ * @param begin first index in the dirty list
+ * @param end one past the last index in the dirty list
+ */
+void TransformSystem::UpdateScalar(unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        unsigned int id = mDirtyList[i];
+
+        const glm::vec3& axis = mRotationAxes[id];
+        const glm::vec3& scale = mScales[id];
+        float c = std::cos(mRotationAngles[id]);
+        float s = std::sin(mRotationAngles[id]);
+        float t = 1.0f - c;
+
+        // Rotation matrix columns
+        glm::vec3 r0(t * axis.x * axis.x + c,
+                     t * axis.x * axis.y + s * axis.z,
+                     t * axis.x * axis.z - s * axis.y);
+        glm::vec3 r1(t * axis.x * axis.y - s * axis.z,
+                     t * axis.y * axis.y + c,
+                     t * axis.y * axis.z + s * axis.x);
+        glm::vec3 r2(t * axis.x * axis.z + s * axis.y,
+                     t * axis.y * axis.z - s * axis.x,
+                     t * axis.z * axis.z + c);
+
+        glm::mat4& model = mModelMatrices[id];
+        model[0] = glm::vec4(r0 * scale.x, 0.0f);
+        model[1] = glm::vec4(r1 * scale.y, 0.0f);
+        model[2] = glm::vec4(r2 * scale.z, 0.0f);
+        model[3] = glm::vec4(mPositions[id], 1.0f);
+
+        glm::mat3& normal = mNormalMatrices[id];
+        if (scale.x == scale.y && scale.y == scale.z)
+        {
+            // Uniform scale: the normal matrix is the rotation, scaled
+            float inv = scale.x != 0.0f ? 1.0f / scale.x : 0.0f;
+            normal[0] = r0 * inv;
+            normal[1] = r1 * inv;
+            normal[2] = r2 * inv;
+        }
+        else
+        {
+            normal[0] = r0 * (scale.x != 0.0f ? 1.0f / scale.x : 0.0f);
+            normal[1] = r1 * (scale.y != 0.0f ? 1.0f / scale.y : 0.0f);
+            normal[2] = r2 * (scale.z != 0.0f ? 1.0f / scale.z : 0.0f);
+        }
+
+        mWorldBounds[id] = mLocalBounds[id].Transformed(model);
+    }
+}
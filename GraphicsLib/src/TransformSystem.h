@@ -0,0 +1,141 @@
+/**
+ * @file TransformSystem.h
+ * @author Elijah Gleckler
+ *
+ * Stores the transforms of every RenderObject, and
+ * only recomputes the ones that actually changed.
+ *
+ * Everything is kept structure-of-arrays style: one array of
+ * positions, one of rotations, one of scales, one of model
+ * matrices, and so on, indexed by a transform id. Setting a
+ * position/rotation/scale marks the transform dirty, and
+ * Update() rebuilds just the dirty ones, in one batch, split
+ * across the thread pool when there are lots of them.
+ *
+ * A static object (like Sponza) gets its matrices built once
+ * and then costs nothing per frame.
+ *
+ * The matrices are built straight from the translation,
+ * rotation and scale, so the normal matrix never needs a
+ * general 4x4 inverse: the inverse transpose of R*S is R*S^-1.
+ * With SSE, four transforms get built at once, one per lane
+ * (like the FrustumCuller tests four boxes at once).
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_TRANSFORMSYSTEM_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_TRANSFORMSYSTEM_H
+
+#include <vector>
+#include <glm.hpp>
+
+#include "bounds.h"
+
+/**
+ * Stores the transforms of every RenderObject
+ */
+class TransformSystem
+{
+private:
+
+    /// Position in world space of each transform
+    std::vector<glm::vec3> mPositions;
+
+    /// Rotation axis (normalized) of each transform
+    std::vector<glm::vec3> mRotationAxes;
+
+    /// Rotation angle, in radians, of each transform
+    std::vector<float> mRotationAngles;
+
+    /// Scale of each transform
+    std::vector<glm::vec3> mScales;
+
+    /// Model-space bounding box of what each transform moves
+    std::vector<AABB> mLocalBounds;
+
+    /// Model matrix of each transform, as of the last Update()
+    std::vector<glm::mat4> mModelMatrices;
+
+    /// Normal matrix of each transform, as of the last Update()
+    std::vector<glm::mat3> mNormalMatrices;
+
+    /// World-space bounding box of each transform, as of the last Update()
+    std::vector<AABB> mWorldBounds;
+
+    /// Is each transform waiting in mDirtyList?
+    std::vector<unsigned char> mDirty;
+
+    /// Transforms changed since the last Update()
+    std::vector<unsigned int> mDirtyList;
+
+    /// Transforms the last Update() rebuilt
+    std::vector<unsigned int> mUpdatedList;
+
+    /// Ids of destroyed transforms, to hand out again
+    std::vector<unsigned int> mFreeIds;
+
+    /// Is each id in use (made, and not destroyed since)?
+    std::vector<unsigned char> mAlive;
+
+    void MarkDirty(unsigned int id);
+    void UpdateRange(unsigned int begin, unsigned int end);
+    void UpdateScalar(unsigned int begin, unsigned int end);
+
+public:
+
+    /// Default constructor
+    TransformSystem() = default;
+
+    /// Copy constructor (disabled)
+    TransformSystem(const TransformSystem &) = delete;
+
+    /// Assignment operator
+    void operator=(const TransformSystem &) = delete;
+
+    // ****************************************************************
+
+    unsigned int Create(const AABB& localBounds);
+    void Destroy(unsigned int id);
+
+    void SetPosition(unsigned int id, const glm::vec3& pos);
+    void SetRotation(unsigned int id, float rads, const glm::vec3& axis);
+    void SetScale(unsigned int id, const glm::vec3& scale);
+
+    void Update();
+
+    /**
+     * Get the model matrix of a transform, as of the last Update()
+     * @param id the transform's id
+     * @return the model matrix
+     */
+    const glm::mat4& GetModelMatrix(unsigned int id) const { return mModelMatrices[id]; }
+
+    /**
+     * Get the normal matrix of a transform, as of the last Update()
+     * @param id the transform's id
+     * @return the normal matrix
+     */
+    const glm::mat3& GetNormalMatrix(unsigned int id) const { return mNormalMatrices[id]; }
+
+    /**
+     * Get the world-space bounding box of a transform, as of the last Update()
+     * @param id the transform's id
+     * @return the model-space bounds, moved by the model matrix
+     */
+    const AABB& GetWorldBounds(unsigned int id) const { return mWorldBounds[id]; }
+
+    /**
+     * Get how many transforms the last Update() rebuilt
+     * @return the number of transforms rebuilt
+     */
+    unsigned int GetNumUpdated() const { return (unsigned int)mUpdatedList.size(); }
+
+    /**
+     * Get which transforms the last Update() rebuilt, so copies
+     * of them (like on the GPU) can be patched up
+     * @return ids of the transforms rebuilt
+     */
+    const std::vector<unsigned int>& GetUpdatedIds() const { return mUpdatedList; }
+
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_TRANSFORMSYSTEM_H
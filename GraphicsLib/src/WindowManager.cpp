@@ -12,6 +12,14 @@
 #include "WindowManager.h"
 #include "Scene.h"
 #include "Camera.h"
+#include "FrameConstants.h"
+#include "TextureStreamer.h"
+#include "MeshBuffer.h"
+#include "TextureRegistry.h"
+
+/// GL versions (major, minor) to try for GLContextMode::GPUDriven, newest first.
+/// 4.3 is the oldest with compute shaders & multi-draw-indirect
+const int GPU_DRIVEN_GL_VERSIONS[][2] = {{4, 6}, {4, 5}, {4, 3}};
 
 /**
  * Constructor
@@ -25,8 +33,9 @@
  *
  * @param screenWidth width of created window
  * @param screenHeight height of create window
+ * @param mode what kind of GL context to make
  */
-WindowManager::WindowManager(int screenWidth, int screenHeight)
+WindowManager::WindowManager(int screenWidth, int screenHeight, GLContextMode mode)
 {
 
     //
@@ -35,8 +44,6 @@ WindowManager::WindowManager(int screenWidth, int screenHeight)
 
     // Instantiate the GLFW window
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 
@@ -72,11 +79,54 @@ WindowManager::WindowManager(int screenWidth, int screenHeight)
 
     glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, GLFW_FALSE);
 
+#endif
+
+    // A GL 4.3 context is no use if glad was only generated for 3.3:
+    // none of the compute or indirect draw functions would be loaded
+#ifndef GL_VERSION_4_3
+    if (mode == GLContextMode::GPUDriven)
+    {
+        std::cout
+        << "****************************************************************" << std::endl
+        << "WARNING::WINDOW::glad wasn't generated for GL 4.3+, so there's" << std::endl
+        << "no GPU-driven rendering; falling back to GL 3.3" << std::endl
+        << "****************************************************************" << std::endl;
+        mode = GLContextMode::Core33;
+    }
 #endif
 
     // Next, we're required to create a window object
-    // Intialize the mWindow member
-    mWindow = glfwCreateWindow(screenWidth,screenHeight,"TODO", nullptr, nullptr);
+    // Intialize the mWindow member. For GPU-driven rendering, take
+    // the newest context the driver will give us...
+    mWindow = nullptr;
+    if (mode == GLContextMode::GPUDriven)
+    {
+        for (const auto& version : GPU_DRIVEN_GL_VERSIONS)
+        {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+            mWindow = glfwCreateWindow(screenWidth,screenHeight,"TODO", nullptr, nullptr);
+            if (mWindow != nullptr)
+                break;
+        }
+
+        if (mWindow == nullptr)
+        {
+            std::cout
+            << "****************************************************************" << std::endl
+            << "WARNING::WINDOW::No GL 4.3+ context for GPU-driven rendering," << std::endl
+            << "falling back to GL 3.3" << std::endl
+            << "****************************************************************" << std::endl;
+        }
+    }
+
+    // ... otherwise, good old 3.3
+    if (mWindow == nullptr)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        mWindow = glfwCreateWindow(screenWidth,screenHeight,"TODO", nullptr, nullptr);
+    }
 
     if (mWindow == nullptr)
     {
@@ -95,6 +145,17 @@ WindowManager::WindowManager(int screenWidth, int screenHeight)
         throw std::runtime_error("Failed to initialized GLAD.");
     }
 
+    // What did we actually get? (Drivers can hand out newer than asked)
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    mGLVersion = major * 10 + minor;
+#ifdef GL_VERSION_4_3
+    // (glad knows if the 4.3 functions actually loaded)
+    mGPUDriven = (mode == GLContextMode::GPUDriven && GLAD_GL_VERSION_4_3);
+#endif
+
 
 
     // Pre-rendering checklist:
@@ -109,6 +170,42 @@ WindowManager::WindowManager(int screenWidth, int screenHeight)
     // since it initialized fine
     mCamera = std::make_shared<Camera>(mWindow);
 
+    // The camera uniform buffer all the shaders share.
+    // Fill it right away so the first frame has sane values
+    mFrameConstants = std::make_unique<FrameConstantsBuffer>();
+    UpdateFrameConstants();
+
+}
+
+
+
+/**
+ * Destructor
+ */
+WindowManager::~WindowManager()
+{
+    ReleaseContext();
+}
+
+
+
+/**
+ * Delete the GL objects the window & the shared buffers hold,
+ * then end the context. (Does nothing the second time.)
+ */
+void WindowManager::ReleaseContext()
+{
+    if (mWindow == nullptr)
+        return;
+
+    TextureRegistry::Shutdown();
+    TextureStreamer::Shutdown();
+    MeshBuffer::ReleaseAll();
+    mFrameConstants->Release();
+
+    glfwDestroyWindow(mWindow);
+    mWindow = nullptr;
+    glfwTerminate();
 }
 
 
@@ -138,6 +235,9 @@ void WindowManager::FramebufferSizeCallback(GLFWwindow* window, int width, int h
  */
 void WindowManager::UpdateWindow()
 {
+    if (mWindow == nullptr)
+        return;
+
     if(!glfwWindowShouldClose(mWindow))
     {
         // Double-buffering, baby
@@ -147,13 +247,20 @@ void WindowManager::UpdateWindow()
         glfwPollEvents();
         mCamera->Update();
 
+        // Get a bit more of any loading textures onto the GPU
+        TextureStreamer::Get().Update();
+
+        // The camera's done moving for this frame, so
+        // every shader can get its view of the world now
+        UpdateFrameConstants();
+
         // Rendering commands?
         // ... no, somewhere else...
     }
     else
     {
         // Hmm... is this the best place for this code?
-        glfwTerminate();
+        ReleaseContext();
         std::cout << "GLFW terminated." << std::endl;
     }
 }
@@ -169,3 +276,33 @@ std::pair<int, int> WindowManager::GetWindowSize()
     glfwGetWindowSize(mWindow, &size.first, &size.second);
     return size;
 }
+
+
+
+/**
+ * Get the camera data of the current frame, exactly as
+ * it was uploaded to the shaders' FrameConstants block
+ * @return this frame's camera data
+ */
+const FrameConstants& WindowManager::GetFrameConstants() const
+{
+    return mFrameConstants->GetConstants();
+}
+
+
+
+/**
+ * Gather the camera data for this frame and upload
+ * it to the uniform buffer all the shaders share.
+ */
+void WindowManager::UpdateFrameConstants()
+{
+    FrameConstants constants;
+    constants.viewMat = mCamera->GetViewMatrix();
+    constants.projMat = mProjectionMatrix;
+    constants.viewProjMat = mProjectionMatrix * constants.viewMat;
+    constants.viewPos = glm::vec4(mCamera->GetPosition(), 1.0f);
+    constants.time = (float)glfwGetTime();
+
+    mFrameConstants->Update(constants);
+}
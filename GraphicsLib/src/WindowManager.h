@@ -12,6 +12,21 @@
  * passing its RenderObject to this class.
  *
  * Also has to keep track of the camera!
+ *
+ * By default the context is GL 3.3 core. Asking for
+ * GLContextMode::GPUDriven gets the newest context that
+ * can do compute shaders & indirect draws (4.6, or 4.3 at
+ * least--enough for Mesa's llvmpipe), so culling and draw
+ * building can move onto the GPU (see IndirectRenderer).
+ * If there isn't one, it falls back to 3.3 and says so. It
+ * does the same if glad was only generated for 3.3 core: then
+ * the 4.3 functions don't exist at all (see README.md).
+ *
+ * The window owns the GL context, so it also lets go of the GL
+ * objects the shared buffers & registries (MeshBuffer's,
+ * TextureRegistry's, TextureStreamer's) hold before it
+ * ends the context. Anything else holding GL objects has to go
+ * before the WindowManager does.
  */
 
 #ifndef LEARNING_OPENGL__WINDOWMANAGER_H
@@ -24,6 +39,21 @@
 class GLFWwindow;
 class Scene;
 class Camera;
+class FrameConstantsBuffer;
+struct FrameConstants;
+
+/**
+ * What kind of GL context the window makes
+ */
+enum class GLContextMode
+{
+    /// GL 3.3 core. The CPU culls, and draws go through a RenderQueue
+    Core33,
+
+    /// GL 4.3+ core, with the GPU culling and building its own draws
+    GPUDriven
+};
+
 /**
  * Super awesome rendering engine
  */
@@ -41,12 +71,23 @@ private:
     /// Camera to view the window. Constructed here.
     std::shared_ptr<Camera> mCamera;
 
+    /// Uniform buffer with the camera data every shader shares
+    std::unique_ptr<FrameConstantsBuffer> mFrameConstants;
+
+    /// GL version of the context we got, major * 10 + minor (like 33 or 46)
+    int mGLVersion = 0;
+
+    /// Did we ask for GPU-driven rendering, and get a context that can do it?
+    bool mGPUDriven = false;
+
     static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
+    void UpdateFrameConstants();
+    void ReleaseContext();
 
 public:
 
     // Constructor
-    WindowManager(int screenWidth, int screenHeight);
+    WindowManager(int screenWidth, int screenHeight, GLContextMode mode = GLContextMode::Core33);
 
     /// Default constructor (disabled)
     WindowManager() = delete;
@@ -57,6 +98,8 @@ public:
     /// Assignment operator
     void operator=(const WindowManager &) = delete;
 
+    ~WindowManager();
+
     // ****************************************************************
 
     // for testing only...
@@ -74,7 +117,22 @@ public:
      */
     glm::mat4 GetProjectionMatrix() const { return mProjectionMatrix; }
 
+    /**
+     * Get the GL version of the context
+     * @return major * 10 + minor, like 33 or 46
+     */
+    int GetGLVersion() const { return mGLVersion; }
+
+    /**
+     * Should the GPU cull & build its own draws? (Only if
+     * GLContextMode::GPUDriven was asked for, glad has GL 4.3,
+     * and we got a 4.3+ context.)
+     * @return true for GPU-driven rendering
+     */
+    bool IsGPUDriven() const { return mGPUDriven; }
+
     std::pair<int, int> GetWindowSize();
+    const FrameConstants& GetFrameConstants() const;
 
     // ****************************************************************
 
@@ -0,0 +1,105 @@
+/**
+ * @file bounds.h
+ * @author Elijah Gleckler
+ *
+ * Axis-aligned bounding boxes, for knowing roughly
+ * where a mesh/model/object is without looking at
+ * every single vertex.
+ */
+
+#ifndef LEARNING_OPENGL_GRAPHICSLIB_SRC_BOUNDS_H
+#define LEARNING_OPENGL_GRAPHICSLIB_SRC_BOUNDS_H
+
+#include <cmath>
+#include <limits>
+#include <glm.hpp>
+
+/**
+ * An axis-aligned bounding box.
+ *
+ * Starts out "empty" (min > max), so expanding it
+ * by the first point makes a box around just that point.
+ */
+struct AABB
+{
+    /// Smallest corner of the box
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+
+    /// Biggest corner of the box
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    /**
+     * Does this box hold anything at all?
+     * @return true if nothing was ever added to the box
+     */
+    bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    /**
+     * Grow the box to contain a point
+     * @param point point to contain
+     */
+    void Expand(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    /**
+     * Grow the box to contain another box
+     * @param other box to contain
+     */
+    void Expand(const AABB& other)
+    {
+        if (other.IsEmpty())
+            return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    /**
+     * Get the center of the box
+     * @return the center of the box
+     */
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+
+    /**
+     * Get the half-size of the box along each axis
+     * @return the half-size of the box along each axis
+     */
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    /**
+     * Get the box around this box after it's been transformed.
+     *
+     * Uses Arvo's trick: the new center is the transformed
+     * center, and the new extents are the old ones times the
+     * absolute value of the rotation/scale part of the matrix.
+     * Much cheaper than transforming all 8 corners.
+     *
+     * @param mat (affine) matrix to transform by
+     * @return the box around the transformed box
+     */
+    AABB Transformed(const glm::mat4& mat) const
+    {
+        if (IsEmpty())
+            return *this;
+
+        glm::vec3 center = glm::vec3(mat * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+
+        glm::vec3 newExtents;
+        for (int row = 0; row < 3; ++row)
+        {
+            newExtents[row] = std::abs(mat[0][row]) * extents.x +
+                              std::abs(mat[1][row]) * extents.y +
+                              std::abs(mat[2][row]) * extents.z;
+        }
+
+        AABB result;
+        result.min = center - newExtents;
+        result.max = center + newExtents;
+        return result;
+    }
+};
+
+#endif //LEARNING_OPENGL_GRAPHICSLIB_SRC_BOUNDS_H
@@ -58,6 +58,34 @@ struct AttenuationCoefficients
 
 };
 
+/// Attenuation below which the lighting shaders stop computing a
+/// point light (the "attenuation < 0.01" cutoff in gbuf-light.frag).
+/// A light's range is the distance where it drops below this.
+const float POINT_LIGHT_ATTENUATION_CUTOFF = 0.01f;
+
+/**
+ * One point light, packed the way the lighting shaders read
+ * it out of the point light texture buffer: four RGBA32F texels,
+ * with the attenuation coefficients tucked into the w's.
+ *
+ * An array of these is laid out exactly like the buffer on
+ * the GPU, so uploading lights is just copying bytes.
+ */
+struct PackedPointLight
+{
+    /// xyz = position in world space, w = constant attenuation coeff.
+    glm::vec4 positionConstant = glm::vec4(0.0f);
+
+    /// rgb = ambient color, w = linear attenuation coeff.
+    glm::vec4 ambientLinear = glm::vec4(0.0f);
+
+    /// rgb = diffuse color, w = quadratic attenuation coeff.
+    glm::vec4 diffuseQuadratic = glm::vec4(0.0f);
+
+    /// rgb = specular color, w = range (see PointLight::GetRange)
+    glm::vec4 specularRange = glm::vec4(0.0f);
+};
+
 
 
 
@@ -11,6 +11,7 @@
 
 const int SCREEN_WIDTH = 1600; ///< Chosen by me
 const int SCREEN_HEIGHT = 900; ///< Chosen by me
+const int NUM_DEMO_PT_LIGHTS = 4096; ///< Clustered shading handles lots of these
 
 
 std::vector<std::unique_ptr<PointLight>>
@@ -79,7 +80,7 @@ int main()
 
 
     // Let's add a bunch of random point lights:
-    auto ptLights = GetManyPtLights(scene, 1, 100.0);
+    auto ptLights = GetManyPtLights(scene, NUM_DEMO_PT_LIGHTS, 100.0);
     for (auto& light : ptLights)
     {
         scene.AddPointLight(light.get());
@@ -128,11 +129,12 @@ std::vector<std::unique_ptr<PointLight>>
     std::mt19937  gen(randDev());
     std::uniform_real_distribution<float> dist(0.0, 1.0);
 
-    // All the same attenuation
+    // All the same attenuation. Short range (~7 units) so
+    // thousands of lights don't all pile up on every pixel
     AttenuationCoefficients attenCoeffs;
     attenCoeffs.constant = 1.0;
-    attenCoeffs.linear = 0.09;
-    attenCoeffs.quadratic = 0.032;
+    attenCoeffs.linear = 0.7;
+    attenCoeffs.quadratic = 1.8;
 
     for(int i = 0; i < num; ++i)
     {
@@ -155,7 +157,6 @@ std::vector<std::unique_ptr<PointLight>>
         float z = r * sin(phi) * sin(theta);
 
         glm::vec3 pos(x, y, z); // weird coords, ugh
-        std::cout << "Light at: (" << x << ',' << y << ',' << z << ')' << std::endl;
 
         // Make a point light & set the pos
         auto ptLight = std::make_unique<PointLight>(phongColors, attenCoeffs);
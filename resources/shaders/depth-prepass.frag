@@ -0,0 +1,10 @@
+/*
+ * Fragment shader for the depth pre-pass of the g-buffer.
+ * Only the depth gets written, so there is nothing to do here.
+ */
+
+#version 330 core
+
+void main()
+{
+}
@@ -0,0 +1,34 @@
+/*
+ * Vertex shader for the depth pre-pass of the g-buffer
+ * (see GraphicsLib/src/GBuffer.h). Reads the depth-only
+ * vertex arrays (see GraphicsLib/src/MeshBuffer.h).
+ */
+
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+// Per-instance transforms (see GraphicsLib/src/InstanceBuffer.h)
+layout (location = 3) in mat4 aModelMat;
+
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
+// The g-buffer pass only keeps fragments at exactly the depth
+// this pass wrote, so both have to work it out the same way
+invariant gl_Position;
+
+
+void main()
+{
+    // Has to match gbuf-geo.vert, to the letter
+    gl_Position = viewProjMat * aModelMat * vec4(aPos, 1.0);
+}
@@ -0,0 +1,71 @@
+/*
+ * Vertex shader for the g-buffer, for GPU-driven draws
+ * (see GraphicsLib/src/IndirectRenderer.h). Same outputs
+ * as gbuf-geo.vert, so it pairs with gbuf-geo.frag.
+ */
+
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+// Index of this draw's record: starts at the draw's base
+// instance (see GraphicsLib/src/MeshBuffer.h)
+layout (location = 10) in uint aDrawId;
+
+// Has to match IndirectRenderer::DrawRecord
+struct DrawRecord
+{
+    vec4 sphere;
+    vec4 positionScale;
+    vec4 positionOffset;
+    uvec4 lodCounts;
+    uvec4 lodFirstIndices;
+    uint transformId;
+    int baseVertex;
+    uint numLODs;
+    uint bucket;
+    uint firstCommand;
+};
+
+// Has to match IndirectRenderer::ObjectTransform
+struct ObjectTransform
+{
+    mat4 modelMat;
+    mat4 normalMat;
+};
+
+layout (std430, binding = 0) readonly buffer DrawRecords { DrawRecord records[]; };
+layout (std430, binding = 1) readonly buffer ObjectTransforms { ObjectTransform transforms[]; };
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
+
+void main()
+{
+    DrawRecord record = records[aDrawId];
+    ObjectTransform transform = transforms[record.transformId];
+
+    // Packed positions are relative to a box; put them back in model space
+    vec3 position = record.positionOffset.xyz + record.positionScale.xyz * aPos;
+    vec4 worldPos = transform.modelMat * vec4(position, 1.0);
+
+    FragPos = vec3(worldPos);
+    Normal = mat3(transform.normalMat) * aNormal;
+    gl_Position = viewProjMat * worldPos;
+    TexCoords = aTexCoords;
+}
@@ -8,14 +8,29 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+// Per-instance transforms (see GraphicsLib/src/InstanceBuffer.h)
+layout (location = 3) in mat4 aModelMat;
+layout (location = 7) in mat3 aNormalMat;
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 viewMat;
-uniform mat4 modelMat;
-uniform mat4 projMat;
-uniform mat3 normalMat;
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
+// Has to come out exactly like the depth pre-pass
+// (see depth-prepass.vert), when there is one: this
+// pass then only keeps fragments at its exact depth
+invariant gl_Position;
 
 
 void main()
@@ -24,14 +39,14 @@ void main()
     // mat4 modelViewMat = viewMat * modelMat;
 
     // Put fragment position into view space
-    FragPos = vec3(modelMat * vec4(aPos, 1.0f));
+    FragPos = vec3(aModelMat * vec4(aPos, 1.0f));
 
     // Normal mat, as well.
     // Normal matrix stops non-uniform scaling
-    Normal = normalMat * aNormal;
+    Normal = aNormalMat * aNormal;
 
     // Transform the position into clip perspective
-    gl_Position = projMat * viewMat * modelMat * vec4(aPos, 1.0);
+    gl_Position = viewProjMat * aModelMat * vec4(aPos, 1.0);
 
     TexCoords = aTexCoords;
 
@@ -43,15 +43,35 @@ uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
 
 // Lighting uniforms
-#define MAX_NUM_PT_LIGHTS 32
-uniform PointLight pointLights[MAX_NUM_PT_LIGHTS];
-uniform int numActivePtLights; // how many lights are in the scene?
+// Point lights are packed 4 texels each into a buffer texture
+// (see PackedPointLight in GraphicsLib/src/lighting_structs.h)
+uniform samplerBuffer pointLightData;
+
+// Clustered light culling (see GraphicsLib/src/LightClusterGrid.h)
+// The grid size must match the LIGHT_CLUSTERS_* constants there!
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+uniform usamplerBuffer clusterGrid; // (offset, count) into clusterLightIndices per cluster
+uniform usamplerBuffer clusterLightIndices; // every cluster's light list, end to end
+uniform vec4 clusterParams; // (tiles per pixel x, y, depth slice scale, depth slice bias)
+uniform bool shadeClusteredLights; // false when point lights are drawn as light volumes instead
 
 uniform DirectionalLight dirLight;
 uniform bool dirLightIsActive; // is there a directional light on the scene?
 
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
 // Lighting in view or world space?? WORLD for now
-uniform vec3 viewPos;
 
 
 // Fn declarations for lighting type calculations
@@ -59,6 +79,8 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 Albedo, float Specular);
 //vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 Albedo, float Specular)
 float CalcShininess();
+PointLight FetchPointLight(int i);
+int FindCluster(vec3 fragPos);
 
 
 
@@ -71,17 +93,22 @@ void main() {
     float Specular = texture(gAlbedoSpec, TexCoords).a;
 
     // Then, calculate lighting as usual:
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
 
     // directional lighting
     vec3 directionalLighting = CalcDirectionalLight(dirLight, Normal, viewDir, Albedo, Specular);
 
-    // point lighting
+    // point lighting, only from the lights that reach this pixel's cluster
     vec3 hardCodedAmbient = vec3(0.1f) * Albedo;
     vec3 pointLighting = vec3(hardCodedAmbient);
-    for (int i = 0; i < MAX_NUM_PT_LIGHTS && i < numActivePtLights; i++)
+    if (shadeClusteredLights)
     {
-        pointLighting += CalcPointLight(pointLights[i], Normal, FragPos, viewDir, Albedo, Specular);
+        uvec2 clusterLights = texelFetch(clusterGrid, FindCluster(FragPos)).rg;
+        for (uint i = 0u; i < clusterLights.y; i++)
+        {
+            int lightIndex = int(texelFetch(clusterLightIndices, int(clusterLights.x + i)).r);
+            pointLighting += CalcPointLight(FetchPointLight(lightIndex), Normal, FragPos, viewDir, Albedo, Specular);
+        }
     }
 
     // spot lighting
@@ -221,6 +248,44 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
 
 
 
+// Finds the index of the light cluster this fragment is in
+int FindCluster(vec3 fragPos)
+{
+    // Tile from the screen position...
+    ivec2 tile = ivec2(gl_FragCoord.xy * clusterParams.xy);
+    tile = clamp(tile, ivec2(0), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+
+    // ... and depth slice from the (exponentially sliced) view depth
+    float depth = max(-(viewMat * vec4(fragPos, 1.0)).z, 1e-4);
+    int slice = int(floor(log(depth) * clusterParams.z + clusterParams.w));
+    slice = clamp(slice, 0, CLUSTER_GRID_Z - 1);
+
+    return tile.x + CLUSTER_GRID_X * (tile.y + CLUSTER_GRID_Y * slice);
+}
+
+
+
+// Unpacks point light i from the point light buffer
+PointLight FetchPointLight(int i)
+{
+    vec4 positionConstant = texelFetch(pointLightData, i * 4);
+    vec4 ambientLinear = texelFetch(pointLightData, i * 4 + 1);
+    vec4 diffuseQuadratic = texelFetch(pointLightData, i * 4 + 2);
+    vec4 specularRange = texelFetch(pointLightData, i * 4 + 3);
+
+    PointLight light;
+    light.position = positionConstant.xyz;
+    light.ambient = ambientLinear.rgb;
+    light.diffuse = diffuseQuadratic.rgb;
+    light.specular = specularRange.rgb;
+    light.constant = positionConstant.w;
+    light.linear = ambientLinear.w;
+    light.quadratic = diffuseQuadratic.w;
+    return light;
+}
+
+
+
 // Calculates the shininess of this material at the tex coords
 float CalcShininess()
 {
@@ -0,0 +1,11 @@
+/*
+ * Fragment shader for the stencil pass of the point
+ * light volumes. All the work is in the stencil ops,
+ * so there is nothing to do here.
+ */
+
+#version 330 core
+
+void main()
+{
+}
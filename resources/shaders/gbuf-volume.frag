@@ -0,0 +1,146 @@
+/*
+ * Fragment shader for drawing point light volumes
+ * over the g-buffer. Shades a single light, and gets
+ * added on top of the fullscreen lighting pass.
+ */
+
+#version 330 core
+
+#define SHININESS_RANGE 5000.0
+#define SHININESS_MIN 2.0
+
+flat in int LightIndex;
+
+out vec4 FragColor;
+
+struct PointLight
+{
+    vec3 position; // world space
+
+    // Color values for Phong
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    // Attentuation coeffs:
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// Texture maps from the g-buffer
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+
+// Point lights are packed 4 texels each into a buffer texture
+// (see PackedPointLight in GraphicsLib/src/lighting_structs.h)
+uniform samplerBuffer pointLightData;
+
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
+
+// Fn declarations for lighting type calculations
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 Albedo, float Specular);
+float CalcShininess();
+PointLight FetchPointLight(int i);
+
+
+
+void main() {
+
+    // No quad to give us tex coords, but the g-buffer is
+    // screen-sized, so just grab the texel under this pixel
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    // Get the data from the G-buffer
+    vec3 FragPos = texelFetch(gPosition, texel, 0).rgb;
+    vec3 Normal = texelFetch(gNormal, texel, 0).rgb;
+    vec3 Albedo = texelFetch(gAlbedoSpec, texel, 0).rgb;
+    float Specular = texelFetch(gAlbedoSpec, texel, 0).a;
+
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+
+    // Same math as the fullscreen pass, for just this light
+    vec3 result = CalcPointLight(FetchPointLight(LightIndex), Normal, FragPos, viewDir, Albedo, Specular);
+    FragColor = vec4(result, 1.0);
+}
+
+
+
+// Calculates lighting on a fragment from a single point light
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 Albedo, float Specular)
+{
+
+    // Attenuation...
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+    // if this is low enough, just cut off all the computation
+    if (attenuation < 0.01)
+        return vec3(0.0);
+
+    // Compute light direction
+    vec3 lightDir = normalize(light.position- fragPos);
+
+    // ambient lighting
+    vec3 ambientLight = light.ambient * Albedo;
+
+    // diffuse lighting
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuseLight = light.diffuse * diff * Albedo;
+
+    // specular lighting
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), CalcShininess());
+    vec3 specularLight = light.specular * spec * Specular;
+
+    // Attenuate!
+    diffuseLight *= attenuation;
+    specularLight *= attenuation;
+
+    // combine the results and output
+    vec3 result = ambientLight + diffuseLight + specularLight;
+    return result;
+
+}
+
+
+
+// Unpacks point light i from the point light buffer
+PointLight FetchPointLight(int i)
+{
+    vec4 positionConstant = texelFetch(pointLightData, i * 4);
+    vec4 ambientLinear = texelFetch(pointLightData, i * 4 + 1);
+    vec4 diffuseQuadratic = texelFetch(pointLightData, i * 4 + 2);
+    vec4 specularRange = texelFetch(pointLightData, i * 4 + 3);
+
+    PointLight light;
+    light.position = positionConstant.xyz;
+    light.ambient = ambientLinear.rgb;
+    light.diffuse = diffuseQuadratic.rgb;
+    light.specular = specularRange.rgb;
+    light.constant = positionConstant.w;
+    light.linear = ambientLinear.w;
+    light.quadratic = diffuseQuadratic.w;
+    return light;
+}
+
+
+
+// Calculates the shininess of this material at the tex coords
+float CalcShininess()
+{
+    // Get the shininess exponent from the R channel of the texture, since it's BW
+    // Then make sure to multiply to transform the 0.0-1.0 to the shininess range!
+    float shininess = 50; // SHININESS_RANGE * texture(texture_roughness_1, TexCoords).r + SHININESS_MIN;
+    return shininess;
+}
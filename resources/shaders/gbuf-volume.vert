@@ -0,0 +1,38 @@
+/*
+ * Vertex shader for drawing point light volumes
+ * over the g-buffer: a unit sphere, moved to one
+ * light's position and scaled up to its range
+ */
+
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
+// Point lights are packed 4 texels each into a buffer texture
+// (see PackedPointLight in GraphicsLib/src/lighting_structs.h)
+uniform samplerBuffer pointLightData;
+uniform int lightIndex; // which light this volume is for
+
+// The light index, passed along so the frag shader doesn't need a uniform
+flat out int LightIndex;
+
+
+void main()
+{
+    vec3 lightPos = texelFetch(pointLightData, lightIndex * 4).xyz;
+    float range = texelFetch(pointLightData, lightIndex * 4 + 3).w;
+
+    LightIndex = lightIndex;
+    gl_Position = viewProjMat * vec4(lightPos + aPos * range, 1.0);
+}
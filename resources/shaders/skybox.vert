@@ -8,8 +8,16 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projMat;
-uniform mat4 viewMat;
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
 
 void main()
 {
@@ -17,6 +25,7 @@ void main()
 
     // Early depth testing--trick the depth buffer?
     // https://learnopengl.com/Advanced-OpenGL/Cubemaps
-    vec4 pos = projMat * viewMat * vec4(aPos, 1.0);
+    // Strip the translation out of the view matrix--the sky never gets closer
+    vec4 pos = projMat * mat4(mat3(viewMat)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }
\ No newline at end of file
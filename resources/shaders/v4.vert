@@ -9,9 +9,18 @@ out vec3 Normal;
 out vec2 TexCoords;
 out mat4 ViewMat;
 
-uniform mat4 viewMat;
+// Camera data shared by every program, updated once per frame
+// (see GraphicsLib/src/FrameConstants.h)
+layout (std140) uniform FrameConstants
+{
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 viewProjMat;
+    vec4 viewPos;
+    float time;
+};
+
 uniform mat4 modelMat;
-uniform mat4 projMat;
 uniform mat3 normalMat;
 
 